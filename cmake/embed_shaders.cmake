@@ -0,0 +1,40 @@
+# Writes the compiled shaders as aligned uint32_t arrays into a C++ source, see embedded_shaders.hpp
+#   cmake -DSHADERS=<a.spv,b.spv,...> -DOUTPUT=<file.cpp> -DSTAMP=<file.stamp> -P embed_shaders.cmake
+string(REPLACE "," ";" SHADER_LIST "${SHADERS}")
+
+set(ARRAYS "")
+set(TABLE "")
+foreach(SHADER ${SHADER_LIST})
+  get_filename_component(NAME ${SHADER} NAME)
+  string(MAKE_C_IDENTIFIER ${NAME} IDENTIFIER)
+
+  file(READ ${SHADER} HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+  if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${SHADER} is not a SPIR-V binary")
+  endif()
+
+  # SPIR-V is a stream of little-endian words, eight per line
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+  set(WORD "0x[0-9a-f]+, ")
+  string(REGEX REPLACE "(${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD})" "\\1\n  " WORDS "${WORDS}")
+  string(REPLACE ", \n" ",\n" WORDS "${WORDS}")
+  string(STRIP "${WORDS}" WORDS)
+
+  string(APPEND ARRAYS "alignas(16) static constexpr uint32_t ${IDENTIFIER}[] = {\n  ${WORDS}\n};\n\n")
+  string(APPEND TABLE "  {\"${NAME}\", ${IDENTIFIER}, std::size(${IDENTIFIER})},\n")
+endforeach()
+
+set(CONTENT "// Generated by cmake/embed_shaders.cmake, do not edit\n")
+string(APPEND CONTENT "#include \"embedded_shaders.hpp\"\n\n#include <iterator>\n\n")
+string(APPEND CONTENT "${ARRAYS}")
+string(APPEND CONTENT "const EmbeddedShader embeddedShaders[] = {\n${TABLE}};\n")
+string(APPEND CONTENT "const size_t embeddedShaderCount = std::size(embeddedShaders);\n")
+
+# Only replace the source when a shader changed, so unrelated builds do not recompile it; the stamp is the
+# custom command's output and is always refreshed, so the command does not rerun on every build
+file(WRITE ${OUTPUT}.tmp "${CONTENT}")
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
+file(TOUCH ${STAMP})
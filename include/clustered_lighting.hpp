@@ -0,0 +1,73 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include "compute_pipeline.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Matches PointLight in cluster.comp and frag.glsl (std430)
+struct PointLight
+{
+  glm::vec4 positionRadius;
+  glm::vec4 color;
+};
+
+// Clustered forward lighting: a compute pass bins the lights into a view-space froxel
+// grid each frame and the fragment shader only loops over the lights of its cluster.
+class ClusteredLighting
+{
+public:
+  // Grid dimensions, keep in sync with cluster.comp and frag.glsl
+  static const uint32_t CLUSTER_X = 16;
+  static const uint32_t CLUSTER_Y = 9;
+  static const uint32_t CLUSTER_Z = 24;
+  static const uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+private:
+  VkDevice device;
+  std::vector<PointLight> baseLights;
+  std::vector<float> orbitSpeeds;
+
+  std::vector<VkBuffer> lightBuffers;
+  std::vector<VkDeviceMemory> lightBuffersMemory;
+  std::vector<void*> lightBuffersMapped;
+  // One per frame: binning for the next frame never waits for this one's fragment shaders
+  std::vector<VkBuffer> clusterBuffers;
+  std::vector<VkDeviceMemory> clusterBuffersMemory;
+  VkDeviceSize clusterBufferSize;
+  uint32_t graphicsFamily;
+  uint32_t computeFamily;  // where binning is recorded
+
+  std::unique_ptr<ComputePipeline> cullPipeline;
+
+  void generateLights(uint32_t lightCount);
+
+public:
+  // Binning runs on a queue of computeFamily. When it is not graphicsFamily the light buffers are shared with
+  // graphics and each frame's cluster buffer is handed over to it
+  ClusteredLighting(
+    VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t lightCount,
+    VkPipelineLayout layout, uint32_t graphicsFamily, uint32_t computeFamily
+  );
+  ~ClusteredLighting();
+
+  // Light positions at time into lights; only reads state fixed at construction, so any thread may call it
+  void animate(float time, std::vector<PointLight>& lights) const;
+  // Writes lights from animate into the buffer of this image
+  void upload(uint32_t frame, const std::vector<PointLight>& lights);
+  // Light binning into the frame's cluster buffer, recorded outside of the render pass; on the graphics queue it is
+  // a frame graph pass, on the compute queue it releases the buffer to graphics
+  void recordCulling(
+    VkCommandBuffer commandBuffer, uint32_t frame, VkPipelineLayout layout, VkDescriptorSet descriptorSet
+  );
+  // Frame graph pass before the fragment shaders read the clusters binned on another family
+  void acquireClusters(VkCommandBuffer commandBuffer, uint32_t frame) const;
+
+  VkDescriptorBufferInfo getLightBufferInfo(uint32_t frame) const;
+  VkDescriptorBufferInfo getClusterBufferInfo(uint32_t frame) const;
+  uint32_t getLightCount() const { return static_cast<uint32_t>(baseLights.size()); }
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef COMPUTE_PIPELINE_HPP
+#define COMPUTE_PIPELINE_HPP
+
+#include <string>
+
+class ComputePipeline
+{
+private:
+  VkDevice device;
+  VkPipeline pipeline;
+
+public:
+  ComputePipeline(VkDevice device, const std::string& shaderPath, VkPipelineLayout layout);
+  ~ComputePipeline();
+
+  VkPipeline getPipeline() const { return pipeline; }
+};
+
+#endif
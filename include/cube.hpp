@@ -2,6 +2,7 @@
 #define CUBE_HPP
 
 #include "vertex.hpp"
+#include "queue_timeline.hpp"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -13,24 +14,34 @@ private:
 
   VkBuffer vertexBuffer;
   VkDeviceMemory vertexBufferMemory;
+  VkBuffer positionBuffer;
+  VkDeviceMemory positionBufferMemory;
   VkBuffer indexBuffer;
   VkDeviceMemory indexBufferMemory;
 
   std::vector<Vertex> vertices;
   std::vector<uint32_t> indices;
 
-  void createVertexBuffer(VkCommandPool commandPool, VkQueue queue);
-  void createIndexBuffer(VkCommandPool commandPool, VkQueue queue);
+  void createVertexBuffer(VkCommandPool commandPool, QueueTimeline& queue);
+  void createPositionBuffer(VkCommandPool commandPool, QueueTimeline& queue);
+  void createIndexBuffer(VkCommandPool commandPool, QueueTimeline& queue);
+  VkBuffer createDeviceLocalBuffer(
+    const void* contents, VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory& memory,
+    VkCommandPool commandPool, QueueTimeline& queue
+  );
   VkBuffer createBuffer(
     VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory& memory
   );
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool, VkQueue queue);
+  void copyBuffer(
+    VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool, QueueTimeline& queue
+  );
 
 public:
-  Cube(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, VkQueue queue);
+  Cube(VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue);
   ~Cube();
 
   VkBuffer getVertexBuffer() const { return vertexBuffer; }
+  VkBuffer getPositionBuffer() const { return positionBuffer; }
   VkBuffer getIndexBuffer() const { return indexBuffer; }
   uint32_t getIndexCount() const { return static_cast<uint32_t>(indices.size()); }
 };
@@ -9,15 +9,21 @@ private:
   VkDeviceMemory memory;
   VkImageView imageView;
   VkFormat depthFormat;
+  VkExtent2D extent;
 
 public:
-  DepthBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent);
+  // extraUsage e.g. INPUT_ATTACHMENT for the deferred lighting subpass
+  DepthBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkImageUsageFlags extraUsage = 0);
   ~DepthBuffer();
 
   VkImageView getImageView() const { return imageView; }
   VkImage getImage() const { return image; }
   VkDeviceMemory getMemory() const { return memory; }
   VkFormat getFormat() const { return depthFormat; }
+  VkExtent2D getExtent() const { return extent; }
+
+  // Best supported depth format, extraFeatures e.g. for depth images that are also sampled
+  static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags extraFeatures = 0);
 };
 
 #endif
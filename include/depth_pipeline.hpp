@@ -0,0 +1,26 @@
+#ifndef DEPTH_PIPELINE_HPP
+#define DEPTH_PIPELINE_HPP
+
+#include "pipeline_target.hpp"
+
+#include <string>
+
+// Depth-only pipeline for the pre-pass and the occluder pass: position-only vertex stream, no fragment stage.
+// Uses the main pipeline layout, so the same descriptor set and draw list push constant apply.
+class DepthPipeline
+{
+private:
+  VkDevice device;
+  VkPipeline pipeline;
+
+public:
+  DepthPipeline(
+    VkDevice device, const PipelineTarget& target, const std::string& vertPath, VkPipelineLayout layout,
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT
+  );
+  ~DepthPipeline();
+
+  VkPipeline getPipeline() const { return pipeline; }
+};
+
+#endif
@@ -2,22 +2,47 @@
 #define DESCRIPTOR_HPP
 
 #include "uniform_buffer.hpp"
+#include "late_latch.hpp"
+#include "mip_feedback.hpp"
+#include "layout_cache.hpp"
 
 class Descriptor
 {
 private:
   VkDevice device;
-  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorSetLayout descriptorSetLayout;  // owned by the layout cache
   VkDescriptorPool descriptorPool;
   std::vector<VkDescriptorSet> descriptorSets;
-  VkPipelineLayout pipelineLayout;
+  std::vector<VkImageView> boundImageViews;
+  std::vector<VkSampler> boundSamplers;
+  VkPipelineLayout pipelineLayout;  // owned by the layout cache
 
 public:
-  Descriptor(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t imageCount);
+  // reflection: every shader bound with these sets, the layouts are derived from it
+  Descriptor(
+    VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, LayoutCache& layouts,
+    const ShaderReflection& reflection
+  );
   ~Descriptor();
 
-  void update(uint32_t currentImage, const UniformBuffer& uniformBuffer);
-  VkDescriptorSet getDescriptorSet(uint32_t currentImage) const { return descriptorSets[currentImage]; }
+  void update(uint32_t frame, const UniformBuffer& uniformBuffer);
+  // Writes the texture binding only when the image view or sampler differs from the ones already in the set
+  void updateTexture(uint32_t frame, const VkDescriptorImageInfo& imageInfo);
+  void updateLighting(
+    uint32_t frame, const VkDescriptorBufferInfo& lightBuffer, const VkDescriptorBufferInfo& clusterBuffer
+  );
+  void updateShadowMap(uint32_t frame, const VkDescriptorImageInfo& imageInfo);
+  void updateCulling(
+    uint32_t frame, const VkDescriptorBufferInfo& objectBuffer,
+    const VkDescriptorBufferInfo& drawBuffer, const VkDescriptorBufferInfo& historyBuffer
+  );
+  // Must be rewritten whenever the pyramid is recreated
+  void updateHiZ(uint32_t frame, const VkDescriptorImageInfo& imageInfo);
+  // Deferred lighting inputs, rewritten whenever the attachments are recreated
+  void updateGBuffer(uint32_t frame, VkImageView albedoView, VkImageView normalView, VkImageView depthView);
+  void updateLateLatch(uint32_t frame, const LateLatch& lateLatch);
+  void updateMipFeedback(uint32_t frame, const MipFeedback& mipFeedback);
+  VkDescriptorSet getDescriptorSet(uint32_t frame) const { return descriptorSets[frame]; }
   VkPipelineLayout getPipelineLayout() const { return pipelineLayout; }
 };
 
@@ -0,0 +1,115 @@
+#ifndef DRAW_QUEUE_HPP
+#define DRAW_QUEUE_HPP
+
+#include "frame_arena.hpp"
+
+#include <array>
+#include <cstring>
+#include <span>
+#include <glm/glm.hpp>
+
+// Geometry of a draw: positions or full vertices at binding 0 and 32-bit indices. Without buffers the
+// shader makes up indexCount vertices, e.g. a fullscreen triangle
+struct DrawMesh
+{
+  VkBuffer vertexBuffer;
+  VkBuffer indexBuffer;
+  uint32_t indexCount;
+};
+
+// One VkDrawIndexedIndirectCommand written on the GPU, e.g. a culled instance list
+struct DrawIndirect
+{
+  VkBuffer buffer;
+  VkDeviceSize offset;
+};
+
+// Push constants at offset 0: a transform, a draw list index, anything up to a matrix
+struct DrawConstants
+{
+  std::array<uint32_t, 16> values{};
+  uint32_t size = 0;
+
+  template<typename T>
+  static DrawConstants of(const T& value)
+  {
+    static_assert(sizeof(T) <= sizeof(values), "Push constants of a draw packet are at most 64 bytes");
+    DrawConstants constants;
+    std::memcpy(constants.values.data(), &value, sizeof(T));
+    constants.size = sizeof(T);
+    return constants;
+  }
+};
+
+// Everything one draw binds. The key only decides the order, binds are skipped by comparing the handles
+struct DrawPacket
+{
+  uint64_t key;
+  VkPipeline pipeline;
+  VkDescriptorSet descriptorSet;  // set 0, null when the pipeline reads none
+  const DrawMesh* mesh;
+  DrawConstants constants;
+  DrawIndirect indirect{};  // null buffer: the whole mesh once
+};
+
+// Per-frame counts of what the recorder bound and drew (or dispatched); skipped binds are the ones a
+// draw-by-draw recording would have repeated
+struct DrawStats
+{
+  uint64_t draws = 0;
+  uint64_t pipelineBinds = 0;
+  uint64_t descriptorBinds = 0;
+  uint64_t meshBinds = 0;
+  uint64_t skippedBinds = 0;
+};
+
+// Draw packets of one render pass instance: pushed in any order, sorted by key, recorded with only
+// the state changes between neighbours. Storage comes from a frame arena
+class DrawQueue
+{
+public:
+  // Key fields from the most significant bit: state changes are grouped by cost, depth orders each group
+  static constexpr uint32_t PASS_BITS = 4;
+  static constexpr uint32_t PIPELINE_BITS = 12;
+  static constexpr uint32_t MATERIAL_BITS = 12;
+  static constexpr uint32_t MESH_BITS = 12;
+  static constexpr uint32_t DEPTH_BITS = 24;
+
+  // Smaller queues are sorted on the calling thread, starting workers would cost more than the sort
+  static constexpr size_t PARALLEL_THRESHOLD = 32768;
+  static constexpr uint32_t MAX_SORT_THREADS = 4;
+
+private:
+  struct SortEntry
+  {
+    uint64_t key;
+    uint32_t packet;
+  };
+
+  FrameVector<DrawPacket> packets;
+  FrameVector<SortEntry> entries;
+  FrameVector<SortEntry> scratch;
+
+  static void radixSort(std::span<SortEntry> keys, std::span<SortEntry> spare);
+
+public:
+  // capacity is the expected packet count, the arena's vectors should not grow
+  DrawQueue(LinearArena& arena, size_t capacity);
+
+  // depth is 0 at the near plane and 1 at the far one, nearer draws go first
+  static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+  void push(const DrawPacket& packet);
+  // Stable LSD radix sort of the keys, on up to MAX_SORT_THREADS threads for large queues
+  void sort();
+  // The packets of one pass in key order, inside its render pass or subpass with the viewport and scissor set.
+  // layout must fit every pipeline, constantStages are the stages of its push constant range
+  void record(
+    VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags constantStages, uint32_t pass,
+    DrawStats& stats
+  ) const;
+
+  size_t size() const { return packets.size(); }
+};
+
+#endif
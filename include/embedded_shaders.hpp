@@ -0,0 +1,19 @@
+#ifndef EMBEDDED_SHADERS_HPP
+#define EMBEDDED_SHADERS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// SPIR-V compiled and optimized at build time, written by cmake/embed_shaders.cmake.
+// Only linked when the build defines HERTRA_EMBEDDED_SHADERS
+struct EmbeddedShader
+{
+  const char* name;  // file name of the binary, e.g. "vert.spv"
+  const uint32_t* code;
+  size_t wordCount;
+};
+
+extern const EmbeddedShader embeddedShaders[];
+extern const size_t embeddedShaderCount;
+
+#endif
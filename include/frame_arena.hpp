@@ -0,0 +1,92 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator: allocations are never freed one by one, reset drops all of them at once.
+// When the block runs out the rest of the frame is served from the heap, and the next reset grows
+// the block to the peak, so once the peak is known a frame allocates nothing from the heap
+class LinearArena
+{
+private:
+  std::unique_ptr<std::byte[]> block;
+  size_t capacity;
+  size_t offset;
+  std::vector<std::unique_ptr<std::byte[]>> overflow;
+  size_t overflowBytes;
+
+  size_t highWater;  // most bytes used by one frame so far
+  uint32_t heapAllocations;  // since the last take, overflow blocks and growth included
+  bool poison;
+
+public:
+  // poison fills the released bytes with 0xDD on every reset, so reads of stale frame data stand out
+  LinearArena(size_t capacity, bool poison = false);
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  void reset();
+
+  size_t getUsed() const { return offset + overflowBytes; }
+  size_t getCapacity() const { return capacity; }
+  size_t getHighWater() const { return highWater; }
+  uint32_t takeHeapAllocations();
+};
+
+// Allocator for standard containers living in an arena; deallocate is a no-op, the memory comes back with
+// the arena's reset. A growing container leaves its old storage behind, so reserve where the size is known
+template <typename T>
+class ArenaAllocator
+{
+public:
+  using value_type = T;
+
+  LinearArena* arena;
+
+  explicit ArenaAllocator(LinearArena& target) noexcept : arena(&target) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+  T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); }
+  void deallocate(T*, size_t) noexcept {}
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// Transient CPU memory of one frame in flight: a linear arena per thread, so workers recording or
+// culling in parallel never share a bump pointer. Reset by the frame ring once the frame's fence has signaled;
+// workers must be done with the frame by then
+class FrameArena
+{
+public:
+  // Threads allocating at the same time; a thread's slot is released when it exits
+  static const uint32_t MAX_THREADS = 8;
+
+private:
+  size_t threadCapacity;
+  bool poison;
+  // Slot 0 belongs to the first thread ever asking for one, the render thread; the others are made on demand
+  std::array<std::unique_ptr<LinearArena>, MAX_THREADS> arenas;
+
+public:
+  FrameArena(size_t capacity, size_t threadCapacity, bool poison = false);
+
+  // Sub-arena of the calling thread
+  LinearArena& get();
+  void reset();
+
+  // Summed over the sub-arenas
+  size_t getHighWater() const;
+  uint32_t takeHeapAllocations();
+};
+
+#endif
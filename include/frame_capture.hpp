@@ -0,0 +1,118 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include "queue_timeline.hpp"
+#include "settings.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Readback of the final image every few frames: the frame's own command buffer copies it into a free slot
+// of a ring of host-visible buffers, and once the timeline shows the copy complete, frames later, a writer
+// thread converts and writes it. Nothing waits on the GPU; with no free slot the capture is dropped
+class FrameCapture
+{
+public:
+  // Slots beyond the frames in flight: the writers may fall this far behind before captures are dropped
+  static constexpr uint32_t SPARE_SLOTS = 4;
+  // PNG files are compressed in parallel, streams keep their order with one writer
+  static constexpr uint32_t MAX_PNG_WRITERS = 4;
+
+private:
+  enum class SlotState
+  {
+    Free,
+    Recorded,  // copy recorded into the current frame
+    InFlight,  // submitted, waiting for the timeline
+    Queued,    // complete, waiting for a writer
+    Writing    // held by a writer
+  };
+
+  struct Slot
+  {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    const uint8_t* mapped;
+    SlotState state;
+    uint64_t value;  // timeline value of the submission with the copy
+    uint64_t sequence;  // capture number, the PNG file name
+  };
+
+  VkDevice device;
+  VkPhysicalDevice physicalDevice;
+  VkFormat imageFormat;
+  VkExtent2D extent;
+  bool cached;  // host-cached memory, invalidated before the writers read it
+  uint32_t slotCount;
+
+  CaptureFormat outputFormat;
+  std::string output;
+  uint32_t interval;
+  uint32_t frameRate;  // for the Y4M header
+
+  std::vector<Slot> slots;
+  uint32_t recordingSlot;  // UINT32_MAX when the current frame is not captured
+  uint64_t frameNumber;
+  uint64_t sequence;
+  uint64_t dropped;
+
+  // Stream output, opened with the capture and written from the one stream writer
+  FILE* stream;
+  bool pipe;
+  VkExtent2D streamExtent;  // a stream keeps the size of its first frame
+
+  std::vector<std::thread> writers;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::condition_variable idle;
+  uint32_t queuedSlots;  // writers take the queued slot with the lowest sequence, so streams keep their order
+  uint32_t busyWriters;
+  bool stopping;
+  std::atomic<uint64_t> written;
+  std::atomic<uint64_t> failed;
+
+  void createSlots();
+  void destroySlots();
+  void writerLoop();
+  // Converts the slot into scratch; the slot may be reused as soon as this returns
+  void convert(const Slot& slot, std::vector<uint8_t>& scratch) const;
+  bool write(uint64_t frame, const std::vector<uint8_t>& scratch);
+  // Blocks until the writers have taken and finished every queued slot
+  void drain();
+
+public:
+  // imageFormat must pass supportsFormat; framesInFlight sizes the ring with SPARE_SLOTS
+  FrameCapture(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkFormat imageFormat, VkExtent2D extent,
+    uint32_t framesInFlight, CaptureFormat outputFormat, const std::string& output, uint32_t interval,
+    uint32_t frameRate
+  );
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  // 8-bit RGBA or BGRA, what swapchains offer with sRGB nonlinear color
+  static bool supportsFormat(VkFormat format);
+
+  // Once per frame before recording: decides whether this frame is captured and takes a slot for it
+  void beginFrame();
+  // image in TRANSFER_SRC_OPTIMAL, the size of the capture; records nothing when the frame is not captured
+  void record(VkCommandBuffer commandBuffer, VkImage image);
+  // value: what the timeline reaches once the frame's commands have executed
+  void endFrame(uint64_t value);
+  // Hands the slots whose copies completed to the writers, oldest first
+  void collect(QueueTimeline& queue);
+  // With the device idle: finishes the queued writes and reallocates the ring
+  void resize(QueueTimeline& queue, VkExtent2D newExtent);
+
+  // Captures written and dropped since the last call; dropped ones found the ring full or failed to write
+  void takeCounts(uint64_t& writtenCount, uint64_t& droppedCount);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef FRAME_CONTEXT_HPP
+#define FRAME_CONTEXT_HPP
+
+#include "frame_arena.hpp"
+#include "queue_timeline.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// What one frame in flight records and submits with. An entry is reused only after its submission has completed,
+// so everything indexed by it (uniform slice, descriptor set, light and object buffers) is free to write
+struct FrameContext
+{
+  uint32_t index;  // slot in the per-frame resources
+  uint64_t submitValue;  // graphics timeline value of its last submission
+  VkSemaphore imageAvailable;
+  VkSemaphore renderFinished;
+  VkCommandPool commandPool;  // reset as a whole once the fence has signaled
+  VkCommandBuffer commandBuffer;
+  // Async compute work of the frame, recorded from a pool of the compute family; null without a compute queue
+  VkCommandPool computePool;
+  VkCommandBuffer computeCommandBuffer;
+  VkDescriptorSet descriptorSet;  // allocated by Descriptor, the set of this frame's uniform slice
+  FrameArena* arena;  // transient CPU data, reset together with the command pool
+
+  std::chrono::steady_clock::time_point startTime;
+  // When begin's wait for submitValue returned; the GPU finished then, or earlier if the wait did not block
+  std::chrono::steady_clock::time_point completeTime;
+  bool submitted;
+};
+
+// Ring of 1 to MAX_DEPTH frame contexts. More frames in flight keep the GPU busier at the cost of latency:
+// the CPU runs up to depth - 1 frames ahead of the one on screen
+class FrameRing
+{
+public:
+  static constexpr uint32_t MAX_DEPTH = 4;
+  // Starting sizes, the arenas grow to the largest frame seen
+  static constexpr size_t ARENA_SIZE = 256 * 1024;
+  static constexpr size_t WORKER_ARENA_SIZE = 64 * 1024;
+
+private:
+  VkDevice device;
+  QueueTimeline& timeline;
+  std::vector<FrameContext> frames;
+  std::vector<std::unique_ptr<FrameArena>> arenas;
+  uint32_t current;
+
+  // Accumulated since the last take
+  double waitSeconds;
+  double latencySeconds;
+  uint32_t latencyCount;
+  uint32_t frameCount;
+
+public:
+  // Frames are submitted to timeline's queue, whose family is queueFamily. Their compute submissions must be waited
+  // for by the graphics one, so that completing it retires both. poisonArenas fills released arena memory
+  FrameRing(
+    VkDevice device, QueueTimeline& timeline, uint32_t queueFamily, uint32_t depth,
+    uint32_t computeFamily = UINT32_MAX, bool poisonArenas = false
+  );
+  ~FrameRing();
+
+  // Waits until the next context's previous submission has finished and resets its command pools and arena
+  FrameContext& begin();
+  // After the submission that reaches submitValue on the timeline, moves the ring on
+  void end(uint64_t submitValue);
+
+  uint32_t getDepth() const { return static_cast<uint32_t>(frames.size()); }
+  FrameContext& get(uint32_t index) { return frames[index]; }
+
+  // Average CPU time blocked on the timeline per frame and average time from begin to the completion seen
+  // by a later begin, in milliseconds, since the last call
+  void takeTimings(double& waitMilliseconds, double& latencyMilliseconds);
+  // Peak arena bytes of any frame, and heap allocations the arenas themselves made since the last call;
+  // the latter stays at zero once the arenas have grown to fit, allocations elsewhere are not counted
+  size_t getArenaHighWater() const;
+  uint32_t takeArenaHeapAllocations();
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef FRAME_LIMITER_HPP
+#define FRAME_LIMITER_HPP
+
+#include <chrono>
+
+// Frame rate cap on the steady clock: sleeps until shortly before the next frame is due and spins the rest,
+// because sleeps wake up late by up to a scheduler tick. The margin left for spinning follows the worst
+// oversleep seen. Frame start intervals are measured with or without a cap, for the jitter report
+class FrameLimiter
+{
+public:
+  // Bounds of the spin margin: a late wake-up never costs more than MAX_SPIN of busy waiting
+  static constexpr std::chrono::microseconds MIN_SPIN{200};
+  static constexpr std::chrono::microseconds MAX_SPIN{4000};
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::duration interval;  // zero without a cap
+  Clock::time_point nextFrame;
+  Clock::time_point lastFrame;
+  Clock::duration spinMargin;
+
+  // Frame start intervals since the last take, in milliseconds
+  double intervalSum;
+  double intervalSquares;
+  double intervalMax;
+  uint32_t intervalCount;
+
+public:
+  // 0 frames per second turns the cap off
+  explicit FrameLimiter(uint32_t framesPerSecond);
+
+  void setLimit(uint32_t framesPerSecond);
+  uint32_t getLimit() const;
+
+  // At the start of every frame: blocks until the frame is due, then records the interval to the previous one
+  void wait();
+  // Mean interval, its standard deviation and the longest one, in milliseconds, since the last call
+  void takeIntervals(double& meanMilliseconds, double& jitterMilliseconds, double& maxMilliseconds);
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FULLSCREEN_PIPELINE_HPP
+#define FULLSCREEN_PIPELINE_HPP
+
+#include "pipeline_target.hpp"
+#include "shader.hpp"
+
+// One triangle covering the viewport, generated from gl_VertexIndex: no vertex input,
+// no depth test and no culling. Draw it with vkCmdDraw(commandBuffer, 3, 1, 0, 0).
+class FullscreenPipeline
+{
+private:
+  VkDevice device;
+  VkPipeline pipeline;
+
+public:
+  FullscreenPipeline(
+    VkDevice device, const PipelineTarget& target, const Shader& shader, VkPipelineLayout layout
+  );
+  ~FullscreenPipeline();
+
+  VkPipeline getPipeline() const { return pipeline; }
+};
+
+#endif
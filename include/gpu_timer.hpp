@@ -0,0 +1,34 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <vector>
+
+// GPU time of a whole frame from two timestamps at the start and the end of its command buffer.
+// Like PipelineStatistics, every frame in flight has its own query pair, read after that frame's fence.
+class GpuTimer
+{
+private:
+  VkDevice device;
+  VkQueryPool queryPool;
+  std::vector<bool> pending;
+  double period;          // nanoseconds per tick
+  uint64_t validMask;
+  double lastMilliseconds;
+
+public:
+  GpuTimer(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount);
+  ~GpuTimer();
+
+  bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+  // Once the frame's fence has signaled; returns false when no new measurement arrived
+  bool collect(uint32_t frame);
+  // First command of the frame, outside of any render pass
+  void begin(VkCommandBuffer commandBuffer, uint32_t frame);
+  // Last command of the frame
+  void end(VkCommandBuffer commandBuffer, uint32_t frame);
+
+  double getLastMilliseconds() const { return lastMilliseconds; }
+};
+
+#endif
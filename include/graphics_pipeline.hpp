@@ -1,8 +1,10 @@
 #ifndef GRAPHICS_PIPELINE_HPP
 #define GRAPHICS_PIPELINE_HPP
 
+#include "pipeline_target.hpp"
 #include "shader.hpp"
 #include "vertex.hpp"
+#include <map>
 #include <vector>
 
 class GraphicsPipeline
@@ -11,13 +13,33 @@ private:
     VkPipeline pipeline;
     VkDevice device;
 
+    // Everything a variant is created from; the shader must outlive the pipeline
+    const Shader& shader;
+    PipelineTarget target;
+    VkPipelineLayout layout;
+    VkCompareOp depthCompareOp;
+    bool depthWrite;
+    VkSampleCountFlagBits samples;
+
+    // Specialized pipelines by their constants, the default one included
+    std::map<SpecializationConstants, VkPipeline> variants;
+
+    VkPipeline createVariant(const SpecializationConstants& constants) const;
+
 public:
+  // After a depth pre-pass: EQUAL compare with depth writes off.
+  // samples must match the target's attachments.
+  // constants are added to the shader's for the default pipeline
   GraphicsPipeline(
-    VkDevice device, VkExtent2D extent, VkRenderPass renderPass, const Shader& shader, VkPipelineLayout layout
+    VkDevice device, VkExtent2D extent, const PipelineTarget& target, const Shader& shader, VkPipelineLayout layout,
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS, bool depthWrite = true,
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, const SpecializationConstants& constants = {}
   );
   ~GraphicsPipeline();
 
   VkPipeline getPipeline() const { return pipeline; }
+  // The pipeline specialized with constants on top of the shader's, created on first use
+  VkPipeline getPipeline(const SpecializationConstants& constants);
 };
 
 #endif
@@ -4,51 +4,144 @@
 #include "window.hpp"
 #include "input_device.hpp"
 #include "timer.hpp"
+#include "frame_limiter.hpp"
+#include "latency_tracker.hpp"
 #include "vulkan_device.hpp"
 #include "swap_chain.hpp"
 #include "shader.hpp"
 #include "uniform_buffer.hpp"
+#include "late_latch.hpp"
+#include "mip_feedback.hpp"
 #include "cube.hpp"
 #include "graphics_pipeline.hpp"
+#include "depth_pipeline.hpp"
+#include "fullscreen_pipeline.hpp"
+#include "pipeline_statistics.hpp"
+#include "gpu_timer.hpp"
+#include "resolution_controller.hpp"
 #include "descriptor.hpp"
+#include "layout_cache.hpp"
 #include "depth_buffer.hpp"
+#include "render_target.hpp"
+#include "texture.hpp"
+#include "texture_streamer.hpp"
+#include "settings.hpp"
+#include "clustered_lighting.hpp"
+#include "shadow_map.hpp"
+#include "occlusion_culling.hpp"
+#include "post_process.hpp"
+#include "render_graph.hpp"
+#include "scene.hpp"
+#include "simulation.hpp"
+#include "frame_context.hpp"
+#include "frame_capture.hpp"
 
 #include <memory>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// constant_id of the lighting shaders, must match frag.glsl, gbuffer.glsl and deferred.glsl
+enum LightingConstant : uint32_t
+{
+  AMBIENT_STRENGTH_CONSTANT = 0,
+  SPECULAR_STRENGTH_CONSTANT = 1,
+  SHININESS_CONSTANT = 2,
+  LIGHT_LIMIT_CONSTANT = 3,
+  SHADOW_FILTER_SIZE_CONSTANT = 4
+};
+
 class HertraApp
 {
 private:
+  RenderSettings settings;
+
   std::unique_ptr<HertraWindow> window;
   std::unique_ptr<InputDevice> inputDevice;
   std::unique_ptr<Timer> timer;
+  std::unique_ptr<FrameLimiter> frameLimiter;
+  std::unique_ptr<LatencyTracker> latencyTracker;
 
   std::unique_ptr<GraphicsPipeline> pipeline;
+  std::unique_ptr<DepthPipeline> depthPipeline;
+  std::unique_ptr<FullscreenPipeline> lightingPipeline;  // only with deferred shading
+  std::unique_ptr<PipelineStatistics> pipelineStatistics;
+  std::unique_ptr<GpuTimer> gpuTimer;
+  std::unique_ptr<ResolutionController> resolutionController;
   std::unique_ptr<Descriptor> descriptor;
+  std::unique_ptr<ClusteredLighting> lighting;
+  std::unique_ptr<ShadowMap> shadowMap;
+  std::unique_ptr<OcclusionCulling> occlusion;
+  std::unique_ptr<PostProcess> postProcess;
   std::unique_ptr<Cube> cube;
+  std::unique_ptr<SamplerCache> samplerCache;
+  std::unique_ptr<LayoutCache> layoutCache;
+  std::unique_ptr<Texture> texture;
+  std::unique_ptr<TextureStreamer> textureStreamer;
   std::unique_ptr<UniformBuffer> uniformBuffer;
+  std::unique_ptr<LateLatch> lateLatch;
+  std::unique_ptr<MipFeedback> mipFeedback;
   std::unique_ptr<DepthBuffer> depthBuffer;
+  std::unique_ptr<RenderTarget> gbufferAlbedo;
+  std::unique_ptr<RenderTarget> gbufferNormal;
   std::unique_ptr<Shader> shader;
+  std::unique_ptr<Shader> lightingShader;
   std::unique_ptr<SwapChain> swapChain;
+  std::unique_ptr<FrameRing> frames;
+  // Scene pass to presentation, rebuilt with the swapchain; owns the scene, MSAA and post targets
+  std::unique_ptr<RenderGraph> frameGraph;
+  std::unique_ptr<FrameCapture> frameCapture;  // null without HERTRA_CAPTURE
+  std::unique_ptr<QueueTimeline> graphicsTimeline;
+  std::unique_ptr<QueueTimeline> computeTimeline;  // null when light binning stays on the graphics queue
   std::unique_ptr<VulkanDevice> device;
 
   VkInstance instance;
+  uint32_t apiVersion;
   VkSurfaceKHR surface;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass;  // null with dynamic rendering
+  bool dynamicRendering;
   VkCommandPool commandPool;
-  std::vector<VkCommandBuffer> commandBuffers;
+  VkSampleCountFlagBits msaaSamples;
+  VkExtent2D renderExtent;  // scene area inside the full-size render targets
   std::vector<VkFramebuffer> swapChainFramebuffers;
+  uint64_t presentId;  // of the newest present to the current swapchain, with present wait
+
+  GraphResource swapChainTarget;
+  GraphResource depthTarget;
+  GraphResource sceneTarget;  // HDR target, scene target or the swapchain image itself
+  GraphResource msaaColorTarget;  // NO_RESOURCE without MSAA
+  GraphResource msaaDepthTarget;
+  GraphResource upscaleSource;  // blitted into the swapchain image when rendering offscreen
+  // Owned by their modules, which are created after the graph, and bound every frame
+  GraphResource shadowTarget;
+  GraphResource shadowCacheTarget;
+  GraphResource hiZTarget;
+  // Set while the frame graph records, for its passes
+  const FrameContext* recordingFrame;
+  uint32_t recordingImage;
+  DrawStats sceneDrawStats;  // since the last statistics line
+
+  std::vector<SceneObject> sceneObjects;  // the scene as created, simulation steps start from it
+  uint64_t staticSceneVersion;  // bump whenever a static object changes
+  size_t spinningCube;
 
-  std::vector<VkSemaphore> imageAvailableSemaphores;
-  std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
+  // With the simulation thread the render thread only reads its snapshots,
+  // otherwise inlineSnapshot is stepped once per frame before rendering
+  std::unique_ptr<Simulation> simulation;
+  FrameSnapshot inlineSnapshot;
 
-  uint32_t currentFrame;
+  uint32_t cubeTexture;
   bool running;
 
-  static const int MAX_FRAMES_IN_FLIGHT = 2;
+  // Orbit of the camera around the origin on top of the simulated view, dragged with the left mouse button
+  float orbitYaw;
+  float orbitPitch;
+  double cursorX;
+  double cursorY;
+  bool dragging;
+  // Set by the first drag not yet in a submitted frame, with the time it was sampled
+  bool inputPending;
+  LatencyTracker::Clock::time_point inputTime;
 
   void initVulkan();
   void createInstance();
@@ -56,16 +149,57 @@ private:
   void createRenderPass();
   void createCommandPool();
   void createFramebuffers();
-  void createCommandBuffers();
-  void createSyncObjects();
+  void recreateSwapChain();
   void createDepthBuffer();
+  bool canBlitToSwapChain();
+  void setupDynamicResolution();
+  void createRenderTargets();
+  void buildFrameGraph();
+  void createTexture();
+  void createScene();
+  void recordCommandBuffer(const FrameContext& frame, uint32_t imageIndex, const FrameSnapshot& snapshot);
+  void recordScene(VkCommandBuffer commandBuffer);
+  // Records and submits the frame's light binning to the compute queue, returns the value graphics waits for
+  uint64_t submitCompute(const FrameContext& frame);
+  // Scene pass as a render pass with its subpasses, or as dynamic rendering instances
+  // with the same attachments; the frame graph transitions them before and after
+  void beginScenePass(VkCommandBuffer commandBuffer);
+  void nextScenePass(VkCommandBuffer commandBuffer);
+  void endScenePass(VkCommandBuffer commandBuffer);
+  void beginSceneRendering(VkCommandBuffer commandBuffer, bool depthOnly, bool loadDepth);
+  // View the scene color ends up in: HDR target, scene target or swapchain image
+  VkImageView getSceneColorView(uint32_t imageIndex) const;
+  void recordUpscale(VkCommandBuffer commandBuffer);
+  // Format of the scene color attachments
+  VkFormat getColorFormat() const
+  {
+    return postProcess ? PostProcess::HDR_FORMAT : swapChain->getImageFormat();
+  }
+  // Stage that first writes the swapchain image: the upscaling blit or the scene pass
+  VkPipelineStageFlags getAcquireStage() const
+  {
+    return resolutionController || postProcess ?
+      VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  }
   void cleanup();
   void processInput();
+  // Before a frame starts: waits for the previous present to reach the screen, then for the frame limiter
+  void paceFrame();
   void drawFrame();
-  void updateUniformBuffer(uint32_t currentImage);
+  void updateUniformBuffer(uint32_t frame, const FrameSnapshot& snapshot);
+  // Reads the mouse into the orbit; called at the start of the frame and again by the late latch
+  void sampleInput();
+  glm::mat4 getView(const FrameSnapshot& snapshot) const;
+  glm::mat4 getProjection(const FrameSnapshot& snapshot) const;
+  // Writes the camera of the newest orbit for the scene passes of frame
+  void latchCamera(uint32_t frame, const FrameSnapshot& snapshot);
+  FrameSnapshot createSnapshot() const;
+  // Game logic: animates the scene, camera and lights. Runs on the simulation thread when there is one,
+  // so it may only read state that is fixed after initVulkan
+  void simulate(float time, FrameSnapshot& snapshot) const;
 
 public:
-  HertraApp();
+  explicit HertraApp(const RenderSettings& settings = {});
   ~HertraApp();
 
   void run();
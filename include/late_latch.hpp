@@ -0,0 +1,33 @@
+#ifndef LATE_LATCH_HPP
+#define LATE_LATCH_HPP
+
+#include <glm/glm.hpp>
+
+// Matches LatchedCamera in the shaders (std140)
+struct LatchedCamera
+{
+  alignas(16) glm::mat4 viewProj;
+  alignas(16) glm::mat4 invViewProj;
+  alignas(16) glm::vec4 viewPos;  // eye position in xyz, for specular
+};
+
+// Small mapped buffer with a camera slice per frame in flight. The slice is written after the frame's commands
+// are recorded, right before they are submitted, so it may only be read by that submission
+class LateLatch
+{
+private:
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  char* mapped;
+  VkDeviceSize sliceSize;
+  VkDevice device;
+
+public:
+  LateLatch(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount);
+  ~LateLatch();
+
+  void write(uint32_t frame, const LatchedCamera& camera);
+  VkDescriptorBufferInfo getDescriptorInfo(uint32_t frame) const;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef LATENCY_TRACKER_HPP
+#define LATENCY_TRACKER_HPP
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+// Input-to-display latency: every frame that carries new input is tagged with the time that input was first
+// sampled, and measured when its completion is observed. Frames are numbered by present id or timeline value.
+// Storage is fixed up front, the frame loop allocates nothing here
+class LatencyTracker
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Frames whose completion is never seen, e.g. presents of a minimized window, are dropped beyond this
+  static constexpr size_t MAX_PENDING = 16;
+  // Latencies kept between takes, later ones are dropped until the next take
+  static constexpr size_t MAX_SAMPLES = 4096;
+
+private:
+  struct PendingFrame
+  {
+    uint64_t id;
+    Clock::time_point inputTime;
+  };
+
+  std::array<PendingFrame, MAX_PENDING> pending;  // ring of ascending ids
+  size_t pendingFirst;
+  size_t pendingCount;
+  std::vector<double> latencies;  // milliseconds, since the last take
+
+public:
+  LatencyTracker();
+
+  void submit(uint64_t id, Clock::time_point inputTime);
+  // Every frame up to id was complete at completeTime
+  void complete(uint64_t id, Clock::time_point completeTime = Clock::now());
+  // Ids restart with a new swapchain
+  void discardPending() { pendingCount = 0; }
+
+  // Nearest-rank percentiles of the latencies since the last call, in milliseconds; returns their count
+  size_t takePercentiles(double& p50, double& p90, double& p99);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LAYOUT_CACHE_HPP
+#define LAYOUT_CACHE_HPP
+
+#include "shader_reflection.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+// Descriptor set and pipeline layouts deduplicated by content hash: shaders with the same interface
+// share one handle, so their pipelines are layout compatible and no redundant objects are created
+class LayoutCache
+{
+private:
+  struct SetLayoutKey
+  {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;  // sorted by binding
+    bool operator==(const SetLayoutKey& other) const;
+  };
+
+  struct PipelineLayoutKey
+  {
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    VkPushConstantRange pushConstants;
+    bool operator==(const PipelineLayoutKey& other) const;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const SetLayoutKey& key) const;
+    size_t operator()(const PipelineLayoutKey& key) const;
+  };
+
+  VkDevice device;
+  std::unordered_map<SetLayoutKey, VkDescriptorSetLayout, KeyHash> setLayouts;
+  std::unordered_map<PipelineLayoutKey, VkPipelineLayout, KeyHash> pipelineLayouts;
+
+public:
+  explicit LayoutCache(VkDevice device);
+  ~LayoutCache();
+
+  VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  VkDescriptorSetLayout getSetLayout(const ShaderReflection& reflection, uint32_t set);
+  // Every set of the reflection in order, unused indices get an empty layout
+  VkPipelineLayout getPipelineLayout(const ShaderReflection& reflection);
+
+  size_t getSetLayoutCount() const { return setLayouts.size(); }
+  size_t getPipelineLayoutCount() const { return pipelineLayouts.size(); }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MIP_FEEDBACK_HPP
+#define MIP_FEEDBACK_HPP
+
+// Mapped buffer with a slice per frame in flight: the fragment shaders atomicMin the finest mip level they
+// sample from the scene texture into it (MipFeedback in the shaders), the texture streamer turns it into demand
+class MipFeedback
+{
+private:
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  char* mapped;
+  VkDeviceSize sliceSize;
+  VkDevice device;
+
+public:
+  MipFeedback(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount);
+  ~MipFeedback();
+
+  // Once the frame's previous submission completed: its finest sampled level, UINT32_MAX if nothing sampled.
+  // Resets the slice for the next use
+  uint32_t collect(uint32_t frame);
+  // After the scene passes, makes the shader writes visible to collect
+  void record(VkCommandBuffer commandBuffer) const;
+  VkDescriptorBufferInfo getDescriptorInfo(uint32_t frame) const;
+};
+
+#endif
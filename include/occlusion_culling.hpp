@@ -0,0 +1,155 @@
+#ifndef OCCLUSION_CULLING_HPP
+#define OCCLUSION_CULLING_HPP
+
+#include "compute_pipeline.hpp"
+#include "depth_buffer.hpp"
+#include "depth_pipeline.hpp"
+#include "draw_queue.hpp"
+#include "layout_cache.hpp"
+#include "queue_timeline.hpp"
+#include "scene.hpp"
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Matches ObjectData in cull.comp, vert.glsl and depth.glsl (std430)
+struct ObjectData
+{
+  glm::mat4 model;
+  glm::vec4 boundsMin;  // world-space AABB
+  glm::vec4 boundsMax;
+};
+
+// Matches DrawCommand in the shaders, laid out as VkDrawIndexedIndirectCommand
+struct DrawCommand
+{
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t firstInstance;
+};
+
+// GPU-driven Hi-Z occlusion culling in two phases:
+//  1. objects visible last frame are drawn depth-only as occluders,
+//  2. that depth is reduced into a max-depth mip pyramid and every object's bounds are tested against it.
+// The survivors are drawn with one indirect instanced draw and become the next frame's occluders,
+// so objects that come into view are found in the same frame instead of popping in a frame late.
+// Every step is a frame graph pass, the graph orders them and the draws reading the lists.
+class OcclusionCulling
+{
+public:
+  // Keep in sync with MAX_OBJECTS in the shaders
+  static const uint32_t MAX_OBJECTS = 4096;
+  // Draw lists in the draw buffer, selected with the push constant
+  static const uint32_t OCCLUDER_LIST = 0;
+  static const uint32_t VISIBLE_LIST = 1;
+
+private:
+  // Cull shader modes, see cull.comp
+  static const uint32_t MODE_OCCLUDERS = 0;
+  static const uint32_t MODE_HIZ = 1;
+  static const uint32_t MODE_FRUSTUM = 2;
+
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkSampler sampler;
+  bool hiZEnabled;
+  uint32_t indexCount;
+  uint32_t objectCount;
+  bool historyCleared;
+
+  // Per-frame object data, the draw lists and last frame's visibility
+  std::vector<VkBuffer> objectBuffers;
+  std::vector<VkDeviceMemory> objectBuffersMemory;
+  std::vector<void*> objectBuffersMapped;
+  VkBuffer drawBuffer;
+  VkDeviceMemory drawBufferMemory;
+  VkDeviceSize drawBufferSize;
+  VkBuffer historyBuffer;
+  VkDeviceMemory historyBufferMemory;
+
+  // Per-frame readback of the list sizes
+  std::vector<VkBuffer> statsBuffers;
+  std::vector<VkDeviceMemory> statsBuffersMemory;
+  std::vector<void*> statsBuffersMapped;
+  std::vector<bool> statsPending;
+  uint32_t occluderCount;
+  uint32_t drawnCount;
+
+  // Occluder pass into the main depth buffer
+  VkRenderPass occluderPass;
+  VkFramebuffer occluderFramebuffer;
+  VkExtent2D depthExtent;
+  VkImageView depthView;
+  std::unique_ptr<DepthPipeline> occluderPipeline;
+
+  // Hi-Z pyramid, level 0 is half the depth resolution rounded up to a power of two
+  VkImage pyramid;
+  VkDeviceMemory pyramidMemory;
+  VkImageView pyramidView;
+  std::vector<VkImageView> levelViews;
+  std::vector<VkExtent2D> levelExtents;
+
+  VkDescriptorSetLayout reduceSetLayout;  // both layouts are owned by the layout cache
+  VkPipelineLayout reduceLayout;
+  VkDescriptorPool reducePool;
+  std::vector<VkDescriptorSet> reduceSets;
+  std::unique_ptr<ComputePipeline> reducePipeline;
+  std::unique_ptr<ComputePipeline> cullPipeline;
+
+  void createOccluderPass(VkFormat depthFormat);
+  void createPyramid(VkCommandPool commandPool, QueueTimeline& queue);
+  void destroyPyramid();
+  void dispatchCull(
+    VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet, uint32_t mode
+  );
+
+public:
+  OcclusionCulling(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue,
+    uint32_t frameCount, const DepthBuffer& depthBuffer, VkSampler sampler,
+    VkPipelineLayout layout, LayoutCache& layouts, uint32_t indexCount, bool hiZEnabled
+  );
+  ~OcclusionCulling();
+
+  // After the depth buffer was recreated; descriptors using the pyramid must be rewritten
+  void resize(VkCommandPool commandPool, QueueTimeline& queue, const DepthBuffer& depthBuffer);
+
+  void updateObjects(uint32_t frame, const std::vector<SceneObject>& objects);
+  // Graph passes, outside of any render pass, in this order:
+  //  1. reset: the draw lists (transfer destination), and the visibility history on the first frame,
+  //  2. with Hi-Z, occluder list: last frame's visible set becomes the occluder list (storage),
+  //  3. with Hi-Z, occluders: the list drawn depth-only (indirect and vertex reads, depth attachment); renderExtent
+  //     is the rendered corner of the depth buffer, the rest stays at the far plane,
+  //  4. with Hi-Z, pyramid: the depth (sampled) reduced into the pyramid (storage, GENERAL),
+  //  5. cull: every object against the pyramid, or the frustum alone, into the visible list (storage),
+  //  6. statistics: the list sizes copied out for collect (transfer source).
+  void recordReset(VkCommandBuffer commandBuffer);
+  void recordOccluderList(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet);
+  void recordOccluders(
+    VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet,
+    VkBuffer positionBuffer, VkBuffer indexBuffer, VkExtent2D renderExtent
+  );
+  void recordPyramid(VkCommandBuffer commandBuffer);
+  void recordCull(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet);
+  void recordStatistics(VkCommandBuffer commandBuffer, uint32_t frame);
+  // The visible set as one instanced draw, its instances read the list VISIBLE_LIST in the push constant selects
+  DrawIndirect getVisibleDraw() const { return {drawBuffer, sizeof(DrawCommand) * VISIBLE_LIST}; }
+  // Once the frame's fence has signaled
+  void collect(uint32_t frame);
+
+  VkDescriptorBufferInfo getObjectBufferInfo(uint32_t frame) const;
+  VkDescriptorBufferInfo getDrawBufferInfo() const;
+  VkDescriptorBufferInfo getHistoryBufferInfo() const;
+  VkDescriptorImageInfo getPyramidInfo() const;
+  // Rests in GENERAL, recreated by resize
+  VkImage getPyramid() const { return pyramid; }
+  uint32_t getObjectCount() const { return objectCount; }
+  uint32_t getOccluderCount() const { return occluderCount; }
+  uint32_t getDrawnCount() const { return drawnCount; }
+  bool isHiZEnabled() const { return hiZEnabled; }
+};
+
+#endif
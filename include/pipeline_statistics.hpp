@@ -0,0 +1,67 @@
+#ifndef PIPELINE_STATISTICS_HPP
+#define PIPELINE_STATISTICS_HPP
+
+#include <array>
+#include <vector>
+
+// Passes with their own statistics query; each is begun and ended in one subpass or outside render passes
+enum class StatisticsPass : uint32_t
+{
+  Shadows,     // every cascade re-rendered this frame
+  Occluders,   // occluder depth, Hi-Z reduction and culling
+  DepthPrepass,
+  Color,       // forward shading or the G-buffer
+  Lighting,    // deferred full-screen lighting
+  Count
+};
+
+// One query's results, in the order Vulkan writes the enabled statistics
+struct PipelineCounters
+{
+  uint64_t inputVertices;
+  uint64_t inputPrimitives;
+  uint64_t vertexInvocations;
+  uint64_t clippingInvocations;  // primitives that reached clipping
+  uint64_t clippingPrimitives;   // primitives that left it
+  uint64_t fragmentInvocations;
+};
+
+// Pipeline statistics queries around the frame's passes. Every frame in flight has its own queries,
+// read once that frame's submission has completed, so the GPU never stalls on them
+class PipelineStatistics
+{
+public:
+  static constexpr uint32_t PASS_COUNT = static_cast<uint32_t>(StatisticsPass::Count);
+
+private:
+  VkDevice device;
+  VkQueryPool queryPool;
+  std::vector<uint32_t> written;  // per frame, a bit per pass ended since the last collect
+  std::array<PipelineCounters, PASS_COUNT> totals;
+  std::array<uint32_t, PASS_COUNT> samples;
+
+  uint32_t queryIndex(uint32_t frame, StatisticsPass pass) const
+  {
+    return frame * PASS_COUNT + static_cast<uint32_t>(pass);
+  }
+
+public:
+  // supported: the pipelineStatisticsQuery feature is enabled on the device; false leaves every call a no-op
+  PipelineStatistics(VkDevice device, bool supported, uint32_t frameCount);
+  ~PipelineStatistics();
+
+  bool isEnabled() const { return queryPool != VK_NULL_HANDLE; }
+  static const char* passName(StatisticsPass pass);
+
+  // Once the frame's submission has completed: accumulates the results last written to its queries
+  void collect(uint32_t frame);
+  // Recorded outside of render passes, before the frame's first begin
+  void reset(VkCommandBuffer commandBuffer, uint32_t frame);
+  void begin(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass);
+  void end(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass);
+
+  // Per-frame averages of each pass since the last call, over the frames it ran in; returns those counts
+  std::array<uint32_t, PASS_COUNT> takeAverages(std::array<PipelineCounters, PASS_COUNT>& averages);
+};
+
+#endif
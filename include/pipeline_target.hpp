@@ -0,0 +1,27 @@
+#ifndef PIPELINE_TARGET_HPP
+#define PIPELINE_TARGET_HPP
+
+#include <vector>
+
+// Where a graphics pipeline draws: a subpass of a render pass, or without one a dynamic rendering
+// instance with the same attachment formats, which any pass with those formats can reuse
+struct PipelineTarget
+{
+  VkRenderPass renderPass;
+  uint32_t subpass;
+  uint32_t colorAttachmentCount;
+  // Dynamic rendering only
+  std::vector<VkFormat> colorFormats;
+  VkFormat depthFormat;
+
+  // colorAttachmentCount must match the subpass, e.g. 2 for the G-buffer
+  explicit PipelineTarget(VkRenderPass renderPass, uint32_t subpass = 0, uint32_t colorAttachmentCount = 1);
+  // Dynamic rendering, depth only without colorFormats
+  explicit PipelineTarget(VkFormat depthFormat, const std::vector<VkFormat>& colorFormats = {});
+
+  // Sets the render pass of pipelineInfo, or chains renderingInfo filled with the formats;
+  // renderingInfo must live until the pipeline is created
+  void apply(VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo) const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef POST_PROCESS_HPP
+#define POST_PROCESS_HPP
+
+#include "compute_pipeline.hpp"
+#include "draw_queue.hpp"
+#include "layout_cache.hpp"
+#include "queue_timeline.hpp"
+#include "render_graph.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// Compute post chain behind the FP16 scene target:
+//  1. prefilter: one pass over the HDR image builds the first bloom level from a shared-memory tile
+//     and the log-luminance histogram of the same texels,
+//  2. exposure: the histogram average adapts the exposure, on the GPU,
+//  3. bloom: downsample and upsample over a half-resolution mip chain,
+//  4. resolve: bloom composite, exposure, tonemap, sRGB encode and dither in a single pass into an 8-bit image.
+// Full resolution is read twice and written once; the output is blitted into the swapchain.
+// The targets are render graph transients: the bloom chain and the output can share memory with
+// whatever the scene pass is done with by then
+class PostProcess
+{
+public:
+  static const VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+  static const VkFormat OUTPUT_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+  // Mips of the bloom chain, level 0 is half resolution
+  static const uint32_t MAX_BLOOM_LEVELS = 6;
+
+private:
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkSampler sampler;
+  bool encodeSrgb;
+  uint32_t frameIndex;
+  std::chrono::steady_clock::time_point lastRecord;
+  float deltaTime;  // drives the exposure adaptation
+
+  // Histogram bins followed by the adapted exposure, see LuminanceBuffer in the shaders
+  VkBuffer luminanceBuffer;
+  VkDeviceMemory luminanceBufferMemory;
+
+  GraphResource hdr;
+  GraphResource bloom;
+  GraphResource output;
+  VkImageView hdrView;
+  std::vector<VkImageView> levelViews;
+  std::vector<VkExtent2D> levelExtents;
+  std::vector<VkExtent2D> validExtents;  // rendered part of every bloom level
+
+  VkDescriptorSetLayout setLayout;  // both layouts are owned by the layout cache
+  VkPipelineLayout layout;
+  VkDescriptorPool pool;
+  // Prefilter, downsample per level, upsample per level, resolve
+  std::vector<VkDescriptorSet> sets;
+  // Bound by the pass being recorded: the chain reuses its pipelines level after level
+  VkPipeline boundPipeline;
+  VkDescriptorSet boundSet;
+  DrawStats drawStats;
+
+  std::unique_ptr<ComputePipeline> prefilterPipeline;
+  std::unique_ptr<ComputePipeline> exposurePipeline;
+  std::unique_ptr<ComputePipeline> downsamplePipeline;
+  std::unique_ptr<ComputePipeline> upsamplePipeline;
+  std::unique_ptr<ComputePipeline> resolvePipeline;
+
+  void createLayout(LayoutCache& layouts);
+  void createLuminanceBuffer(VkCommandPool commandPool, QueueTimeline& queue);
+  void destroyViews();
+  void writeSet(
+    VkDescriptorSet set, VkImageView source, VkImageView destination, VkImageView bloomSource, VkImageView outputView
+  );
+  void dispatch(
+    VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet set,
+    VkExtent2D sourceSize, VkExtent2D destinationSize, VkExtent2D groups
+  );
+  // Steps 1-3 and step 4 of the chain, the two graph passes
+  void recordBloom(VkCommandBuffer commandBuffer, VkExtent2D renderExtent);
+  void recordResolve(VkCommandBuffer commandBuffer, VkExtent2D renderExtent);
+
+public:
+  // encodeSrgb when the swapchain format stores the values as they are, e.g. B8G8R8A8_UNORM
+  PostProcess(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue,
+    VkSampler sampler, bool encodeSrgb, LayoutCache& layouts
+  );
+  ~PostProcess();
+
+  // Adds the bloom and resolve passes reading hdrTarget, a target of the given size, and returns the
+  // 8-bit output. renderExtent is read when the passes execute: the rendered corner of the HDR target
+  GraphResource addPasses(
+    RenderGraph& graph, GraphResource hdrTarget, VkExtent2D extent, const VkExtent2D& renderExtent
+  );
+  // Once the graph is compiled: views and descriptor sets for its images
+  void bind(const RenderGraph& graph);
+
+  uint32_t getBloomLevelCount() const { return static_cast<uint32_t>(levelExtents.size()); }
+  // Dispatches and binds since the last call
+  DrawStats takeDrawStats();
+};
+
+#endif
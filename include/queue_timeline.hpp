@@ -0,0 +1,88 @@
+#ifndef QUEUE_TIMELINE_HPP
+#define QUEUE_TIMELINE_HPP
+
+#include "vulkan_device.hpp"
+
+#include <deque>
+#include <span>
+#include <utility>
+#include <vector>
+
+class QueueTimeline;
+
+// Binary semaphore a submission waits for, such as a swapchain image acquire
+struct SemaphoreWait
+{
+  VkSemaphore semaphore;
+  VkPipelineStageFlags stages;
+};
+
+// Point on a queue's timeline a submission depends on
+struct TimelineWait
+{
+  QueueTimeline* timeline;
+  uint64_t value;
+  VkPipelineStageFlags stages;
+};
+
+// Queue family ownership transfer of an exclusive buffer. The release is recorded on the queue giving it up, the
+// acquire on the one taking it over, in a submission that waits for the release's at dstStages or earlier.
+// Between queues of one family the semaphore is the whole dependency and both halves record nothing
+struct BufferTransfer
+{
+  VkBuffer buffer;
+  uint32_t srcFamily;
+  uint32_t dstFamily;
+
+  bool isNeeded() const { return srcFamily != dstFamily; }
+  void release(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess) const;
+  void acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) const;
+};
+
+// One counter per queue: each submission signals the next value, so CPU waits, waits of other queues and
+// resource retirement are all "until value N". Without timeline semaphores every submission gets a pooled fence
+// instead and waits on other queues are done on the CPU before submitting. Render thread only
+class QueueTimeline
+{
+public:
+  static const uint32_t MAX_WAITS = 8;
+  static const uint32_t MAX_SIGNALS = 4;
+
+private:
+  const VulkanDevice& device;
+  VkQueue queue;
+  VkSemaphore semaphore;  // null in the fence fallback
+  uint64_t submittedValue;
+  uint64_t completedValue;  // newest value known to have completed
+
+  // Fence fallback: fences of submissions in flight in submission order, and reset ones to reuse
+  std::deque<std::pair<uint64_t, VkFence>> pendingFences;
+  std::vector<VkFence> freeFences;
+
+  VkFence acquireFence();
+  void retireFence();
+
+public:
+  QueueTimeline(const VulkanDevice& device, VkQueue queue, bool useTimelineSemaphore);
+  ~QueueTimeline();
+
+  QueueTimeline(const QueueTimeline&) = delete;
+  QueueTimeline& operator=(const QueueTimeline&) = delete;
+
+  // Returns the value reached once commandBuffers have executed; signals also gets the binary semaphores
+  uint64_t submit(
+    std::span<const VkCommandBuffer> commandBuffers, std::span<const SemaphoreWait> waits = {},
+    std::span<const TimelineWait> after = {}, std::span<const VkSemaphore> signals = {}
+  );
+
+  bool isComplete(uint64_t value);
+  void wait(uint64_t value);
+  uint64_t getCompletedValue();
+  // Value of the newest submission, the one to wait for to drain the queue
+  uint64_t getSubmittedValue() const { return submittedValue; }
+
+  VkQueue getQueue() const { return queue; }
+  bool usesTimelineSemaphore() const { return semaphore != VK_NULL_HANDLE; }
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Index of an image or buffer declared to a render graph
+using GraphResource = uint32_t;
+const GraphResource NO_RESOURCE = UINT32_MAX;
+
+// How a pass uses a resource: picks the stages, access masks, image layout and usage flags
+enum class GraphAccess : uint32_t
+{
+  ColorAttachment,  // also as a resolve target
+  DepthAttachment,
+  SampledCompute,   // combined image sampler in SHADER_READ_ONLY_OPTIMAL
+  StorageCompute,   // storage image or buffer; images stay in GENERAL, sampling them there included
+  TransferSrc,
+  TransferDst,
+  IndirectRead,     // buffers only
+  SampledFragment,  // as SampledCompute, from fragment shaders
+  StorageGraphics   // as StorageCompute, from vertex and fragment shaders
+};
+
+// Layout and last use of an imported image outside the graph, or what it must be left in
+struct GraphState
+{
+  VkImageLayout layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+// Transient image made by the graph; its usage is gathered from the passes
+struct GraphImageDesc
+{
+  VkFormat format;
+  VkExtent2D extent;
+  uint32_t mipLevels = 1;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  VkImageUsageFlags extraUsage = 0;  // usage no declared access implies
+};
+
+// Frame graph: passes declare what they read and write, compile() works out the rest once:
+//  1. culling: passes whose results never reach an imported resource or a side effect are dropped,
+//  2. lifetimes: every transient lives from its first to its last remaining pass,
+//  3. aliasing: transients with disjoint lifetimes share one allocation, attachments that never leave
+//     the pass go to lazily allocated memory where the device has it,
+//  4. barriers: the accesses are replayed in pass order and each pass gets at most one batched
+//     vkCmdPipelineBarrier with its layout transitions and memory dependencies.
+// execute() then only records. The same graph runs every frame, so a resource's first use also waits
+// for the previous frame's last use of its memory. Built once, rebuilt when the targets change size
+class RenderGraph
+{
+public:
+  using Execute = std::function<void(VkCommandBuffer)>;
+
+  class PassBuilder
+  {
+  private:
+    RenderGraph& graph;
+    uint32_t pass;
+
+  public:
+    PassBuilder(RenderGraph& owner, uint32_t index) : graph(owner), pass(index) {}
+
+    PassBuilder& read(GraphResource resource, GraphAccess access);
+    PassBuilder& write(GraphResource resource, GraphAccess access);
+    // Never culled, e.g. passes writing queries the host reads
+    PassBuilder& sideEffect();
+  };
+
+private:
+  struct Use
+  {
+    GraphResource resource;
+    GraphAccess access;
+    bool write;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    Execute execute;
+    std::vector<Use> uses;
+    bool sideEffect;
+  };
+
+  struct Resource
+  {
+    std::string name;
+    bool isImage;
+    bool imported;
+    GraphImageDesc desc;
+    VkDeviceSize size;  // transient buffers
+    GraphState initial;  // imported images
+    GraphState final;  // UNDEFINED leaves an imported image as the graph ends
+    VkImageUsageFlags imageUsage;
+    VkBufferUsageFlags bufferUsage;
+
+    VkImage image;
+    VkImageView view;
+    VkBuffer buffer;
+    VkMemoryRequirements requirements;
+    uint32_t firstPass;  // in executed pass order, UINT32_MAX when no executed pass uses it
+    uint32_t lastPass;
+    GraphResource previous;  // last user of the same memory before this one, itself if nobody shares it
+  };
+
+  // Access history of one resource while the passes are replayed
+  struct Tracker
+  {
+    bool used;
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages;  // reads since the last write
+    VkPipelineStageFlags visibleStages;  // stages the last write was made visible to
+  };
+
+  struct Batch
+  {
+    VkPipelineStageFlags srcStages;
+    VkPipelineStageFlags dstStages;
+    VkMemoryBarrier memory;
+    std::vector<VkImageMemoryBarrier> images;
+    std::vector<GraphResource> imageResources;  // imported images may change between frames
+    bool empty;
+  };
+
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  std::vector<Pass> passes;
+  std::vector<Resource> resources;
+
+  std::vector<uint32_t> executed;  // pass indices that survived culling
+  std::vector<Batch> batches;  // before each executed pass, then the final transitions
+  std::vector<VkDeviceMemory> allocations;
+  VkDeviceSize transientBytes;
+  VkDeviceSize unaliasedBytes;
+  bool compiled;
+
+  void cull();
+  void allocateTransients(bool alias);
+  void replay(std::vector<Tracker>& trackers, std::vector<Batch>& output) const;
+  void recordBatch(VkCommandBuffer commandBuffer, Batch& batch) const;
+
+public:
+  RenderGraph(VkPhysicalDevice physicalDevice, VkDevice device);
+  ~RenderGraph();
+
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+  GraphResource createImage(const std::string& name, const GraphImageDesc& desc);
+  GraphResource createBuffer(const std::string& name, VkDeviceSize size);
+  // image may be null until setImage, e.g. the swapchain image acquired each frame
+  GraphResource importImage(
+    const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+    GraphState initial, GraphState final
+  );
+  // Buffers keep their contents across frames: their first use waits for last frame's final one
+  GraphResource importBuffer(const std::string& name, VkBuffer buffer);
+
+  PassBuilder addPass(const std::string& name, Execute execute);
+
+  // alias false gives every transient its own memory, to compare the footprint
+  void compile(bool alias = true);
+  void execute(VkCommandBuffer commandBuffer);
+
+  void setImage(GraphResource resource, VkImage image, VkImageView view);
+  VkImage getImage(GraphResource resource) const { return resources[resource].image; }
+  VkImageView getImageView(GraphResource resource) const { return resources[resource].view; }
+  VkBuffer getBuffer(GraphResource resource) const { return resources[resource].buffer; }
+  const GraphImageDesc& getDesc(GraphResource resource) const { return resources[resource].desc; }
+
+  uint32_t getExecutedPassCount() const { return static_cast<uint32_t>(executed.size()); }
+  VkDeviceSize getTransientBytes() const { return transientBytes; }
+  VkDeviceSize getUnaliasedBytes() const { return unaliasedBytes; }
+};
+
+#endif
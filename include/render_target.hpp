@@ -0,0 +1,35 @@
+#ifndef RENDER_TARGET_HPP
+#define RENDER_TARGET_HPP
+
+// Color or depth image used only as a framebuffer attachment.
+// With VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT the memory is lazily allocated where the device
+// offers it, so on tile-based GPUs a multisampled attachment that is resolved and discarded
+// inside the render pass never gets backing memory at all.
+class RenderTarget
+{
+private:
+  VkDevice device;
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView imageView;
+  VkFormat format;
+  VkExtent2D extent;
+  VkSampleCountFlagBits samples;
+  bool lazilyAllocated;
+
+public:
+  RenderTarget(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkFormat format, VkExtent2D extent,
+    VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspectMask
+  );
+  ~RenderTarget();
+
+  VkImage getImage() const { return image; }
+  VkImageView getImageView() const { return imageView; }
+  VkFormat getFormat() const { return format; }
+  VkExtent2D getExtent() const { return extent; }
+  VkSampleCountFlagBits getSamples() const { return samples; }
+  bool isLazilyAllocated() const { return lazilyAllocated; }
+};
+
+#endif
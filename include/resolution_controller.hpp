@@ -0,0 +1,32 @@
+#ifndef RESOLUTION_CONTROLLER_HPP
+#define RESOLUTION_CONTROLLER_HPP
+
+// Picks the render scale from measured GPU frame times.
+// The scale drops quickly once the smoothed time stays over the target and grows back slowly
+// only after a long stretch well under it; the gap between the two thresholds and a cooldown
+// after every change keep the resolution from oscillating.
+class ResolutionController
+{
+private:
+  float targetMilliseconds;
+  float minScale;
+  float maxScale;
+  float scale;
+  float smoothedMilliseconds;
+  uint32_t overBudgetFrames;
+  uint32_t underBudgetFrames;
+  uint32_t cooldownFrames;
+
+public:
+  ResolutionController(float targetMilliseconds, float minScale, float maxScale = 1.0f);
+
+  // One measured GPU frame time; returns true when the scale changed
+  bool update(float frameMilliseconds);
+
+  float getScale() const { return scale; }
+  float getSmoothedMilliseconds() const { return smoothedMilliseconds; }
+  // Render extent inside a target of maxExtent
+  VkExtent2D getExtent(VkExtent2D maxExtent) const;
+};
+
+#endif
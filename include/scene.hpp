@@ -0,0 +1,14 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <glm/glm.hpp>
+
+// One drawn instance of the cube mesh. Static objects never move, so their
+// shadow depth can be cached until the light or the cascade bounds change.
+struct SceneObject
+{
+  glm::mat4 model;
+  bool isStatic;
+};
+
+#endif
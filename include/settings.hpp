@@ -0,0 +1,116 @@
+#ifndef SETTINGS_HPP
+#define SETTINGS_HPP
+
+#include <string>
+
+// How captured frames are written
+enum class CaptureFormat : uint32_t
+{
+  Png,  // numbered files in a directory
+  Y4m,  // YUV 4:2:0 stream
+  Rgb   // raw 24-bit frames
+};
+
+// Renderer options; defaults can be overridden with HERTRA_* environment variables
+struct RenderSettings
+{
+  // Texture streaming: budget for loaded mips, the finest are clamped off over it (HERTRA_TEXTURE_BUDGET_MB)
+  VkDeviceSize textureBudget = 256ull * 1024 * 1024;
+  // Mips up to this size are loaded at startup (HERTRA_TEXTURE_INITIAL_SIZE)
+  uint32_t textureInitialSize = 128;
+
+  // Clustered lighting: number of animated point lights (HERTRA_LIGHTS)
+  uint32_t lightCount = 1024;
+
+  // Resolution of every shadow cascade (HERTRA_SHADOW_SIZE)
+  uint32_t shadowMapSize = 2048;
+  // Side of the PCF kernel baked into the lighting shaders, 0 turns sun shadows off (HERTRA_SHADOW_FILTER)
+  uint32_t shadowFilterSize = 2;
+
+  // Depth-only pre-pass, then shade with an EQUAL depth test (HERTRA_DEPTH_PREPASS=1)
+  bool depthPrepass = false;
+
+  // Multisample antialiasing: 1, 2, 4 or 8 samples, clamped to the device (HERTRA_MSAA)
+  uint32_t msaaSamples = 1;
+
+  // Dynamic resolution: the render scale follows the GPU frame time (HERTRA_DYNAMIC_RESOLUTION=1)
+  bool dynamicResolution = false;
+  // GPU frame time to aim for, in microseconds (HERTRA_TARGET_FRAME_US)
+  uint32_t targetFrameTime = 16667;
+  // Lowest render scale, percent of the window size (HERTRA_MIN_RENDER_SCALE)
+  uint32_t minRenderScale = 50;
+
+  // Hi-Z occlusion culling; frustum culling only when off (HERTRA_OCCLUSION_CULLING=0)
+  bool occlusionCulling = true;
+  // City blocks per side of the test scene (HERTRA_CITY_SIZE)
+  uint32_t cityGridSize = 16;
+
+  // Deferred shading through a G-buffer subpass and a lighting subpass (HERTRA_DEFERRED=1),
+  // single-sampled and without the depth pre-pass
+  bool deferred = false;
+
+  // FP16 scene target and the compute post chain: auto exposure, bloom, tonemap and dither
+  // (HERTRA_POST_PROCESS=0 renders straight into the swapchain)
+  bool postProcess = true;
+
+  // Scene pass through vkCmdBeginRendering where the device supports it; deferred shading keeps the
+  // render pass for its input attachments (HERTRA_DYNAMIC_RENDERING=0 always uses render passes)
+  bool dynamicRendering = true;
+
+  // Game logic on its own thread at a fixed rate, the render thread draws its newest snapshot
+  // (HERTRA_SIMULATION_THREAD=1); otherwise it runs once per frame before rendering
+  bool simulationThread = false;
+  // Simulation steps per second on that thread (HERTRA_SIMULATION_HZ)
+  uint32_t simulationRate = 120;
+
+  // Frames the CPU may record ahead of the GPU, 1 to 4 (HERTRA_FRAMES_IN_FLIGHT); more hides
+  // CPU and GPU spikes at the cost of input latency
+  uint32_t framesInFlight = 2;
+  // Queue submissions tracked by a timeline semaphore where the device has them
+  // (HERTRA_TIMELINE_SEMAPHORES=0 uses a fence per submission)
+  bool timelineSemaphores = true;
+  // Light binning on a separate compute queue, overlapping the shadow and occlusion passes
+  // (HERTRA_ASYNC_COMPUTE=0 records it on the graphics queue); needs timeline semaphores
+  bool asyncCompute = true;
+
+  // Present mode (HERTRA_PRESENT_MODE=fifo, fifo_relaxed, mailbox or immediate); by default MAILBOX where the
+  // surface has it, else FIFO. F1-F4 switch between them at runtime
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+  // Frame rate cap, 0 for none (HERTRA_FPS_LIMIT)
+  uint32_t frameRateLimit = 0;
+  // Start each frame once the previous one is on screen, with VK_KHR_present_wait (HERTRA_PRESENT_WAIT=0 to skip)
+  bool presentWait = true;
+  // Re-sample input and write the camera right before the frame is submitted rather than before it is recorded
+  // (HERTRA_LATE_LATCH=0 keeps the camera sampled at the start of the frame)
+  bool lateLatch = true;
+
+  // Fill frame arena memory with 0xDD when it is released, so code reading last frame's data misbehaves
+  // visibly (HERTRA_ARENA_POISON=1)
+  bool arenaPoison = false;
+
+  // Readback of the final image (HERTRA_CAPTURE): a directory for PNG files, a file or "|command" for streams;
+  // empty for no capture
+  std::string captureOutput;
+  // png, y4m or rgb (HERTRA_CAPTURE_FORMAT)
+  CaptureFormat captureFormat = CaptureFormat::Png;
+  // Every how many frames one is captured (HERTRA_CAPTURE_EVERY)
+  uint32_t captureInterval = 1;
+  // Frames to render without a window, surface or presentation, into an offscreen image that the capture
+  // reads; the app exits after them. 0 opens the window (HERTRA_HEADLESS)
+  uint32_t headlessFrames = 0;
+
+  // Pipeline statistics queries around the shadow, occluder, pre-pass, color and lighting passes
+  // (HERTRA_PIPELINE_STATISTICS=0 records none)
+  bool pipelineStatistics = true;
+
+  // Frame graph transients with disjoint lifetimes share memory, e.g. the bloom chain and the post output
+  // take the MSAA attachments' (HERTRA_TRANSIENT_ALIASING=0 gives each its own allocation)
+  bool transientAliasing = true;
+
+  // Directory whose .spv files replace the shaders built into the executable (HERTRA_SHADER_DIR)
+  std::string shaderDirectory;
+
+  static RenderSettings fromEnvironment();
+};
+
+#endif
@@ -1,9 +1,58 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include "shader_reflection.hpp"
+
+#include <map>
+#include <span>
 #include <string>
 #include <vector>
 
+// Shaders from this directory replace the built-in ones, e.g. to iterate without rebuilding
+void setShaderOverrideDirectory(const std::string& directory);
+
+// SPIR-V for a shader path such as "shaders/vert.spv": a file from the override directory,
+// else the binary embedded at build time, else the file at the path. The code stays valid until exit
+std::span<const uint32_t> loadShaderCode(const std::string& path);
+
+// Values for layout(constant_id = N) declarations, keyed by N. Every value is 4 bytes (uint, float or bool);
+// ids a stage does not declare are ignored. Ordered, so a set of values can key a pipeline cache
+class SpecializationConstants
+{
+private:
+  std::map<uint32_t, uint32_t> values;
+
+  friend class SpecializationInfo;
+
+public:
+  SpecializationConstants& set(uint32_t id, uint32_t value);
+  SpecializationConstants& set(uint32_t id, float value);
+  SpecializationConstants& set(uint32_t id, bool value);
+
+  // These values with the ones of other taking precedence
+  SpecializationConstants merged(const SpecializationConstants& other) const;
+
+  bool empty() const { return values.empty(); }
+  bool operator<(const SpecializationConstants& other) const { return values < other.values; }
+};
+
+// SpecializationConstants packed for VkPipelineShaderStageCreateInfo; get() points into this object
+class SpecializationInfo
+{
+private:
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<uint32_t> data;
+  VkSpecializationInfo info;
+
+public:
+  explicit SpecializationInfo(const SpecializationConstants& constants);
+  SpecializationInfo(const SpecializationInfo&) = delete;
+  SpecializationInfo& operator=(const SpecializationInfo&) = delete;
+
+  // nullptr without constants
+  const VkSpecializationInfo* get() const { return entries.empty() ? nullptr : &info; }
+};
+
 class Shader
 {
 private:
@@ -12,15 +61,24 @@ private:
   VkPipelineShaderStageCreateInfo vertShaderStageInfo;
   VkPipelineShaderStageCreateInfo fragShaderStageInfo;
   VkDevice device;
+  SpecializationConstants constants;
+  SpecializationInfo specialization;
+  ShaderReflection reflection;  // both stages
 
-  VkShaderModule createShaderModule(const std::vector<char>& code);
+  VkShaderModule createShaderModule(std::span<const uint32_t> code);
 
 public:
-  Shader(VkDevice device, const std::string& vertPath, const std::string& fragPath);
+  // constants specialize both stages of every pipeline made from this shader
+  Shader(
+    VkDevice device, const std::string& vertPath, const std::string& fragPath,
+    const SpecializationConstants& constants = {}
+  );
   ~Shader();
 
   VkPipelineShaderStageCreateInfo getVertStageInfo() const { return vertShaderStageInfo; }
   VkPipelineShaderStageCreateInfo getFragStageInfo() const { return fragShaderStageInfo; }
+  const SpecializationConstants& getConstants() const { return constants; }
+  const ShaderReflection& getReflection() const { return reflection; }
 };
 
 #endif
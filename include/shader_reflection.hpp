@@ -0,0 +1,48 @@
+#ifndef SHADER_REFLECTION_HPP
+#define SHADER_REFLECTION_HPP
+
+#include <span>
+#include <string>
+#include <vector>
+
+// Resource interface of SPIR-V modules: descriptor bindings, push constants and vertex inputs,
+// read from the decorations so layouts never have to be written by hand next to the shaders
+class ShaderReflection
+{
+public:
+  struct Binding
+  {
+    uint32_t set;
+    VkDescriptorSetLayoutBinding layout;
+    // Uniform and storage buffers: bytes of the block, a runtime array counts as empty
+    uint32_t blockSize;
+  };
+
+private:
+  VkShaderStageFlags stages;
+  std::vector<Binding> bindings;  // sorted by set, then binding
+  VkPushConstantRange pushConstants;  // size 0 without push constants
+  std::vector<VkVertexInputAttributeDescription> vertexInputs;  // by location, binding and offset are 0
+
+public:
+  ShaderReflection();
+  explicit ShaderReflection(std::span<const uint32_t> code);
+
+  // Every shader in paths, see loadShaderCode
+  static ShaderReflection fromFiles(const std::vector<std::string>& paths);
+
+  // Adds the interface of other stages; the same binding must have the same type everywhere
+  void merge(const ShaderReflection& other);
+
+  VkShaderStageFlags getStages() const { return stages; }
+  const std::vector<Binding>& getBindings() const { return bindings; }
+  // Highest set index plus one
+  uint32_t getSetCount() const;
+  std::vector<VkDescriptorSetLayoutBinding> getSetBindings(uint32_t set) const;
+  // Block size of a buffer binding, 0 when no stage declares it
+  uint32_t getBlockSize(uint32_t set, uint32_t binding) const;
+  const VkPushConstantRange& getPushConstants() const { return pushConstants; }
+  const std::vector<VkVertexInputAttributeDescription>& getVertexInputs() const { return vertexInputs; }
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SHADOW_MAP_HPP
+#define SHADOW_MAP_HPP
+
+#include "cube.hpp"
+#include "scene.hpp"
+#include "uniform_buffer.hpp"
+#include "layout_cache.hpp"
+#include "draw_queue.hpp"
+#include "queue_timeline.hpp"
+
+#include <array>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Cascaded shadow maps for the directional sun light.
+// Every cascade keeps a cached depth layer with only the static casters. It is re-rendered
+// when the light, the cascade bounds or the static scene change; each frame the cache is
+// copied into the sampled layer and only dynamic casters are drawn on top of it.
+// The three steps are frame graph passes, the graph moves both images between them.
+class ShadowMap
+{
+public:
+  static const uint32_t CASCADE_COUNT = SHADOW_CASCADE_COUNT;
+
+private:
+  struct CascadeCache
+  {
+    glm::mat4 viewProj{0.0f};   // matrix the cached static depth was rendered with
+    uint64_t staticVersion = 0;
+    bool valid = false;
+    bool hasDynamic = false;    // sampled layer holds dynamic casters on top of the cache
+  };
+
+  // What prepare picked for the frame being recorded
+  struct FramePlan
+  {
+    const std::vector<SceneObject>* objects = nullptr;
+    LinearArena* arena = nullptr;
+    std::span<const uint32_t> staticCasters;
+    std::span<const uint32_t> dynamicCasters;
+    std::array<bool, CASCADE_COUNT> renderStatic{};
+    std::array<bool, CASCADE_COUNT> restore{};
+  };
+
+  VkDevice device;
+  VkFormat format;
+  VkImageAspectFlags aspectMask;
+  uint32_t size;
+
+  // Sampled cascades and the static-caster cache, both CASCADE_COUNT layers
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView arrayView;
+  VkImage staticImage;
+  VkDeviceMemory staticMemory;
+  std::array<VkImageView, CASCADE_COUNT> layerViews;
+  std::array<VkImageView, CASCADE_COUNT> staticLayerViews;
+
+  VkRenderPass staticPass;
+  VkRenderPass dynamicPass;
+  std::array<VkFramebuffer, CASCADE_COUNT> staticFramebuffers;
+  std::array<VkFramebuffer, CASCADE_COUNT> dynamicFramebuffers;
+
+  VkPipelineLayout pipelineLayout;  // owned by the layout cache
+  VkPipeline pipeline;
+
+  std::array<glm::mat4, CASCADE_COUNT> lightViewProj;
+  glm::vec4 cascadeSplits;
+  std::array<CascadeCache, CASCADE_COUNT> cache;
+  FramePlan plan;
+  uint32_t staticRenders;
+  DrawStats drawStats;
+
+  VkImage createLayeredImage(VkPhysicalDevice physicalDevice, VkImageUsageFlags usage, VkDeviceMemory& imageMemory);
+  VkImageView createView(VkImage target, VkImageViewType type, uint32_t baseLayer, uint32_t layerCount);
+  VkRenderPass createPass(VkAttachmentLoadOp loadOp);
+  VkFramebuffer createFramebuffer(VkRenderPass pass, VkImageView view);
+  void createPipeline(LayoutCache& layouts);
+  // Reads the objects and arena of the plan
+  void drawCasters(
+    VkCommandBuffer commandBuffer, VkRenderPass pass, VkFramebuffer framebuffer, uint32_t cascade,
+    const Cube& mesh, std::span<const uint32_t> casters
+  );
+
+public:
+  ShadowMap(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue, uint32_t size,
+    LayoutCache& layouts
+  );
+  ~ShadowMap();
+
+  // Splits the camera frustum and fits a texel-snapped light projection to every slice,
+  // so the matrices stay bit-identical while the camera does not move
+  void updateCascades(
+    const glm::mat4& view, float fovY, float aspect, float zNear, float zFar, const glm::vec3& lightDirection
+  );
+  // Once per frame before the graph runs: picks the cascades to redraw; staticVersion changes whenever static
+  // objects do. objects and the caster lists built in arena must outlive the recording
+  void prepare(const std::vector<SceneObject>& objects, uint64_t staticVersion, LinearArena& arena);
+  // Graph passes in this order. Static casters into the cache (depth attachment), the cache into the sampled
+  // layers (transfer source and destination), dynamic casters on top (depth attachment); sampled afterwards
+  void recordStatic(VkCommandBuffer commandBuffer, const Cube& mesh);
+  void recordRestore(VkCommandBuffer commandBuffer);
+  void recordDynamic(VkCommandBuffer commandBuffer, const Cube& mesh);
+
+  // Both images rest between frames: the sampled one in SHADER_READ_ONLY, the cache in TRANSFER_SRC
+  static VkFormat findFormat(VkPhysicalDevice physicalDevice);
+  VkImage getImage() const { return image; }
+  VkImage getCacheImage() const { return staticImage; }
+  VkDescriptorImageInfo getDescriptorInfo(VkSampler sampler) const;
+  const std::array<glm::mat4, CASCADE_COUNT>& getLightViewProj() const { return lightViewProj; }
+  glm::vec4 getCascadeSplits() const { return cascadeSplits; }
+  // Static cascade renders since the last call
+  uint32_t takeStaticRenderCount();
+  // Caster draws and binds since the last call
+  DrawStats takeDrawStats();
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include "clustered_lighting.hpp"
+#include "scene.hpp"
+#include "triple_buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Everything the renderer needs from one simulation step. Never modified once published
+struct FrameSnapshot
+{
+  uint64_t step;
+  float time;  // simulated seconds
+
+  glm::mat4 view;
+  glm::vec3 viewPos;
+  float fovY;
+  float zNear;
+  float zFar;
+
+  glm::vec3 sunDirection;
+  glm::vec3 sunColor;
+
+  std::vector<SceneObject> objects;
+  std::vector<PointLight> lights;
+};
+
+// Runs the step function on its own thread at a fixed rate and hands the newest snapshot to the
+// render thread through a triple buffer, so a stall in the fence wait or present never holds it back
+class Simulation
+{
+public:
+  // Fills snapshot for time; the snapshot is the one published two steps ago, objects keep their count
+  using StepFunction = std::function<void(float time, FrameSnapshot& snapshot)>;
+
+private:
+  StepFunction stepFunction;
+  std::chrono::nanoseconds tickInterval;
+  TripleBuffer<FrameSnapshot> snapshots;
+  std::atomic<bool> stopping;
+  std::atomic<uint64_t> stepCount;
+  uint64_t reportedSteps;
+  std::thread thread;
+
+  void run();
+
+public:
+  // Steps once before returning, so acquire always has a snapshot
+  Simulation(const FrameSnapshot& initial, uint32_t stepsPerSecond, StepFunction stepFunction);
+  ~Simulation();
+
+  // Render thread only: the newest snapshot, valid until the next acquire
+  const FrameSnapshot& acquire() { return snapshots.acquire(); }
+  // Steps since the last call
+  uint64_t takeStepCount();
+};
+
+#endif
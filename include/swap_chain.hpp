@@ -4,6 +4,11 @@
 #include <vector>
 #include "vulkan_device.hpp"
 
+// Upper case Vulkan name without the prefix, e.g. "MAILBOX"
+const char* presentModeName(VkPresentModeKHR mode);
+
+// The images the frame ends in: a surface's swapchain, or without a surface a single offscreen image that is
+// never presented
 class SwapChain
 {
 private:
@@ -12,8 +17,14 @@ private:
   GLFWwindow* window;
 
   VkSwapchainKHR swapChain;
+  VkDeviceMemory offscreenMemory;
   VkFormat imageFormat;
   VkExtent2D extent;
+  VkImageUsageFlags imageUsage;
+  VkImageUsageFlags requestedUsage;  // added to the images where the surface supports it
+  VkFormat preferredFormat;
+  VkPresentModeKHR requestedPresentMode;  // MAX_ENUM picks MAILBOX where available
+  VkPresentModeKHR presentMode;
   std::vector<VkImage> images;
   std::vector<VkImageView> imageViews;
   // std::vector<VkFramebuffer> framebuffers;
@@ -24,20 +35,34 @@ private:
 
   SwapChainSupportDetails querySwapChainSupport();
   void createSwapChain();
+  void createOffscreenImage();
   void createImageViews();
   void createFramebuffers(VkRenderPass renderPass);
 
 public:
   SwapChain(VulkanDevice& device, VkSurfaceKHR surface, GLFWwindow* window);
+  // Offscreen, for a device created without a surface
+  SwapChain(VulkanDevice& device, VkExtent2D extent);
   ~SwapChain();
 
   void init();
   void cleanup();
   void recreate();
+  // Taken when the surface offers it with sRGB nonlinear color space; applies from the next (re)creation
+  void setPreferredFormat(VkFormat format) { preferredFormat = format; }
+  // Applies from the next (re)creation; a mode the surface lacks falls back to FIFO, which every surface has
+  void setPresentMode(VkPresentModeKHR mode) { requestedPresentMode = mode; }
+  // Usage beyond the color attachment, e.g. TRANSFER_SRC for readback; applies from the next (re)creation,
+  // getImageUsage tells what the surface allowed
+  void requestUsage(VkImageUsageFlags usage) { requestedUsage = usage; }
 
+  bool isOffscreen() const { return surface == VK_NULL_HANDLE; }
   VkSwapchainKHR getSwapChain() const { return swapChain; }
   VkFormat getImageFormat() const { return imageFormat; }
   VkExtent2D getExtent() const { return extent; }
+  VkImageUsageFlags getImageUsage() const { return imageUsage; }
+  VkPresentModeKHR getPresentMode() const { return presentMode; }
+  VkPresentModeKHR getRequestedPresentMode() const { return requestedPresentMode; }
   const std::vector<VkImage>& getImages() const { return images; }
   const std::vector<VkImageView>& getImageViews() const { return imageViews; }
 };
@@ -0,0 +1,125 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include "queue_timeline.hpp"
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct SamplerKey
+{
+  VkFilter filter = VK_FILTER_LINEAR;
+  VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  VkBorderColor borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  bool anisotropy = true;
+  // Depth comparison (LESS_OR_EQUAL) for shadow map lookups
+  bool compare = false;
+  // Finest level lookups may touch, the texture streamer clamps to the loaded levels with it
+  uint32_t minLod = 0;
+
+  bool operator<(const SamplerKey& other) const
+  {
+    return std::tie(filter, mipmapMode, addressMode, borderColor, anisotropy, compare, minLod) <
+           std::tie(
+             other.filter, other.mipmapMode, other.addressMode, other.borderColor, other.anisotropy, other.compare,
+             other.minLod
+           );
+  }
+};
+
+// Samplers are immutable and shared: textures with the same state get the same VkSampler.
+class SamplerCache
+{
+private:
+  VkDevice device;
+  float maxAnisotropy;
+  std::map<SamplerKey, VkSampler> samplers;
+
+public:
+  SamplerCache(VkPhysicalDevice physicalDevice, VkDevice device, bool anisotropyEnabled);
+  ~SamplerCache();
+
+  VkSampler get(const SamplerKey& key);
+  size_t size() const { return samplers.size(); }
+};
+
+struct TextureLevel
+{
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  uint32_t width;
+  uint32_t height;
+};
+
+// Parsed KTX2/DDS header: format and per-mip file ranges, level 0 is the finest
+struct TextureFile
+{
+  std::string path;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<TextureLevel> levels;
+
+  static TextureFile open(const std::string& path);
+
+  // Reads levels [firstLevel, firstLevel + count) back to back, offsets are copy-aligned
+  std::vector<char> readLevels(uint32_t firstLevel, uint32_t count, std::vector<VkDeviceSize>& offsets) const;
+};
+
+void transitionImageLayout(
+  VkCommandBuffer commandBuffer, VkImage image,
+  VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount
+);
+
+class Texture
+{
+private:
+  VkDevice device;
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView imageView;
+  VkSampler sampler;
+  VkFormat format;
+  VkExtent2D extent;
+  uint32_t mipLevels;
+  VkDeviceSize sizeInBytes;
+
+  void allocateImage(VkPhysicalDevice physicalDevice, VkImageUsageFlags usage);
+  void createImageView();
+  void loadCompressed(
+    VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue, const TextureFile& file
+  );
+  void loadPng(
+    VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue, const std::string& path
+  );
+  void loadRgba(
+    VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue,
+    const unsigned char* pixels, uint32_t width, uint32_t height
+  );
+  void generateMipmaps(VkCommandBuffer commandBuffer);
+
+public:
+  Texture(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue,
+    SamplerCache& samplers, const std::string& path, const SamplerKey& samplerKey = {}
+  );
+  // 1x1 texture of a single RGBA8 color (0xRRGGBBAA), used when no file is available
+  Texture(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkCommandPool commandPool, QueueTimeline& queue,
+    SamplerCache& samplers, uint32_t color
+  );
+  ~Texture();
+
+  VkDescriptorImageInfo getDescriptorInfo() const;
+  VkImage getImage() const { return image; }
+  VkImageView getImageView() const { return imageView; }
+  VkFormat getFormat() const { return format; }
+  VkExtent2D getExtent() const { return extent; }
+  uint32_t getMipLevels() const { return mipLevels; }
+  VkDeviceSize getSizeInBytes() const { return sizeInBytes; }
+};
+
+#endif
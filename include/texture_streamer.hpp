@@ -0,0 +1,92 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include "texture.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct StreamedTexture
+{
+  TextureFile file;
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView imageView = VK_NULL_HANDLE;
+  uint32_t residentMip = 0;  // finest level loaded, the sampler's minLod clamp
+  uint32_t desiredMip = 0;   // finest level the GPU sampled
+  bool loadPending = false;
+  uint64_t lastUsedFrame = 0;
+};
+
+// Keeps the coarse tail of every texture resident and streams finer mips in on demand.
+// The image holds the full mip chain and a minLod sampler keeps lookups off levels not loaded yet,
+// so loading or evicting a mip never reallocates or copies the image.
+class TextureStreamer
+{
+private:
+  struct LoadRequest
+  {
+    uint32_t texture;
+    uint32_t level;
+    TextureFile file;
+  };
+
+  struct LoadResult
+  {
+    uint32_t texture;
+    uint32_t level;
+    std::vector<char> data;
+  };
+
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  QueueTimeline& queue;
+  VkCommandPool commandPool;
+  VkCommandBuffer commandBuffer;
+  uint64_t uploadValue;  // timeline value of the last batch
+  SamplerCache& samplers;
+  std::vector<VkSampler> clampSamplers;  // indexed by minLod
+  VkDeviceSize budget;
+  VkDeviceSize residentBytes;
+  uint64_t frameIndex;
+  bool recording;
+
+  std::vector<StreamedTexture> textures;
+  std::vector<std::pair<VkBuffer, VkDeviceMemory>> stagingBuffers;
+
+  std::thread ioThread;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<LoadRequest> requests;
+  std::vector<LoadResult> results;
+  bool stopping;
+
+  void ioLoop();
+  VkDeviceSize residentSize(const StreamedTexture& texture, uint32_t mip) const;
+  void allocate(StreamedTexture& texture);
+  VkCommandBuffer beginBatch();
+  void upload(StreamedTexture& texture, uint32_t level, const std::vector<char>& levelData);
+  void evictOverBudget();
+
+public:
+  // Batches go to queue; the frames sampling a level being overwritten must have been submitted there too
+  TextureStreamer(
+    VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, QueueTimeline& queue,
+    SamplerCache& samplers, VkDeviceSize budget
+  );
+  ~TextureStreamer();
+
+  uint32_t add(const std::string& path, uint32_t initialSize);
+  // Demand feedback: finest level a finished frame sampled, UINT32_MAX if it did not draw the texture
+  void reportSampledLevel(uint32_t texture, uint32_t level);
+  // Once per frame: applies finished loads, evicts over budget and issues new reads
+  void update();
+
+  VkDescriptorImageInfo getDescriptorInfo(uint32_t texture) const;
+  uint32_t getResidentMip(uint32_t texture) const { return textures[texture].residentMip; }
+  VkDeviceSize getResidentBytes() const { return residentBytes; }
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free mailbox between one writer and one reader thread. The writer fills its back slot and publishes it;
+// the reader always takes the newest published slot and skips the ones it missed. Neither side ever waits.
+template <typename T>
+class TripleBuffer
+{
+private:
+  static const uint8_t INDEX_MASK = 0x3;
+  static const uint8_t FRESH_BIT = 0x4;  // the middle slot holds a value the reader has not taken yet
+
+  std::array<T, 3> slots;
+  std::atomic<uint8_t> middle;  // slot handed over between the two sides
+  uint8_t back;  // writer only
+  uint8_t front;  // reader only
+
+public:
+  // Every slot starts as a copy of initial, so the reader gets it until the first publish
+  explicit TripleBuffer(const T& initial) : slots{initial, initial, initial}, middle(1), back(0), front(2) {}
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Writer: the slot to fill, it holds whatever was published two slots ago
+  T& getBack() { return slots[back]; }
+  void publish()
+  {
+    uint8_t previous = middle.exchange(back | FRESH_BIT, std::memory_order_acq_rel);
+    back = previous & INDEX_MASK;
+  }
+
+  // Reader: the newest published value, unchanged until the next acquire
+  const T& acquire()
+  {
+    if (middle.load(std::memory_order_relaxed) & FRESH_BIT)
+    {
+      uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+      front = previous & INDEX_MASK;
+    }
+    return slots[front];
+  }
+};
+
+#endif
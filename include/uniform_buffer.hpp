@@ -2,32 +2,49 @@
 #define UNIFORM_BUFFER_HPP
 
 #include <glm/glm.hpp>
+#include <span>
 #include <vector>
 
+// Keep in sync with SHADOW_CASCADES in the shaders
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+
+// Model matrices live in the object buffer, the UBO only holds per-frame state
 struct UniformBufferObject
 {
-  alignas(16) glm::mat4 model;
   alignas(16) glm::mat4 view;
   alignas(16) glm::mat4 proj;
-  alignas(16) glm::vec3 lightPos;
+  alignas(16) glm::mat4 lightViewProj[SHADOW_CASCADE_COUNT];
+  alignas(16) glm::vec4 cascadeSplits;  // view-space far distance of each cascade
+  alignas(16) glm::vec3 sunDirection;
+  alignas(16) glm::vec3 sunColor;
   alignas(16) glm::vec3 viewPos;
-  alignas(16) glm::vec3 lightColor;
+  alignas(16) glm::vec2 screenSize;
+  float zNear;
+  float zFar;
+  uint32_t lightCount;
+  uint32_t objectCount;
+  alignas(16) glm::mat4 invViewProj;  // deferred lighting rebuilds positions from depth
 };
 
+// One mapped buffer with a slice per frame in flight, each aligned for use as a uniform buffer range
 class UniformBuffer
 {
 private:
-  std::vector<VkBuffer> uniformBuffers;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
-  std::vector<void*> uniformBuffersMapped;
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  char* mapped;
+  VkDeviceSize sliceSize;
   VkDevice device;
 
 public:
-  UniformBuffer(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t imageCount);
+  // sharedFamilies: every queue family reading the slices, when that is more than one
+  UniformBuffer(
+    VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, std::span<const uint32_t> sharedFamilies = {}
+  );
   ~UniformBuffer();
 
-  void update(uint32_t currentImage, const UniformBufferObject& ubo);
-  VkDescriptorBufferInfo getDescriptorInfo(uint32_t currentImage) const;
+  void update(uint32_t frame, const UniformBufferObject& ubo);
+  VkDescriptorBufferInfo getDescriptorInfo(uint32_t frame) const;
 };
 
 #endif
@@ -2,16 +2,24 @@
 #define VERTEX_HPP
 
 #include <glm/glm.hpp>
-#include <vector>
+#include <array>
 
 struct Vertex
 {
   glm::vec3 pos;
   glm::vec3 color;
   glm::vec3 normal;
+  glm::vec2 texCoord;
+
+  static const uint32_t ATTRIBUTE_COUNT = 4;
 
   static VkVertexInputBindingDescription getBindingDescription();
-  static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+  // Every attribute by location; a pipeline uses the ones its vertex shader reads
+  static const std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT>& getAttributeDescriptions();
+
+  // Tightly packed positions only, for depth-only passes
+  static VkVertexInputBindingDescription getPositionBindingDescription();
+  static VkVertexInputAttributeDescription getPositionAttributeDescription();
 };
 
 #endif
@@ -15,6 +15,9 @@ struct QueueFamilyIndices
 {
   uint32_t graphicsFamily = UINT32_MAX;
   uint32_t presentFamily = UINT32_MAX;
+  // Queue for async compute: a family without graphics, else a second queue of the graphics family
+  uint32_t computeFamily = UINT32_MAX;
+  uint32_t computeQueueIndex = 0;
 
   bool isComplete() const
   {
@@ -29,12 +32,24 @@ private:
   VkDevice device;
   VkQueue graphicsQueue;
   VkQueue presentQueue;
+  VkQueue computeQueue;  // null without async compute
   QueueFamilyIndices queueFamilies;
+  VkPhysicalDeviceFeatures enabledFeatures;
+  VkSampleCountFlags framebufferSampleCounts;
+  // Core in 1.3, otherwise VK_KHR_dynamic_rendering; null when neither is available
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+  PFN_vkCmdEndRenderingKHR cmdEndRendering;
+  // Core in 1.2, otherwise VK_KHR_timeline_semaphore
+  PFN_vkWaitSemaphoresKHR waitSemaphores;
+  PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue;
+  // VK_KHR_present_wait, null without it
+  PFN_vkWaitForPresentKHR waitForPresentKHR;
 
   void pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface);
-  void createLogicalDevice(VkInstance instance, VkSurfaceKHR surface);
+  void createLogicalDevice(VkInstance instance, VkSurfaceKHR surface, uint32_t instanceVersion, bool asyncCompute);
   bool isDeviceSuitable(VkPhysicalDevice device, VkInstance instance, VkSurfaceKHR surface);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkInstance instance, VkSurfaceKHR surface);
 
@@ -42,14 +57,37 @@ public:
   VulkanDevice();
   ~VulkanDevice();
 
-  void init(VkInstance instance, VkSurfaceKHR surface);
+  // instanceVersion is the apiVersion the instance was created with; asyncCompute asks for a compute queue
+  // next to the graphics one, if the GPU has one. A null surface renders offscreen: no swapchain extension,
+  // and the present queue is the graphics queue
+  void init(VkInstance instance, VkSurfaceKHR surface, uint32_t instanceVersion, bool asyncCompute);
   void cleanup();
 
   VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
   VkDevice getDevice() const { return device; }
   VkQueue getGraphicsQueue() const { return graphicsQueue; }
   VkQueue getPresentQueue() const { return presentQueue; }
+  VkQueue getComputeQueue() const { return computeQueue; }
+  bool hasAsyncCompute() const { return computeQueue != VK_NULL_HANDLE; }
   QueueFamilyIndices getQueueFamilies() const { return queueFamilies; }
+  const VkPhysicalDeviceFeatures& getEnabledFeatures() const { return enabledFeatures; }
+  // Highest sample count not above requested that color and depth attachments both support
+  VkSampleCountFlagBits clampSampleCount(uint32_t requested) const;
+
+  // Render passes without VkRenderPass and VkFramebuffer objects, attachments given at record time
+  bool supportsDynamicRendering() const { return cmdBeginRendering != nullptr; }
+  void beginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo) const;
+  void endRendering(VkCommandBuffer commandBuffer) const;
+
+  // Semaphores carrying a 64-bit counter that the host can wait for and read
+  bool supportsTimelineSemaphores() const { return waitSemaphores != nullptr; }
+  // VK_SUCCESS once semaphore has reached value, VK_TIMEOUT if it did not within timeout nanoseconds
+  VkResult waitSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout) const;
+  uint64_t getSemaphoreValue(VkSemaphore semaphore) const;
+
+  // Presents carry a VkPresentIdKHR and the host can wait until one of them is on screen
+  bool supportsPresentWait() const { return waitForPresentKHR != nullptr; }
+  VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) const;
 };
 
 #endif
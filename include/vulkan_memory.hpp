@@ -0,0 +1,27 @@
+#ifndef VULKAN_MEMORY_HPP
+#define VULKAN_MEMORY_HPP
+
+#include "queue_timeline.hpp"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+// With more than one of sharedFamilies the buffer is used concurrently by them, without ownership transfers
+VkBuffer createBuffer(
+  VkPhysicalDevice physicalDevice, VkDevice device,
+  VkDeviceSize size, VkBufferUsageFlags usage,
+  VkMemoryPropertyFlags properties, VkDeviceMemory& bufferMemory,
+  std::span<const uint32_t> sharedFamilies = {}
+);
+
+VkImage createImage(
+  VkPhysicalDevice physicalDevice, VkDevice device,
+  const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkDeviceMemory& imageMemory
+);
+
+VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool);
+// Waits for this submission only, earlier work on the queue keeps running
+void endSingleTimeCommands(
+  VkDevice device, VkCommandPool commandPool, QueueTimeline& queue, VkCommandBuffer commandBuffer
+);
+
+#endif
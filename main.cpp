@@ -11,7 +11,7 @@ int main() {
 
   try
   {
-    HertraApp app;
+    HertraApp app(RenderSettings::fromEnvironment());
     app.run();
   } catch (const std::exception& e)
   {
@@ -0,0 +1,170 @@
+#version 450
+
+// Must match ClusteredLighting in clustered_lighting.hpp
+const uint CLUSTER_X = 16;
+const uint CLUSTER_Y = 9;
+const uint CLUSTER_Z = 24;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Must match SHADOW_CASCADE_COUNT in uniform_buffer.hpp
+const uint SHADOW_CASCADES = 4;
+
+// Specialization constants, must match LightingConstant in hertra.hpp
+layout(constant_id = 0) const float AMBIENT_STRENGTH = 0.1;
+layout(constant_id = 2) const float SHININESS = 32.0;
+// Lights evaluated per cluster at most, up to MAX_LIGHTS_PER_CLUSTER
+layout(constant_id = 3) const uint LIGHT_LIMIT = 128;
+// Side of the shadow PCF kernel, 0 turns sun shadows off
+layout(constant_id = 4) const uint SHADOW_FILTER_SIZE = 2;
+
+// Must match the G-buffer attachments in HertraApp::createRenderPass
+layout(input_attachment_index = 0, binding = 9) uniform subpassInput gAlbedo;
+layout(input_attachment_index = 1, binding = 10) uniform subpassInput gNormal;
+layout(input_attachment_index = 2, binding = 11) uniform subpassInput gDepth;
+
+layout(location = 0) out vec4 outColor;
+
+// Reconstructed from depth in main()
+vec3 fragPos;
+
+struct PointLight
+{
+  vec4 positionRadius;
+  vec4 color;
+};
+
+layout(binding = 0) uniform UniformBufferObject
+{
+  mat4 view;
+  mat4 proj;
+  mat4 lightViewProj[SHADOW_CASCADES];
+  vec4 cascadeSplits;
+  vec3 sunDirection;
+  vec3 sunColor;
+  vec3 viewPos;
+  vec2 screenSize;
+  float zNear;
+  float zFar;
+  uint lightCount;
+  uint objectCount;
+  mat4 invViewProj;
+} ubo;
+
+// Camera the G-buffer was rasterized with, written just before submission; positions are rebuilt with its inverse.
+// Must match LatchedCamera in late_latch.hpp
+layout(binding = 12) uniform LatchedCamera
+{
+  mat4 viewProj;
+  mat4 invViewProj;
+  vec4 viewPos;  // eye position in xyz
+} camera;
+
+layout(std430, binding = 2) readonly buffer LightBuffer
+{
+  PointLight lights[];
+};
+
+layout(std430, binding = 3) readonly buffer ClusterBuffer
+{
+  uint clusterCounts[CLUSTER_COUNT];
+  uint clusterLights[];
+};
+
+layout(binding = 4) uniform sampler2DArrayShadow shadowMap;
+
+uint findCluster()
+{
+  float viewZ = -(ubo.view * vec4(fragPos, 1.0)).z;
+  float slice = log(viewZ / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z);
+  uint z = uint(clamp(slice, 0.0, float(CLUSTER_Z - 1)));
+
+  // Tiles are binned with the UBO camera, the late-latched one rasterized the fragment
+  vec4 clip = ubo.proj * ubo.view * vec4(fragPos, 1.0);
+  vec2 screen = clip.xy / clip.w * 0.5 + 0.5;
+  uvec2 tile = uvec2(clamp(screen, 0.0, 1.0) * vec2(CLUSTER_X, CLUSTER_Y));
+  tile = min(tile, uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+
+  return tile.x + tile.y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y;
+}
+
+// Sun visibility from the cascade covering this fragment, NxN hardware PCF
+float sunShadow(float viewZ)
+{
+  if (SHADOW_FILTER_SIZE == 0)
+    return 1.0;
+
+  uint cascade = 0;
+  for (uint i = 0; i < SHADOW_CASCADES - 1; i++)
+    if (viewZ > ubo.cascadeSplits[i])
+      cascade = i + 1;
+
+  vec4 lightSpace = ubo.lightViewProj[cascade] * vec4(fragPos, 1.0);
+  vec3 coord = lightSpace.xyz / lightSpace.w;
+  if (coord.z >= 1.0)
+    return 1.0;
+
+  vec2 uv = coord.xy * 0.5 + 0.5;
+  vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+  float visibility = 0.0;
+  for (uint x = 0; x < SHADOW_FILTER_SIZE; x++)
+    for (uint y = 0; y < SHADOW_FILTER_SIZE; y++)
+    {
+      vec2 offset = (vec2(x, y) - float(SHADOW_FILTER_SIZE - 1) * 0.5) * texel;
+      visibility += texture(shadowMap, vec4(uv + offset, float(cascade), coord.z));
+    }
+
+  return visibility / float(SHADOW_FILTER_SIZE * SHADOW_FILTER_SIZE);
+}
+
+void main()
+{
+  // Background keeps the clear color
+  float depth = subpassLoad(gDepth).r;
+  if (depth >= 1.0)
+    discard;
+
+  vec2 ndc = gl_FragCoord.xy / ubo.screenSize * 2.0 - 1.0;
+  vec4 world = camera.invViewProj * vec4(ndc, depth, 1.0);
+  fragPos = world.xyz / world.w;
+
+  vec4 albedo = subpassLoad(gAlbedo);
+  vec3 norm = normalize(subpassLoad(gNormal).xyz * 2.0 - 1.0);
+
+  // Ambient
+  vec3 lighting = vec3(AMBIENT_STRENGTH);
+
+  vec3 viewDir = normalize(camera.viewPos.xyz - fragPos);
+  float specularStrength = albedo.a;
+
+  // Shadowed directional sun
+  vec3 sunDir = normalize(-ubo.sunDirection);
+  float sunDiff = max(dot(norm, sunDir), 0.0);
+  float sunSpec = pow(max(dot(viewDir, reflect(-sunDir, norm)), 0.0), SHININESS);
+  float viewZ = -(ubo.view * vec4(fragPos, 1.0)).z;
+  lighting += (sunDiff + specularStrength * sunSpec) * sunShadow(viewZ) * ubo.sunColor;
+
+  // Only the lights binned into this pixel's cluster, evaluated once per pixel
+  uint cluster = findCluster();
+  uint count = min(clusterCounts[cluster], LIGHT_LIMIT);
+  for (uint i = 0; i < count; i++)
+  {
+    PointLight light = lights[clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+    vec3 toLight = light.positionRadius.xyz - fragPos;
+    float dist = length(toLight);
+    float falloff = clamp(1.0 - (dist * dist) / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+    float attenuation = falloff * falloff;
+
+    // Diffuse
+    vec3 lightDir = toLight / dist;
+    float diff = max(dot(norm, lightDir), 0.0);
+
+    // Specular
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
+
+    lighting += (diff + specularStrength * spec) * attenuation * light.color.rgb;
+  }
+
+  outColor = vec4(lighting * albedo.rgb, 1.0);
+}
@@ -0,0 +1,57 @@
+#version 450
+
+// Same camera as vert.glsl, written just before submission. Must match LatchedCamera in late_latch.hpp
+layout(binding = 12) uniform LatchedCamera
+{
+  mat4 viewProj;
+  mat4 invViewProj;
+  vec4 viewPos;  // eye position in xyz
+} camera;
+
+// Must match OcclusionCulling::MAX_OBJECTS in occlusion_culling.hpp
+const uint MAX_OBJECTS = 4096;
+
+struct ObjectData
+{
+  mat4 model;
+  vec4 boundsMin;
+  vec4 boundsMax;
+};
+
+struct DrawCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout(std430, binding = 5) readonly buffer ObjectBuffer
+{
+  ObjectData objects[];
+};
+
+// Indirect commands followed by the object indices of each draw list
+layout(std430, binding = 6) readonly buffer DrawBuffer
+{
+  DrawCommand commands[2];
+  uint visibleIndices[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  uint drawList;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+
+// Same expression as vert.glsl: the color pass tests against this depth with EQUAL
+invariant gl_Position;
+
+void main()
+{
+  mat4 model = objects[visibleIndices[draw.drawList * MAX_OBJECTS + gl_InstanceIndex]].model;
+  vec4 worldPos = model * vec4(inPosition, 1.0);
+  gl_Position = camera.viewProj * worldPos;
+}
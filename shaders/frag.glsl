@@ -1,40 +1,174 @@
 #version 450
 
+// Must match ClusteredLighting in clustered_lighting.hpp
+const uint CLUSTER_X = 16;
+const uint CLUSTER_Y = 9;
+const uint CLUSTER_Z = 24;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Must match SHADOW_CASCADE_COUNT in uniform_buffer.hpp
+const uint SHADOW_CASCADES = 4;
+
+// Specialization constants, must match LightingConstant in hertra.hpp
+layout(constant_id = 0) const float AMBIENT_STRENGTH = 0.1;
+layout(constant_id = 1) const float SPECULAR_STRENGTH = 0.5;
+layout(constant_id = 2) const float SHININESS = 32.0;
+// Lights evaluated per cluster at most, up to MAX_LIGHTS_PER_CLUSTER
+layout(constant_id = 3) const uint LIGHT_LIMIT = 128;
+// Side of the shadow PCF kernel, 0 turns sun shadows off
+layout(constant_id = 4) const uint SHADOW_FILTER_SIZE = 2;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPos;
 layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
+struct PointLight
+{
+  vec4 positionRadius;
+  vec4 color;
+};
+
 layout(binding = 0) uniform UniformBufferObject
 {
-  mat4 model;
   mat4 view;
   mat4 proj;
-  vec3 lightPos;
+  mat4 lightViewProj[SHADOW_CASCADES];
+  vec4 cascadeSplits;
+  vec3 sunDirection;
+  vec3 sunColor;
   vec3 viewPos;
-  vec3 lightColor;
+  vec2 screenSize;
+  float zNear;
+  float zFar;
+  uint lightCount;
+  uint objectCount;
+  mat4 invViewProj;
 } ubo;
 
+// Camera the fragment was rasterized with, written just before submission. Must match LatchedCamera in late_latch.hpp
+layout(binding = 12) uniform LatchedCamera
+{
+  mat4 viewProj;
+  mat4 invViewProj;
+  vec4 viewPos;  // eye position in xyz
+} camera;
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+// Finest mip sampled from texSampler this frame, must match MipFeedback in mip_feedback.hpp
+layout(std430, binding = 13) buffer MipFeedback
+{
+  uint finestLevel;
+} feedback;
+
+layout(std430, binding = 2) readonly buffer LightBuffer
+{
+  PointLight lights[];
+};
+
+layout(std430, binding = 3) readonly buffer ClusterBuffer
+{
+  uint clusterCounts[CLUSTER_COUNT];
+  uint clusterLights[];
+};
+
+layout(binding = 4) uniform sampler2DArrayShadow shadowMap;
+
+// Streaming demand: y is the computed level, unlike x it ignores the streamer's minLod clamp
+void reportMipLevel()
+{
+  uint level = uint(max(textureQueryLod(texSampler, fragTexCoord).y, 0.0));
+  if (level < feedback.finestLevel)
+    atomicMin(feedback.finestLevel, level);
+}
+
+uint findCluster()
+{
+  float viewZ = -(ubo.view * vec4(fragPos, 1.0)).z;
+  float slice = log(viewZ / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z);
+  uint z = uint(clamp(slice, 0.0, float(CLUSTER_Z - 1)));
+
+  // Tiles are binned with the UBO camera, the late-latched one rasterized the fragment
+  vec4 clip = ubo.proj * ubo.view * vec4(fragPos, 1.0);
+  vec2 screen = clip.xy / clip.w * 0.5 + 0.5;
+  uvec2 tile = uvec2(clamp(screen, 0.0, 1.0) * vec2(CLUSTER_X, CLUSTER_Y));
+  tile = min(tile, uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+
+  return tile.x + tile.y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y;
+}
+
+// Sun visibility from the cascade covering this fragment, NxN hardware PCF
+float sunShadow(float viewZ)
+{
+  if (SHADOW_FILTER_SIZE == 0)
+    return 1.0;
+
+  uint cascade = 0;
+  for (uint i = 0; i < SHADOW_CASCADES - 1; i++)
+    if (viewZ > ubo.cascadeSplits[i])
+      cascade = i + 1;
+
+  vec4 lightSpace = ubo.lightViewProj[cascade] * vec4(fragPos, 1.0);
+  vec3 coord = lightSpace.xyz / lightSpace.w;
+  if (coord.z >= 1.0)
+    return 1.0;
+
+  vec2 uv = coord.xy * 0.5 + 0.5;
+  vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+  float visibility = 0.0;
+  for (uint x = 0; x < SHADOW_FILTER_SIZE; x++)
+    for (uint y = 0; y < SHADOW_FILTER_SIZE; y++)
+    {
+      vec2 offset = (vec2(x, y) - float(SHADOW_FILTER_SIZE - 1) * 0.5) * texel;
+      visibility += texture(shadowMap, vec4(uv + offset, float(cascade), coord.z));
+    }
+
+  return visibility / float(SHADOW_FILTER_SIZE * SHADOW_FILTER_SIZE);
+}
+
 void main()
 {
   // Ambient
-  float ambientStrength = 0.1;
-  vec3 ambient = ambientStrength * ubo.lightColor;
+  vec3 lighting = vec3(AMBIENT_STRENGTH);
 
-  // Diffuse
   vec3 norm = normalize(fragNormal);
-  vec3 lightDir = normalize(ubo.lightPos - fragPos);
-  float diff = max(dot(norm, lightDir), 0.0);
-  vec3 diffuse = diff * ubo.lightColor;
-
-  // Specular
-  float specularStrength = 0.5;
-  vec3 viewDir = normalize(ubo.viewPos - fragPos);
-  vec3 reflectDir = reflect(-lightDir, norm);
-  float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
-  vec3 specular = specularStrength * spec * ubo.lightColor;
-
-  vec3 result = (ambient + diffuse + specular) * fragColor;
-  outColor = vec4(result, 1.0);
+  vec3 viewDir = normalize(camera.viewPos.xyz - fragPos);
+  float specularStrength = SPECULAR_STRENGTH;
+
+  // Shadowed directional sun
+  vec3 sunDir = normalize(-ubo.sunDirection);
+  float sunDiff = max(dot(norm, sunDir), 0.0);
+  float sunSpec = pow(max(dot(viewDir, reflect(-sunDir, norm)), 0.0), SHININESS);
+  float viewZ = -(ubo.view * vec4(fragPos, 1.0)).z;
+  lighting += (sunDiff + specularStrength * sunSpec) * sunShadow(viewZ) * ubo.sunColor;
+
+  // Only the lights binned into this fragment's cluster
+  uint cluster = findCluster();
+  uint count = min(clusterCounts[cluster], LIGHT_LIMIT);
+  for (uint i = 0; i < count; i++)
+  {
+    PointLight light = lights[clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+    vec3 toLight = light.positionRadius.xyz - fragPos;
+    float dist = length(toLight);
+    float falloff = clamp(1.0 - (dist * dist) / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+    float attenuation = falloff * falloff;
+
+    // Diffuse
+    vec3 lightDir = toLight / dist;
+    float diff = max(dot(norm, lightDir), 0.0);
+
+    // Specular
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
+
+    lighting += (diff + specularStrength * spec) * attenuation * light.color.rgb;
+  }
+
+  reportMipLevel();
+  vec3 albedo = texture(texSampler, fragTexCoord).rgb * fragColor;
+  outColor = vec4(lighting * albedo, 1.0);
 }
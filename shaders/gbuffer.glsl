@@ -0,0 +1,36 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPos;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec2 fragTexCoord;
+
+// Must match the G-buffer attachments in HertraApp::createRenderPass
+layout(location = 0) out vec4 outAlbedo;  // rgb albedo, a specular strength
+layout(location = 1) out vec4 outNormal;  // world normal * 0.5 + 0.5
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+// Finest mip sampled from texSampler this frame, must match MipFeedback in mip_feedback.hpp
+layout(std430, binding = 13) buffer MipFeedback
+{
+  uint finestLevel;
+} feedback;
+
+// Must match LightingConstant in hertra.hpp
+layout(constant_id = 1) const float SPECULAR_STRENGTH = 0.5;
+
+// Streaming demand: y is the computed level, unlike x it ignores the streamer's minLod clamp
+void reportMipLevel()
+{
+  uint level = uint(max(textureQueryLod(texSampler, fragTexCoord).y, 0.0));
+  if (level < feedback.finestLevel)
+    atomicMin(feedback.finestLevel, level);
+}
+
+void main()
+{
+  reportMipLevel();
+  outAlbedo = vec4(texture(texSampler, fragTexCoord).rgb * fragColor, SPECULAR_STRENGTH);
+  outNormal = vec4(normalize(fragNormal) * 0.5 + 0.5, 0.0);
+}
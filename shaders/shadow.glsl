@@ -0,0 +1,14 @@
+#version 450
+
+// Depth-only shadow caster pass, no fragment stage
+layout(push_constant) uniform PushConstants
+{
+  mat4 lightMvp;
+} object;
+
+layout(location = 0) in vec3 inPosition;
+
+void main()
+{
+  gl_Position = object.lightMvp * vec4(inPosition, 1.0);
+}
@@ -1,27 +1,71 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject
+// Camera written just before submission, after the rest of the frame was recorded. The graphics queue's passes
+// project with it; light binning, which may already run on the compute queue, and the shadow cascades keep
+// the view of the UBO. Must match LatchedCamera in late_latch.hpp
+layout(binding = 12) uniform LatchedCamera
+{
+  mat4 viewProj;
+  mat4 invViewProj;
+  vec4 viewPos;  // eye position in xyz
+} camera;
+
+// Must match OcclusionCulling::MAX_OBJECTS in occlusion_culling.hpp
+const uint MAX_OBJECTS = 4096;
+
+struct ObjectData
 {
   mat4 model;
-  mat4 view;
-  mat4 proj;
-  vec3 lightPos;
-  vec3 viewPos;
-  vec3 lightColor;
-} ubo;
+  vec4 boundsMin;
+  vec4 boundsMax;
+};
+
+struct DrawCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout(std430, binding = 5) readonly buffer ObjectBuffer
+{
+  ObjectData objects[];
+};
+
+// Indirect commands followed by the object indices of each draw list
+layout(std430, binding = 6) readonly buffer DrawBuffer
+{
+  DrawCommand commands[2];
+  uint visibleIndices[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+  uint drawList;
+} draw;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPos;
 layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec2 fragTexCoord;
+
+// Bit-identical to depth.glsl for the EQUAL test after the depth pre-pass
+invariant gl_Position;
 
 void main()
 {
-  gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-  fragPos = vec3(ubo.model * vec4(inPosition, 1.0));
-  fragNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
+  mat4 model = objects[visibleIndices[draw.drawList * MAX_OBJECTS + gl_InstanceIndex]].model;
+  vec4 worldPos = model * vec4(inPosition, 1.0);
+  gl_Position = camera.viewProj * worldPos;
+  fragPos = vec3(worldPos);
+  fragNormal = mat3(transpose(inverse(model))) * inNormal;
   fragColor = inColor;
+  fragTexCoord = inTexCoord;
 }
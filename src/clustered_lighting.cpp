@@ -0,0 +1,162 @@
+#include "clustered_lighting.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <glm/gtc/constants.hpp>
+
+ClusteredLighting::ClusteredLighting(
+  VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t frameCount, uint32_t lightCount, VkPipelineLayout layout,
+  uint32_t graphicsQueueFamily, uint32_t computeQueueFamily
+) : device(dev), graphicsFamily(graphicsQueueFamily), computeFamily(computeQueueFamily)
+{
+  generateLights(std::max(lightCount, 1u));
+
+  // Written by the host, read by the binning and by the fragment shaders
+  const uint32_t families[] = {graphicsFamily, computeFamily};
+  std::span<const uint32_t> sharedFamilies;
+  if (graphicsFamily != computeFamily)
+    sharedFamilies = families;
+
+  VkDeviceSize lightBufferSize = sizeof(PointLight) * baseLights.size();
+  lightBuffers.resize(frameCount);
+  lightBuffersMemory.resize(frameCount);
+  lightBuffersMapped.resize(frameCount);
+
+  for (size_t i = 0; i < frameCount; i++)
+  {
+    lightBuffers[i] = createBuffer(
+      physicalDevice, device, lightBufferSize,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      lightBuffersMemory[i], sharedFamilies
+    );
+    vkMapMemory(device, lightBuffersMemory[i], 0, lightBufferSize, 0, &lightBuffersMapped[i]);
+  }
+
+  // Per-cluster light counts followed by fixed-size light index lists
+  uint32_t clusterCount = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+  clusterBufferSize = sizeof(uint32_t) * clusterCount * (1 + MAX_LIGHTS_PER_CLUSTER);
+  clusterBuffers.resize(frameCount);
+  clusterBuffersMemory.resize(frameCount);
+  for (size_t i = 0; i < frameCount; i++)
+    clusterBuffers[i] = createBuffer(
+      physicalDevice, device, clusterBufferSize,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      clusterBuffersMemory[i]
+    );
+
+  cullPipeline = std::make_unique<ComputePipeline>(device, "shaders/cluster.spv", layout);
+
+  std::cout << "Clustered lighting: " << baseLights.size() << " lights, "
+            << CLUSTER_X << "x" << CLUSTER_Y << "x" << CLUSTER_Z << " clusters" << std::endl;
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+  cullPipeline.reset();
+
+  for (size_t i = 0; i < lightBuffers.size(); i++)
+  {
+    vkUnmapMemory(device, lightBuffersMemory[i]);
+    vkDestroyBuffer(device, lightBuffers[i], nullptr);
+    vkFreeMemory(device, lightBuffersMemory[i], nullptr);
+  }
+
+  for (size_t i = 0; i < clusterBuffers.size(); i++)
+  {
+    vkDestroyBuffer(device, clusterBuffers[i], nullptr);
+    vkFreeMemory(device, clusterBuffersMemory[i], nullptr);
+  }
+}
+
+void ClusteredLighting::generateLights(uint32_t lightCount)
+{
+  std::mt19937 random(1337);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  // Light 0 is the white key light the scene always had
+  baseLights.push_back({glm::vec4(2.0f, 2.0f, 2.0f, 10.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)});
+  orbitSpeeds.push_back(0.0f);
+
+  for (uint32_t i = 1; i < lightCount; i++)
+  {
+    float angle = unit(random) * 2.0f * glm::pi<float>();
+    float distance = 0.8f + unit(random) * 2.5f;
+    float height = -1.5f + unit(random) * 3.0f;
+    float radius = 0.3f + unit(random) * 0.7f;
+
+    glm::vec3 color(unit(random), unit(random), unit(random));
+    color /= std::max(color.r, std::max(color.g, color.b));
+
+    baseLights.push_back({
+      glm::vec4(std::cos(angle) * distance, height, std::sin(angle) * distance, radius),
+      glm::vec4(color * 0.5f, 1.0f)
+    });
+    orbitSpeeds.push_back(0.2f + unit(random) * 0.8f);
+  }
+}
+
+void ClusteredLighting::animate(float time, std::vector<PointLight>& lights) const
+{
+  lights.resize(baseLights.size());
+  for (size_t i = 0; i < lights.size(); i++)
+  {
+    float angle = time * orbitSpeeds[i];
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    glm::vec4 base = baseLights[i].positionRadius;
+    lights[i].positionRadius = glm::vec4(base.x * c - base.z * s, base.y, base.x * s + base.z * c, base.w);
+    lights[i].color = baseLights[i].color;
+  }
+}
+
+void ClusteredLighting::upload(uint32_t frame, const std::vector<PointLight>& lights)
+{
+  size_t count = std::min(lights.size(), baseLights.size());
+  memcpy(lightBuffersMapped[frame], lights.data(), sizeof(PointLight) * count);
+}
+
+void ClusteredLighting::recordCulling(
+  VkCommandBuffer commandBuffer, uint32_t frame, VkPipelineLayout layout, VkDescriptorSet descriptorSet
+) {
+  // On the graphics queue this is a frame graph pass, which orders it against the reads. On the compute queue the
+  // frame's last reads finished before the frame was begun again, and every cluster is rewritten, so the compute
+  // family takes the buffer back from graphics without a transfer
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->getPipeline());
+  vkCmdBindDescriptorSets(
+    commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &descriptorSet, 0, nullptr
+  );
+  // One workgroup covers a whole depth slice of the grid
+  vkCmdDispatch(commandBuffer, 1, 1, CLUSTER_Z);
+
+  BufferTransfer transfer{clusterBuffers[frame], computeFamily, graphicsFamily};
+  if (transfer.isNeeded())
+    transfer.release(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void ClusteredLighting::acquireClusters(VkCommandBuffer commandBuffer, uint32_t frame) const
+{
+  BufferTransfer transfer{clusterBuffers[frame], computeFamily, graphicsFamily};
+  transfer.acquire(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+VkDescriptorBufferInfo ClusteredLighting::getLightBufferInfo(uint32_t frame) const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = lightBuffers[frame];
+  bufferInfo.offset = 0;
+  bufferInfo.range = sizeof(PointLight) * baseLights.size();
+  return bufferInfo;
+}
+
+VkDescriptorBufferInfo ClusteredLighting::getClusterBufferInfo(uint32_t frame) const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = clusterBuffers[frame];
+  bufferInfo.offset = 0;
+  bufferInfo.range = clusterBufferSize;
+  return bufferInfo;
+}
@@ -0,0 +1,40 @@
+#include "compute_pipeline.hpp"
+#include "shader.hpp"
+
+ComputePipeline::ComputePipeline(VkDevice dev, const std::string& shaderPath, VkPipelineLayout layout)
+  : device(dev), pipeline(VK_NULL_HANDLE)
+{
+  auto code = loadShaderCode(shaderPath);
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = code.size_bytes();
+  moduleInfo.pCode = code.data();
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create compute shader module!");
+
+  VkPipelineShaderStageCreateInfo stageInfo{};
+  stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stageInfo.module = shaderModule;
+  stageInfo.pName = "main";
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = stageInfo;
+  pipelineInfo.layout = layout;
+
+  VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+
+  if (result != VK_SUCCESS)
+    throw std::runtime_error("Failed to create compute pipeline: " + shaderPath);
+}
+
+ComputePipeline::~ComputePipeline()
+{
+  if (pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(device, pipeline, nullptr);
+}
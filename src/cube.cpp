@@ -11,68 +11,77 @@ VkVertexInputBindingDescription Vertex::getBindingDescription()
   return bindingDescription;
 }
 
-std::vector<VkVertexInputAttributeDescription> Vertex::getAttributeDescriptions()
+const std::array<VkVertexInputAttributeDescription, Vertex::ATTRIBUTE_COUNT>& Vertex::getAttributeDescriptions()
 {
-  std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
-
-  attributeDescriptions[0].binding = 0;
-  attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-  attributeDescriptions[1].binding = 0;
-  attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
+  static const std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions =
+  {{
+    {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)},
+    {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)},
+    {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)},
+    {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord)}
+  }};
+  return attributeDescriptions;
+}
 
-  attributeDescriptions[2].binding = 0;
-  attributeDescriptions[2].location = 2;
-  attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[2].offset = offsetof(Vertex, normal);
+VkVertexInputBindingDescription Vertex::getPositionBindingDescription()
+{
+  VkVertexInputBindingDescription bindingDescription{};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = sizeof(glm::vec3);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return bindingDescription;
+}
 
-  return attributeDescriptions;
+VkVertexInputAttributeDescription Vertex::getPositionAttributeDescription()
+{
+  VkVertexInputAttributeDescription attributeDescription{};
+  attributeDescription.binding = 0;
+  attributeDescription.location = 0;
+  attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributeDescription.offset = 0;
+  return attributeDescription;
 }
 
-Cube::Cube(VkPhysicalDevice physDev, VkDevice dev, VkCommandPool commandPool, VkQueue queue)
+Cube::Cube(VkPhysicalDevice physDev, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue)
   : physicalDevice(physDev), device(dev)
 {
   vertices =
   {
     // Front face (Z = +0.5) - normal = (0, 0, 1)
-    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}},  // 0
-    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}},  // 1
-    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}},  // 2
-    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}},  // 3
+    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}, {0.0f, 1.0f}},  // 0
+    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}, {1.0f, 1.0f}},  // 1
+    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}, {1.0f, 0.0f}},  // 2
+    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f,  1.0f}, {0.0f, 0.0f}},  // 3
 
     // Back face (Z = -0.5) - normal = (0, 0, -1)
-    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}},  // 4
-    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}},  // 5
-    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}},  // 6
-    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}},  // 7
+    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f}},  // 4
+    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}, {1.0f, 1.0f}},  // 5
+    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}, {1.0f, 0.0f}},  // 6
+    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f}},  // 7
 
     // Top face (Y = +0.5) - normal = (0, 1, 0)
-    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}},  // 8
-    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}},  // 9
-    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}},  // 10
-    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}},  // 11
+    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}, {0.0f, 1.0f}},  // 8
+    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}, {1.0f, 1.0f}},  // 9
+    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}, {1.0f, 0.0f}},  // 10
+    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f,  1.0f, 0.0f}, {0.0f, 0.0f}},  // 11
 
     // Bottom face (Y = -0.5) - normal = (0, -1, 0)
-    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}},  // 12
-    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}},  // 13
-    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}},  // 14
-    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}},  // 15
+    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {0.0f, 1.0f}},  // 12
+    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {1.0f, 1.0f}},  // 13
+    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {1.0f, 0.0f}},  // 14
+    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f}},  // 15
 
     // Right face (X = +0.5) - normal = (1, 0, 0)
-    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}},  // 16
-    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}},  // 17
-    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}},  // 18
-    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}},  // 19
+    {{ 0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f}},  // 16
+    {{ 0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},  // 17
+    {{ 0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},  // 18
+    {{ 0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, { 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},  // 19
 
     // Left face (X = -0.5) - normal = (-1, 0, 0)
-    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}},  // 20
-    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}},  // 21
-    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}},  // 22
-    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}}   // 23
+    {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f}},  // 20
+    {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},  // 21
+    {{-0.5f,  0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},  // 22
+    {{-0.5f, -0.5f,  0.5f}, {0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}}   // 23
   };
 
   indices =
@@ -86,6 +95,7 @@ Cube::Cube(VkPhysicalDevice physDev, VkDevice dev, VkCommandPool commandPool, Vk
   };
 
   createVertexBuffer(commandPool, queue);
+  createPositionBuffer(commandPool, queue);
   createIndexBuffer(commandPool, queue);
 }
 
@@ -99,6 +109,10 @@ Cube::~Cube()
     vkDestroyBuffer(device, vertexBuffer, nullptr);
   if (vertexBufferMemory != VK_NULL_HANDLE && device != VK_NULL_HANDLE)
     vkFreeMemory(device, vertexBufferMemory, nullptr);
+  if (positionBuffer != VK_NULL_HANDLE && device != VK_NULL_HANDLE)
+    vkDestroyBuffer(device, positionBuffer, nullptr);
+  if (positionBufferMemory != VK_NULL_HANDLE && device != VK_NULL_HANDLE)
+    vkFreeMemory(device, positionBufferMemory, nullptr);
 }
 
 VkBuffer Cube::createBuffer(
@@ -141,7 +155,7 @@ VkBuffer Cube::createBuffer(
 }
 
 void Cube::copyBuffer(
-  VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool, VkQueue queue
+  VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool, QueueTimeline& queue
 ) {
   VkCommandBufferAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -163,22 +177,15 @@ void Cube::copyBuffer(
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
   vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-
-  vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(queue);
+  queue.wait(queue.submit({&commandBuffer, 1}));
 
   vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void Cube::createVertexBuffer(VkCommandPool commandPool, VkQueue queue)
-{
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
+VkBuffer Cube::createDeviceLocalBuffer(
+  const void* contents, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkDeviceMemory& memory,
+  VkCommandPool commandPool, QueueTimeline& queue
+) {
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
   stagingBuffer = createBuffer(
@@ -189,46 +196,46 @@ void Cube::createVertexBuffer(VkCommandPool commandPool, VkQueue queue)
 
   void* data;
   vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices.data(), bufferSize);
+  memcpy(data, contents, bufferSize);
   vkUnmapMemory(device, stagingBufferMemory);
 
-  vertexBuffer = createBuffer(
-    bufferSize,
-    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBufferMemory
+  VkBuffer buffer = createBuffer(
+    bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory
   );
 
-  copyBuffer(stagingBuffer, vertexBuffer, bufferSize, commandPool, queue);
+  copyBuffer(stagingBuffer, buffer, bufferSize, commandPool, queue);
 
   vkDestroyBuffer(device, stagingBuffer, nullptr);
   vkFreeMemory(device, stagingBufferMemory, nullptr);
+  return buffer;
 }
 
-void Cube::createIndexBuffer(VkCommandPool commandPool, VkQueue queue)
+void Cube::createVertexBuffer(VkCommandPool commandPool, QueueTimeline& queue)
 {
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  stagingBuffer = createBuffer(
-    bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    stagingBufferMemory
+  vertexBuffer = createDeviceLocalBuffer(
+    vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    vertexBufferMemory, commandPool, queue
   );
+}
 
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices.data(), bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
-
-  indexBuffer = createBuffer(
-    bufferSize,
-    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBufferMemory
+void Cube::createPositionBuffer(VkCommandPool commandPool, QueueTimeline& queue)
+{
+  // Depth-only passes fetch 12 bytes per vertex instead of the full interleaved vertex
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices)
+    positions.push_back(vertex.pos);
+
+  positionBuffer = createDeviceLocalBuffer(
+    positions.data(), sizeof(positions[0]) * positions.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    positionBufferMemory, commandPool, queue
   );
+}
 
-  copyBuffer(stagingBuffer, indexBuffer, bufferSize, commandPool, queue);
-
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+void Cube::createIndexBuffer(VkCommandPool commandPool, QueueTimeline& queue)
+{
+  indexBuffer = createDeviceLocalBuffer(
+    indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+    indexBufferMemory, commandPool, queue
+  );
 }
@@ -24,18 +24,18 @@ static VkFormat findSupportedFormat(
   throw std::runtime_error("Failed to find supported format!");
 }
 
-static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice)
+VkFormat DepthBuffer::findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags extraFeatures)
 {
   return findSupportedFormat(
     physicalDevice,
     {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
     VK_IMAGE_TILING_OPTIMAL,
-    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | extraFeatures
   );
 }
 
-DepthBuffer::DepthBuffer(VkPhysicalDevice physicalDevice, VkDevice dev, VkExtent2D extent)
-  : device(dev), depthFormat(findDepthFormat(physicalDevice))
+DepthBuffer::DepthBuffer(VkPhysicalDevice physicalDevice, VkDevice dev, VkExtent2D size, VkImageUsageFlags extraUsage)
+  : device(dev), depthFormat(findDepthFormat(physicalDevice, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)), extent(size)
 {
   std::cout << "Creating depth image " << extent.width << "x" << extent.height << std::endl;
 
@@ -51,7 +51,8 @@ DepthBuffer::DepthBuffer(VkPhysicalDevice physicalDevice, VkDevice dev, VkExtent
   imageInfo.format = depthFormat;
   imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
   imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  // Sampled by the Hi-Z pyramid reduction
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | extraUsage;
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -1,88 +1,218 @@
 #include "descriptor.hpp"
 
-Descriptor::Descriptor(VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t imageCount)
-  : device(dev), descriptorSetLayout(VK_NULL_HANDLE), descriptorPool(VK_NULL_HANDLE), pipelineLayout(VK_NULL_HANDLE)
+#include <algorithm>
+#include <array>
+
+Descriptor::Descriptor(
+  VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t frameCount, LayoutCache& layouts,
+  const ShaderReflection& reflection
+) : device(dev), descriptorSetLayout(VK_NULL_HANDLE), descriptorPool(VK_NULL_HANDLE), pipelineLayout(VK_NULL_HANDLE)
 {
-  // 1. Descriptor set layout
-  VkDescriptorSetLayoutBinding uboLayoutBinding{};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  VkDescriptorSetLayoutCreateInfo layoutInfo{};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = 1;
-  layoutInfo.pBindings = &uboLayoutBinding;
-
-  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
-    throw std::runtime_error("Failed to create descriptor set layout!");
-
-  // 2. Pipeline layout
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-    throw std::runtime_error("Failed to create pipeline layout!");
-
-  // 3. Descriptor pool
-  VkDescriptorPoolSize poolSize{};
-  poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSize.descriptorCount = static_cast<uint32_t>(imageCount);
+  // 1. Set 0 and the push constant as every shader using them declares them: the UBO, texture, lights,
+  // clusters, shadow map, culling buffers, Hi-Z pyramid, G-buffer inputs, late-latched camera and mip feedback
+  if (reflection.getBlockSize(0, 0) != sizeof(UniformBufferObject))
+    throw std::runtime_error("UniformBufferObject does not match the shaders' uniform block!");
+  if (reflection.getBlockSize(0, 12) != sizeof(LatchedCamera))
+    throw std::runtime_error("LatchedCamera does not match the shaders' uniform block!");
+
+  descriptorSetLayout = layouts.getSetLayout(reflection, 0);
+
+  // 2. Pipeline layout, the push constant selects the draw list (vertex) or the cull mode (compute)
+  pipelineLayout = layouts.getPipelineLayout(reflection);
+
+  // 3. Descriptor pool, one set per swapchain image
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const auto& binding : reflection.getSetBindings(0))
+  {
+    auto size = std::find_if(poolSizes.begin(), poolSizes.end(), [&](const VkDescriptorPoolSize& poolSize) {
+      return poolSize.type == binding.descriptorType;
+    });
+    if (size == poolSizes.end())
+      size = poolSizes.insert(poolSizes.end(), {binding.descriptorType, 0});
+    size->descriptorCount += binding.descriptorCount * frameCount;
+  }
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount = 1;
-  poolInfo.pPoolSizes = &poolSize;
-  poolInfo.maxSets = static_cast<uint32_t>(imageCount);
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = static_cast<uint32_t>(frameCount);
 
   if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
     throw std::runtime_error("Failed to create descriptor pool!");
 
   // 4. Allocate descriptor sets
-  std::vector<VkDescriptorSetLayout> layouts(imageCount, descriptorSetLayout);
+  std::vector<VkDescriptorSetLayout> setLayouts(frameCount, descriptorSetLayout);
   VkDescriptorSetAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocInfo.descriptorPool = descriptorPool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(imageCount);
-  allocInfo.pSetLayouts = layouts.data();
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(frameCount);
+  allocInfo.pSetLayouts = setLayouts.data();
 
-  descriptorSets.resize(imageCount);
+  descriptorSets.resize(frameCount);
+  boundImageViews.assign(frameCount, VK_NULL_HANDLE);
+  boundSamplers.assign(frameCount, VK_NULL_HANDLE);
   if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
     throw std::runtime_error("Failed to allocate descriptor sets!");
 }
 
 Descriptor::~Descriptor()
 {
-  if (pipelineLayout != VK_NULL_HANDLE)
-  {
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    pipelineLayout = VK_NULL_HANDLE;
-  }
-
   if (descriptorPool != VK_NULL_HANDLE)
   {
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     descriptorPool = VK_NULL_HANDLE;
   }
+}
+
+void Descriptor::update(uint32_t frame, const UniformBuffer& uniformBuffer)
+{
+  VkDescriptorBufferInfo bufferInfo = uniformBuffer.getDescriptorInfo(frame);
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void Descriptor::updateTexture(uint32_t frame, const VkDescriptorImageInfo& imageInfo)
+{
+  if (boundImageViews[frame] == imageInfo.imageView && boundSamplers[frame] == imageInfo.sampler)
+    return;
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 1;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+  boundImageViews[frame] = imageInfo.imageView;
+  boundSamplers[frame] = imageInfo.sampler;
+}
+
+void Descriptor::updateLighting(
+  uint32_t frame, const VkDescriptorBufferInfo& lightBuffer, const VkDescriptorBufferInfo& clusterBuffer
+) {
+  std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+  descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[0].dstSet = descriptorSets[frame];
+  descriptorWrites[0].dstBinding = 2;
+  descriptorWrites[0].dstArrayElement = 0;
+  descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo = &lightBuffer;
+
+  descriptorWrites[1] = descriptorWrites[0];
+  descriptorWrites[1].dstBinding = 3;
+  descriptorWrites[1].pBufferInfo = &clusterBuffer;
+
+  vkUpdateDescriptorSets(
+    device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr
+  );
+}
+
+void Descriptor::updateShadowMap(uint32_t frame, const VkDescriptorImageInfo& imageInfo)
+{
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 4;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void Descriptor::updateCulling(
+  uint32_t frame, const VkDescriptorBufferInfo& objectBuffer,
+  const VkDescriptorBufferInfo& drawBuffer, const VkDescriptorBufferInfo& historyBuffer
+) {
+  std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+
+  descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[0].dstSet = descriptorSets[frame];
+  descriptorWrites[0].dstBinding = 5;
+  descriptorWrites[0].dstArrayElement = 0;
+  descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo = &objectBuffer;
+
+  descriptorWrites[1] = descriptorWrites[0];
+  descriptorWrites[1].dstBinding = 6;
+  descriptorWrites[1].pBufferInfo = &drawBuffer;
+
+  descriptorWrites[2] = descriptorWrites[0];
+  descriptorWrites[2].dstBinding = 7;
+  descriptorWrites[2].pBufferInfo = &historyBuffer;
+
+  vkUpdateDescriptorSets(
+    device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr
+  );
+}
+
+void Descriptor::updateHiZ(uint32_t frame, const VkDescriptorImageInfo& imageInfo)
+{
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 8;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
 
-  if (descriptorSetLayout != VK_NULL_HANDLE)
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void Descriptor::updateGBuffer(
+  uint32_t frame, VkImageView albedoView, VkImageView normalView, VkImageView depthView
+) {
+  std::array<VkDescriptorImageInfo, 3> imageInfos{};
+  imageInfos[0].imageView = albedoView;
+  imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfos[1].imageView = normalView;
+  imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfos[2].imageView = depthView;
+  imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+  for (uint32_t i = 0; i < descriptorWrites.size(); i++)
   {
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-    descriptorSetLayout = VK_NULL_HANDLE;
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = descriptorSets[frame];
+    descriptorWrites[i].dstBinding = 9 + i;
+    descriptorWrites[i].dstArrayElement = 0;
+    descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].pImageInfo = &imageInfos[i];
   }
+
+  vkUpdateDescriptorSets(
+    device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr
+  );
 }
 
-void Descriptor::update(uint32_t currentImage, const UniformBuffer& uniformBuffer)
+void Descriptor::updateLateLatch(uint32_t frame, const LateLatch& lateLatch)
 {
-  VkDescriptorBufferInfo bufferInfo = uniformBuffer.getDescriptorInfo(currentImage);
+  VkDescriptorBufferInfo bufferInfo = lateLatch.getDescriptorInfo(frame);
 
   VkWriteDescriptorSet descriptorWrite{};
   descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrite.dstSet = descriptorSets[currentImage];
-  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 12;
   descriptorWrite.dstArrayElement = 0;
   descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   descriptorWrite.descriptorCount = 1;
@@ -90,3 +220,19 @@ void Descriptor::update(uint32_t currentImage, const UniformBuffer& uniformBuffe
 
   vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
 }
+
+void Descriptor::updateMipFeedback(uint32_t frame, const MipFeedback& mipFeedback)
+{
+  VkDescriptorBufferInfo bufferInfo = mipFeedback.getDescriptorInfo(frame);
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 13;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
@@ -0,0 +1,205 @@
+#include "draw_queue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <thread>
+#include <vector>
+
+// 8 bits per pass: a histogram fits in L1 and 64-bit keys take at most 8 passes
+static constexpr uint32_t RADIX_BITS = 8;
+static constexpr uint32_t RADIX = 1u << RADIX_BITS;
+static constexpr uint32_t DIGIT_COUNT = 64 / RADIX_BITS;
+
+DrawQueue::DrawQueue(LinearArena& arena, size_t capacity)
+  : packets(ArenaAllocator<DrawPacket>(arena)), entries(ArenaAllocator<SortEntry>(arena)),
+    scratch(ArenaAllocator<SortEntry>(arena))
+{
+  packets.reserve(capacity);
+  entries.reserve(capacity);
+  scratch.reserve(capacity);
+}
+
+uint64_t DrawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+  const uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+  const uint64_t depthBits = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * depthMax);
+
+  uint64_t key = pass & ((1u << PASS_BITS) - 1);
+  key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+  key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+  key = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+  return (key << DEPTH_BITS) | depthBits;
+}
+
+void DrawQueue::push(const DrawPacket& packet)
+{
+  entries.push_back({packet.key, static_cast<uint32_t>(packets.size())});
+  packets.push_back(packet);
+}
+
+void DrawQueue::sort()
+{
+  scratch.resize(entries.size());
+  radixSort(entries, scratch);
+}
+
+void DrawQueue::radixSort(std::span<SortEntry> keys, std::span<SortEntry> spare)
+{
+  const size_t count = keys.size();
+  if (count < 2)
+    return;
+
+  // Digits every key shares, like the pass and pipeline of a single-pipeline queue, would move nothing
+  uint64_t varying = 0;
+  for (const SortEntry& entry : keys)
+    varying |= entry.key ^ keys[0].key;
+
+  std::array<uint32_t, DIGIT_COUNT> shifts;
+  uint32_t passCount = 0;
+  for (uint32_t digit = 0; digit < DIGIT_COUNT; digit++)
+    if ((varying >> (digit * RADIX_BITS)) & (RADIX - 1))
+      shifts[passCount++] = digit * RADIX_BITS;
+  if (passCount == 0)
+    return;
+
+  uint32_t threadCount = 1;
+  if (count >= PARALLEL_THRESHOLD)
+    threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_SORT_THREADS);
+  const size_t chunkSize = (count + threadCount - 1) / threadCount;
+
+  // Every thread owns a contiguous chunk and its histogram. Offsets are summed digit by digit with the chunks
+  // in order, so the chunks scatter in parallel and the sort stays stable
+  std::array<std::array<size_t, RADIX>, MAX_SORT_THREADS> offsets;
+  SortEntry* source = keys.data();
+  SortEntry* target = spare.data();
+  uint32_t pass = 0;
+  bool scattered = false;
+
+  auto step = [&]() noexcept {
+    if (scattered)
+    {
+      std::swap(source, target);
+      pass++;
+    }
+    else
+    {
+      size_t sum = 0;
+      for (uint32_t digit = 0; digit < RADIX; digit++)
+        for (uint32_t thread = 0; thread < threadCount; thread++)
+        {
+          const size_t digitCount = offsets[thread][digit];
+          offsets[thread][digit] = sum;
+          sum += digitCount;
+        }
+    }
+    scattered = !scattered;
+  };
+  std::barrier sync(threadCount, step);
+
+  auto sortChunk = [&](uint32_t thread) {
+    const size_t begin = std::min(count, thread * chunkSize);
+    const size_t end = std::min(count, begin + chunkSize);
+    std::array<size_t, RADIX>& offset = offsets[thread];
+
+    while (pass < passCount)
+    {
+      const uint32_t shift = shifts[pass];
+      offset.fill(0);
+      for (size_t i = begin; i < end; i++)
+        offset[(source[i].key >> shift) & (RADIX - 1)]++;
+      sync.arrive_and_wait();
+
+      for (size_t i = begin; i < end; i++)
+        target[offset[(source[i].key >> shift) & (RADIX - 1)]++] = source[i];
+      sync.arrive_and_wait();
+    }
+  };
+
+  std::vector<std::jthread> workers;
+  workers.reserve(threadCount - 1);
+  for (uint32_t thread = 1; thread < threadCount; thread++)
+    workers.emplace_back(sortChunk, thread);
+  sortChunk(0);
+  workers.clear();
+
+  // An odd number of passes leaves the result in the scratch buffer
+  if (source != keys.data())
+    std::copy(source, source + count, keys.data());
+}
+
+void DrawQueue::record(
+  VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags constantStages, uint32_t pass,
+  DrawStats& stats
+) const {
+  // The pass is the top of the key, its packets are one run of the sorted entries
+  const uint32_t passShift = 64 - PASS_BITS;
+  auto first = std::partition_point(entries.begin(), entries.end(), [&](const SortEntry& entry) {
+    return (entry.key >> passShift) < pass;
+  });
+  auto last = std::partition_point(first, entries.end(), [&](const SortEntry& entry) {
+    return (entry.key >> passShift) == pass;
+  });
+
+  VkPipeline boundPipeline = VK_NULL_HANDLE;
+  VkDescriptorSet boundSet = VK_NULL_HANDLE;
+  VkBuffer boundVertices = VK_NULL_HANDLE;
+  VkBuffer boundIndices = VK_NULL_HANDLE;
+
+  for (auto entry = first; entry != last; entry++)
+  {
+    const DrawPacket& packet = packets[entry->packet];
+
+    if (packet.pipeline != boundPipeline)
+    {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+      boundPipeline = packet.pipeline;
+      stats.pipelineBinds++;
+    }
+    else
+      stats.skippedBinds++;
+
+    // Sets stay bound across pipelines of the same layout
+    if (packet.descriptorSet != VK_NULL_HANDLE && packet.descriptorSet != boundSet)
+    {
+      vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &packet.descriptorSet, 0, nullptr
+      );
+      boundSet = packet.descriptorSet;
+      stats.descriptorBinds++;
+    }
+    else if (packet.descriptorSet != VK_NULL_HANDLE)
+      stats.skippedBinds++;
+
+    const DrawMesh& mesh = *packet.mesh;
+    if (mesh.vertexBuffer != VK_NULL_HANDLE)
+    {
+      if (mesh.vertexBuffer != boundVertices || mesh.indexBuffer != boundIndices)
+      {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        boundVertices = mesh.vertexBuffer;
+        boundIndices = mesh.indexBuffer;
+        stats.meshBinds++;
+      }
+      else
+        stats.skippedBinds++;
+    }
+
+    if (packet.constants.size > 0)
+      vkCmdPushConstants(
+        commandBuffer, layout, constantStages, 0, packet.constants.size, packet.constants.values.data()
+      );
+
+    if (packet.indirect.buffer != VK_NULL_HANDLE)
+      vkCmdDrawIndexedIndirect(
+        commandBuffer, packet.indirect.buffer, packet.indirect.offset, 1, sizeof(VkDrawIndexedIndirectCommand)
+      );
+    else if (mesh.vertexBuffer != VK_NULL_HANDLE)
+      vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
+    else
+      vkCmdDraw(commandBuffer, mesh.indexCount, 1, 0, 0);
+    stats.draws++;
+  }
+}
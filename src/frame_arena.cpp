@@ -0,0 +1,144 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t initialCapacity, bool poisonReleased)
+  : block(new std::byte[initialCapacity]), capacity(initialCapacity), offset(0), overflowBytes(0),
+    highWater(0), heapAllocations(0), poison(poisonReleased)
+{
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+  // Aligned by address, the block itself only has the default new alignment
+  uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+  size_t start = alignUp(base + offset, alignment) - base;
+  if (start + size <= capacity)
+  {
+    offset = start + size;
+    return block.get() + start;
+  }
+
+  // Out of room: a heap block just for this allocation, released with the next reset
+  std::byte* memory = new std::byte[size + alignment - 1];
+  overflow.emplace_back(memory);
+  overflowBytes += size + alignment - 1;
+  heapAllocations++;
+  uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+  return memory + (alignUp(address, alignment) - address);
+}
+
+void LinearArena::reset()
+{
+  highWater = std::max(highWater, getUsed());
+
+  if (poison)
+    std::memset(block.get(), 0xDD, offset);
+
+  if (!overflow.empty())
+  {
+    overflow.clear();
+    capacity = std::bit_ceil(highWater);
+    block.reset(new std::byte[capacity]);
+    heapAllocations++;
+  }
+
+  offset = 0;
+  overflowBytes = 0;
+}
+
+uint32_t LinearArena::takeHeapAllocations()
+{
+  uint32_t count = heapAllocations;
+  heapAllocations = 0;
+  return count;
+}
+
+// Process-wide, so a worker keeps its slot in the arenas of every frame. Slots of exited threads are handed
+// out again, the arenas they used then belong to the next thread taking them
+static std::mutex slotMutex;
+static std::vector<uint32_t> freeSlots;
+static uint32_t nextSlot = 0;
+
+// Takes the lowest free slot, so slot 0 stays with the render thread and the others stay dense
+struct ThreadSlotHolder
+{
+  uint32_t slot;
+
+  ThreadSlotHolder()
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    if (freeSlots.empty())
+    {
+      slot = nextSlot++;
+      return;
+    }
+    auto lowest = std::min_element(freeSlots.begin(), freeSlots.end());
+    slot = *lowest;
+    freeSlots.erase(lowest);
+  }
+
+  ~ThreadSlotHolder()
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    freeSlots.push_back(slot);
+  }
+};
+
+static uint32_t threadSlot()
+{
+  thread_local ThreadSlotHolder holder;
+  return holder.slot;
+}
+
+FrameArena::FrameArena(size_t capacity, size_t workerCapacity, bool poisonReleased)
+  : threadCapacity(workerCapacity), poison(poisonReleased)
+{
+  arenas[0] = std::make_unique<LinearArena>(capacity, poison);
+}
+
+LinearArena& FrameArena::get()
+{
+  uint32_t slot = threadSlot();
+  if (slot >= MAX_THREADS)
+    throw std::runtime_error("Too many threads allocating from frame arenas!");
+
+  if (!arenas[slot])
+    arenas[slot] = std::make_unique<LinearArena>(threadCapacity, poison);
+  return *arenas[slot];
+}
+
+void FrameArena::reset()
+{
+  for (auto& arena : arenas)
+    if (arena)
+      arena->reset();
+}
+
+size_t FrameArena::getHighWater() const
+{
+  size_t total = 0;
+  for (const auto& arena : arenas)
+    if (arena)
+      total += arena->getHighWater();
+  return total;
+}
+
+uint32_t FrameArena::takeHeapAllocations()
+{
+  uint32_t total = 0;
+  for (auto& arena : arenas)
+    if (arena)
+      total += arena->takeHeapAllocations();
+  return total;
+}
@@ -0,0 +1,397 @@
+#include "frame_capture.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <filesystem>
+
+#ifdef HERTRA_HAS_PNG
+  #include <png.h>
+#endif
+
+#ifdef _WIN32
+  #define popen _popen
+  #define pclose _pclose
+#endif
+
+static const uint32_t NO_SLOT = UINT32_MAX;
+
+FrameCapture::FrameCapture(
+  VkPhysicalDevice physicalDev, VkDevice dev, VkFormat format, VkExtent2D imageExtent, uint32_t framesInFlight,
+  CaptureFormat captureFormat, const std::string& outputPath, uint32_t captureInterval, uint32_t streamFrameRate
+) : device(dev), physicalDevice(physicalDev), imageFormat(format), extent(imageExtent), cached(false),
+    slotCount(framesInFlight + SPARE_SLOTS), outputFormat(captureFormat), output(outputPath),
+    interval(std::max(captureInterval, 1u)), frameRate(std::max(streamFrameRate, 1u)), recordingSlot(NO_SLOT),
+    frameNumber(0), sequence(0), dropped(0), stream(nullptr), pipe(false), streamExtent{0, 0}, queuedSlots(0),
+    busyWriters(0), stopping(false), written(0), failed(0)
+{
+  if (!supportsFormat(imageFormat))
+    throw std::runtime_error("Frame capture does not support the swapchain format!");
+
+  uint32_t writerCount = 1;
+  if (outputFormat == CaptureFormat::Png)
+  {
+#ifndef HERTRA_HAS_PNG
+    throw std::runtime_error("PNG capture is disabled (libpng not found), use y4m or rgb!");
+#endif
+    std::filesystem::create_directories(output);
+    writerCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_PNG_WRITERS);
+  }
+  else
+  {
+    // "|command" pipes the stream into a process, e.g. an encoder reading stdin
+    pipe = !output.empty() && output[0] == '|';
+    stream = pipe ? popen(output.c_str() + 1, "w") : std::fopen(output.c_str(), "wb");
+    if (!stream)
+      throw std::runtime_error("Failed to open capture output: " + output);
+#ifdef SIGPIPE
+    // A reader that exits early ends the capture with a failed write, not the process
+    if (pipe)
+      std::signal(SIGPIPE, SIG_IGN);
+#endif
+  }
+
+  // Cached memory makes the writers' reads fast, uncached host memory is read at bus speed
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  const VkMemoryPropertyFlags cachedFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    if ((memoryProperties.memoryTypes[i].propertyFlags & cachedFlags) == cachedFlags)
+      cached = true;
+
+  createSlots();
+  for (uint32_t i = 0; i < writerCount; i++)
+    writers.emplace_back(&FrameCapture::writerLoop, this);
+
+  static const char* FORMAT_NAMES[] = {"PNG", "Y4M", "RGB"};
+  std::cout << "Frame capture: " << FORMAT_NAMES[static_cast<uint32_t>(outputFormat)] << " to " << output
+            << ", every " << interval << " frame(s), " << slotCount << " readback slots, " << writerCount
+            << " writer(s)" << std::endl;
+}
+
+FrameCapture::~FrameCapture()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (std::thread& writer : writers)
+    if (writer.joinable())
+      writer.join();
+
+  destroySlots();
+  if (stream)
+    pipe ? pclose(stream) : std::fclose(stream);
+}
+
+bool FrameCapture::supportsFormat(VkFormat format)
+{
+  switch (format)
+  {
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+  case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void FrameCapture::createSlots()
+{
+  const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+  const VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+    (cached ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  slots.resize(slotCount);
+  for (Slot& slot : slots)
+  {
+    slot.buffer = createBuffer(
+      physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.memory
+    );
+    void* data;
+    vkMapMemory(device, slot.memory, 0, size, 0, &data);
+    slot.mapped = static_cast<const uint8_t*>(data);
+    slot.state = SlotState::Free;
+    slot.value = 0;
+    slot.sequence = 0;
+  }
+}
+
+void FrameCapture::destroySlots()
+{
+  for (Slot& slot : slots)
+  {
+    vkUnmapMemory(device, slot.memory);
+    vkDestroyBuffer(device, slot.buffer, nullptr);
+    vkFreeMemory(device, slot.memory, nullptr);
+  }
+  slots.clear();
+}
+
+void FrameCapture::beginFrame()
+{
+  if (frameNumber++ % interval != 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto free = std::find_if(slots.begin(), slots.end(), [](const Slot& slot) { return slot.state == SlotState::Free; });
+  if (free == slots.end())
+  {
+    dropped++;
+    return;
+  }
+  free->state = SlotState::Recorded;
+  free->sequence = sequence++;
+  recordingSlot = static_cast<uint32_t>(free - slots.begin());
+}
+
+void FrameCapture::record(VkCommandBuffer commandBuffer, VkImage image)
+{
+  if (recordingSlot == NO_SLOT)
+    return;
+
+  // Tightly packed rows, texel for texel as the image stores them
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {extent.width, extent.height, 1};
+  vkCmdCopyImageToBuffer(
+    commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slots[recordingSlot].buffer, 1, &region
+  );
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = slots[recordingSlot].buffer;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(
+    commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr
+  );
+}
+
+void FrameCapture::endFrame(uint64_t value)
+{
+  if (recordingSlot == NO_SLOT)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  slots[recordingSlot].state = SlotState::InFlight;
+  slots[recordingSlot].value = value;
+  recordingSlot = NO_SLOT;
+}
+
+void FrameCapture::collect(QueueTimeline& queue)
+{
+  // Slots are only found in place, a frame loop that captures allocates nothing here
+  uint32_t queued = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Slot& slot : slots)
+    {
+      if (slot.state != SlotState::InFlight || !queue.isComplete(slot.value))
+        continue;
+
+      if (cached)
+      {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+      }
+      slot.state = SlotState::Queued;
+      queued++;
+    }
+    queuedSlots += queued;
+  }
+  if (queued > 0)
+    condition.notify_all();
+}
+
+void FrameCapture::resize(QueueTimeline& queue, VkExtent2D newExtent)
+{
+  collect(queue);
+  drain();
+  destroySlots();
+  extent = newExtent;
+  createSlots();
+}
+
+void FrameCapture::drain()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return queuedSlots == 0 && busyWriters == 0; });
+}
+
+void FrameCapture::takeCounts(uint64_t& writtenCount, uint64_t& droppedCount)
+{
+  writtenCount = written.exchange(0, std::memory_order_relaxed);
+  droppedCount = dropped + failed.exchange(0, std::memory_order_relaxed);
+  dropped = 0;
+}
+
+void FrameCapture::writerLoop()
+{
+  std::vector<uint8_t> scratch;
+  while (true)
+  {
+    uint32_t index;
+    uint64_t frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return stopping || queuedSlots > 0; });
+      if (queuedSlots == 0)
+        return;
+
+      // The oldest capture first; the timeline completes them in order, so none older is still in flight
+      index = NO_SLOT;
+      for (uint32_t i = 0; i < slots.size(); i++)
+        if (slots[i].state == SlotState::Queued && (index == NO_SLOT || slots[i].sequence < slots[index].sequence))
+          index = i;
+      slots[index].state = SlotState::Writing;
+      queuedSlots--;
+      frame = slots[index].sequence;
+      busyWriters++;
+    }
+
+    // The slot goes back to the ring before the slow part, the compression or the write
+    convert(slots[index], scratch);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      slots[index].state = SlotState::Free;
+    }
+
+    if (write(frame, scratch))
+      written.fetch_add(1, std::memory_order_relaxed);
+    else
+      failed.fetch_add(1, std::memory_order_relaxed);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      busyWriters--;
+    }
+    idle.notify_all();
+  }
+}
+
+void FrameCapture::convert(const Slot& slot, std::vector<uint8_t>& scratch) const
+{
+  const uint32_t width = extent.width;
+  const uint32_t height = extent.height;
+  const bool bgra = imageFormat == VK_FORMAT_B8G8R8A8_UNORM || imageFormat == VK_FORMAT_B8G8R8A8_SRGB;
+  const uint32_t red = bgra ? 2 : 0;
+  const uint32_t blue = bgra ? 0 : 2;
+  const uint8_t* pixels = slot.mapped;
+
+  if (outputFormat != CaptureFormat::Y4m)
+  {
+    // PNG and raw streams take 24-bit RGB, alpha is not meaningful in a presented image
+    scratch.resize(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0, count = static_cast<size_t>(width) * height; i < count; i++)
+    {
+      scratch[i * 3 + 0] = pixels[i * 4 + red];
+      scratch[i * 3 + 1] = pixels[i * 4 + 1];
+      scratch[i * 3 + 2] = pixels[i * 4 + blue];
+    }
+    return;
+  }
+
+  // Y4M C420jpeg: full-range BT.601 luma per pixel, chroma from the average of each 2x2 block
+  const uint32_t chromaWidth = (width + 1) / 2;
+  const uint32_t chromaHeight = (height + 1) / 2;
+  const size_t lumaSize = static_cast<size_t>(width) * height;
+  const size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+  scratch.resize(lumaSize + chromaSize * 2);
+  uint8_t* luma = scratch.data();
+  uint8_t* cb = luma + lumaSize;
+  uint8_t* cr = cb + chromaSize;
+
+  for (uint32_t y = 0; y < height; y++)
+    for (uint32_t x = 0; x < width; x++)
+    {
+      const uint8_t* pixel = pixels + (static_cast<size_t>(y) * width + x) * 4;
+      luma[static_cast<size_t>(y) * width + x] =
+        static_cast<uint8_t>((77 * pixel[red] + 150 * pixel[1] + 29 * pixel[blue] + 128) >> 8);
+    }
+
+  for (uint32_t y = 0; y < chromaHeight; y++)
+    for (uint32_t x = 0; x < chromaWidth; x++)
+    {
+      int r = 0, g = 0, b = 0, samples = 0;
+      for (uint32_t dy = 0; dy < 2 && y * 2 + dy < height; dy++)
+        for (uint32_t dx = 0; dx < 2 && x * 2 + dx < width; dx++)
+        {
+          const uint8_t* pixel = pixels + (static_cast<size_t>(y * 2 + dy) * width + x * 2 + dx) * 4;
+          r += pixel[red];
+          g += pixel[1];
+          b += pixel[blue];
+          samples++;
+        }
+      r /= samples;
+      g /= samples;
+      b /= samples;
+      const size_t index = static_cast<size_t>(y) * chromaWidth + x;
+      cb[index] = static_cast<uint8_t>(std::clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255));
+      cr[index] = static_cast<uint8_t>(std::clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255));
+    }
+}
+
+bool FrameCapture::write(uint64_t frame, const std::vector<uint8_t>& scratch)
+{
+  if (outputFormat == CaptureFormat::Png)
+  {
+#ifdef HERTRA_HAS_PNG
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(frame));
+    const std::string path = (std::filesystem::path(output) / name).string();
+
+    png_image png{};
+    png.version = PNG_IMAGE_VERSION;
+    png.width = extent.width;
+    png.height = extent.height;
+    png.format = PNG_FORMAT_RGB;
+    if (!png_image_write_to_file(&png, path.c_str(), 0, scratch.data(), 0, nullptr))
+    {
+      std::cerr << "Failed to write capture " << path << ": " << png.message << std::endl;
+      return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Only the single stream writer gets here
+  if (!stream)
+    return false;
+  if (streamExtent.width == 0)
+  {
+    streamExtent = extent;
+    if (outputFormat == CaptureFormat::Y4m)
+      std::fprintf(stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", extent.width, extent.height, frameRate);
+    else
+      std::cout << "Raw capture stream: rgb24 " << extent.width << "x" << extent.height << std::endl;
+  }
+  // Frame sizes are fixed by the header, captures after a resize are dropped
+  if (streamExtent.width != extent.width || streamExtent.height != extent.height)
+    return false;
+
+  if (outputFormat == CaptureFormat::Y4m)
+    std::fputs("FRAME\n", stream);
+  if (std::fwrite(scratch.data(), 1, scratch.size(), stream) != scratch.size())
+  {
+    std::cerr << "Capture stream closed, stopping the capture" << std::endl;
+    pipe ? pclose(stream) : std::fclose(stream);
+    stream = nullptr;
+    return false;
+  }
+  return true;
+}
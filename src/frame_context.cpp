@@ -0,0 +1,133 @@
+#include "frame_context.hpp"
+
+#include <algorithm>
+
+// Command buffers are recorded once per use, so a pool per frame is reset in one call
+static void createCommandPool(VkDevice device, uint32_t queueFamily, VkCommandPool& pool, VkCommandBuffer& buffer)
+{
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create frame command pool!");
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = pool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(device, &allocInfo, &buffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate command buffers!");
+}
+
+FrameRing::FrameRing(
+  VkDevice dev, QueueTimeline& queueTimeline, uint32_t queueFamily, uint32_t depth, uint32_t computeFamily,
+  bool poisonArenas
+) : device(dev), timeline(queueTimeline), current(0), waitSeconds(0.0), latencySeconds(0.0), latencyCount(0),
+    frameCount(0)
+{
+  frames.resize(std::clamp(depth, 1u, MAX_DEPTH));
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (uint32_t i = 0; i < getDepth(); i++)
+  {
+    FrameContext& frame = frames[i];
+    frame = {};
+    frame.index = i;
+    arenas.push_back(std::make_unique<FrameArena>(ARENA_SIZE, WORKER_ARENA_SIZE, poisonArenas));
+    frame.arena = arenas.back().get();
+
+    if (
+      vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailable) != VK_SUCCESS ||
+      vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderFinished) != VK_SUCCESS
+    ) {
+      throw std::runtime_error("Failed to create synchronization objects!");
+    }
+
+    createCommandPool(device, queueFamily, frame.commandPool, frame.commandBuffer);
+    if (computeFamily != UINT32_MAX)
+      createCommandPool(device, computeFamily, frame.computePool, frame.computeCommandBuffer);
+  }
+
+  std::cout << "Frames in flight: " << frames.size() << std::endl;
+}
+
+FrameRing::~FrameRing()
+{
+  for (auto& frame : frames)
+  {
+    // Destroying the pool frees its command buffer
+    if (frame.commandPool != VK_NULL_HANDLE)
+      vkDestroyCommandPool(device, frame.commandPool, nullptr);
+    if (frame.computePool != VK_NULL_HANDLE)
+      vkDestroyCommandPool(device, frame.computePool, nullptr);
+    if (frame.imageAvailable != VK_NULL_HANDLE)
+      vkDestroySemaphore(device, frame.imageAvailable, nullptr);
+    if (frame.renderFinished != VK_NULL_HANDLE)
+      vkDestroySemaphore(device, frame.renderFinished, nullptr);
+  }
+}
+
+FrameContext& FrameRing::begin()
+{
+  FrameContext& frame = frames[current];
+
+  auto waitStart = std::chrono::steady_clock::now();
+  timeline.wait(frame.submitValue);
+  auto now = std::chrono::steady_clock::now();
+  waitSeconds += std::chrono::duration<double>(now - waitStart).count();
+  frameCount++;
+
+  if (frame.submitted)
+  {
+    latencySeconds += std::chrono::duration<double>(now - frame.startTime).count();
+    latencyCount++;
+    frame.submitted = false;
+  }
+
+  vkResetCommandPool(device, frame.commandPool, 0);
+  if (frame.computePool != VK_NULL_HANDLE)
+    vkResetCommandPool(device, frame.computePool, 0);
+  frame.arena->reset();
+  frame.startTime = now;
+  frame.completeTime = now;
+  return frame;
+}
+
+void FrameRing::end(uint64_t submitValue)
+{
+  frames[current].submitValue = submitValue;
+  frames[current].submitted = true;
+  current = (current + 1) % getDepth();
+}
+
+void FrameRing::takeTimings(double& waitMilliseconds, double& latencyMilliseconds)
+{
+  waitMilliseconds = frameCount > 0 ? waitSeconds * 1000.0 / frameCount : 0.0;
+  latencyMilliseconds = latencyCount > 0 ? latencySeconds * 1000.0 / latencyCount : 0.0;
+  waitSeconds = 0.0;
+  latencySeconds = 0.0;
+  latencyCount = 0;
+  frameCount = 0;
+}
+
+size_t FrameRing::getArenaHighWater() const
+{
+  size_t highWater = 0;
+  for (const auto& arena : arenas)
+    highWater = std::max(highWater, arena->getHighWater());
+  return highWater;
+}
+
+uint32_t FrameRing::takeArenaHeapAllocations()
+{
+  uint32_t count = 0;
+  for (auto& arena : arenas)
+    count += arena->takeHeapAllocations();
+  return count;
+}
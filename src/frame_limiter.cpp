@@ -0,0 +1,80 @@
+#include "frame_limiter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+FrameLimiter::FrameLimiter(uint32_t framesPerSecond)
+  : interval(Clock::duration::zero()), nextFrame(Clock::now()), lastFrame(Clock::now()), spinMargin(MIN_SPIN),
+    intervalSum(0.0), intervalSquares(0.0), intervalMax(0.0), intervalCount(0)
+{
+  setLimit(framesPerSecond);
+}
+
+void FrameLimiter::setLimit(uint32_t framesPerSecond)
+{
+  interval = Clock::duration::zero();
+  if (framesPerSecond > 0)
+    interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+  nextFrame = Clock::now();
+}
+
+uint32_t FrameLimiter::getLimit() const
+{
+  if (interval == Clock::duration::zero())
+    return 0;
+  return static_cast<uint32_t>(std::lround(1.0 / std::chrono::duration<double>(interval).count()));
+}
+
+void FrameLimiter::wait()
+{
+  if (interval != Clock::duration::zero())
+  {
+    Clock::time_point now = Clock::now();
+    // More than a frame behind: start a new schedule rather than rushing frames out to catch up
+    if (now - nextFrame > interval)
+      nextFrame = now;
+
+    const Clock::time_point wakeUp = nextFrame - spinMargin;
+    if (now < wakeUp)
+    {
+      std::this_thread::sleep_until(wakeUp);
+      // Late wake-ups widen the margin at once, early ones narrow it slowly
+      const Clock::duration late = Clock::now() - wakeUp;
+      if (late > spinMargin)
+        spinMargin = std::min<Clock::duration>(late, MAX_SPIN);
+      else
+        spinMargin = std::max<Clock::duration>(spinMargin - spinMargin / 16, MIN_SPIN);
+    }
+
+    while (Clock::now() < nextFrame)
+      std::this_thread::yield();
+    nextFrame += interval;
+  }
+
+  const Clock::time_point now = Clock::now();
+  const double milliseconds = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+  lastFrame = now;
+  intervalSum += milliseconds;
+  intervalSquares += milliseconds * milliseconds;
+  intervalMax = std::max(intervalMax, milliseconds);
+  intervalCount++;
+}
+
+void FrameLimiter::takeIntervals(double& meanMilliseconds, double& jitterMilliseconds, double& maxMilliseconds)
+{
+  meanMilliseconds = 0.0;
+  double variance = 0.0;
+  if (intervalCount > 0)
+  {
+    meanMilliseconds = intervalSum / intervalCount;
+    variance = intervalSquares / intervalCount - meanMilliseconds * meanMilliseconds;
+  }
+  jitterMilliseconds = std::sqrt(std::max(variance, 0.0));
+  maxMilliseconds = intervalMax;
+
+  intervalSum = 0.0;
+  intervalSquares = 0.0;
+  intervalMax = 0.0;
+  intervalCount = 0;
+}
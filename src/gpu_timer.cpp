@@ -0,0 +1,77 @@
+#include "gpu_timer.hpp"
+
+#include <iostream>
+
+GpuTimer::GpuTimer(VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t queueFamily, uint32_t frameCount)
+  : device(dev), queryPool(VK_NULL_HANDLE), pending(frameCount, false), period(0.0), validMask(0),
+    lastMilliseconds(0.0)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+  uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  if (validBits == 0 || properties.limits.timestampPeriod == 0.0f)
+  {
+    std::cout << "Timestamp queries are not supported, GPU frame times are disabled" << std::endl;
+    return;
+  }
+
+  period = properties.limits.timestampPeriod;
+  validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = frameCount * 2;
+
+  if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create timestamp query pool!");
+}
+
+GpuTimer::~GpuTimer()
+{
+  if (queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+bool GpuTimer::collect(uint32_t frame)
+{
+  if (queryPool == VK_NULL_HANDLE || !pending[frame])
+    return false;
+
+  pending[frame] = false;
+
+  uint64_t timestamps[2] = {};
+  VkResult result = vkGetQueryPoolResults(
+    device, queryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT
+  );
+  if (result != VK_SUCCESS)
+    return false;
+
+  uint64_t ticks = (timestamps[1] - timestamps[0]) & validMask;
+  lastMilliseconds = ticks * period / 1e6;
+  return true;
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  if (queryPool == VK_NULL_HANDLE)
+    return;
+
+  vkCmdResetQueryPool(commandBuffer, queryPool, frame * 2, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frame * 2);
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  if (queryPool == VK_NULL_HANDLE)
+    return;
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frame * 2 + 1);
+  pending[frame] = true;
+}
@@ -1,28 +1,69 @@
 #include "graphics_pipeline.hpp"
 
 #include "vertex.hpp"
+#include <algorithm>
 #include <iostream>
 
 GraphicsPipeline::GraphicsPipeline(
-  VkDevice dev, VkExtent2D extent, VkRenderPass renderPass, const Shader& shader, VkPipelineLayout layout
-) : device(dev), pipeline(VK_NULL_HANDLE)
+  VkDevice dev, VkExtent2D extent, const PipelineTarget& target, const Shader& shader, VkPipelineLayout layout,
+  VkCompareOp depthCompareOp, bool depthWrite, VkSampleCountFlagBits samples, const SpecializationConstants& constants
+) : pipeline(VK_NULL_HANDLE), device(dev), shader(shader), target(target), layout(layout),
+    depthCompareOp(depthCompareOp), depthWrite(depthWrite), samples(samples)
 {
-  // 1. Shader stages
+  pipeline = getPipeline(constants);
+  std::cout << "Graphics pipeline created successfully!" << std::endl;
+}
+
+GraphicsPipeline::~GraphicsPipeline()
+{
+  for (const auto& [constants, variant] : variants)
+    vkDestroyPipeline(device, variant, nullptr);
+}
+
+VkPipeline GraphicsPipeline::getPipeline(const SpecializationConstants& constants)
+{
+  auto merged = shader.getConstants().merged(constants);
+  auto cached = variants.find(merged);
+  if (cached != variants.end())
+    return cached->second;
+
+  VkPipeline variant = createVariant(merged);
+  variants.emplace(merged, variant);
+  return variant;
+}
+
+VkPipeline GraphicsPipeline::createVariant(const SpecializationConstants& constants) const
+{
+  // 1. Shader stages, specialized with the same constants
+  SpecializationInfo specialization(constants);
   VkPipelineShaderStageCreateInfo shaderStages[] =
   {
     shader.getVertStageInfo(),
     shader.getFragStageInfo()
   };
+  for (auto& stage : shaderStages)
+    stage.pSpecializationInfo = specialization.get();
 
-  // 2. Vertex input
+  // 2. Vertex input, the attributes the vertex shader reads
   auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
+  const auto& vertexAttributes = Vertex::getAttributeDescriptions();
+  std::array<VkVertexInputAttributeDescription, Vertex::ATTRIBUTE_COUNT> attributeDescriptions;
+  uint32_t attributeCount = 0;
+  for (const auto& input : shader.getReflection().getVertexInputs())
+  {
+    auto attribute = std::find_if(vertexAttributes.begin(), vertexAttributes.end(), [&](const auto& a) {
+      return a.location == input.location && a.format == input.format;
+    });
+    if (attribute == vertexAttributes.end())
+      throw std::runtime_error("Vertex shader input " + std::to_string(input.location) + " is not in Vertex!");
+    attributeDescriptions[attributeCount++] = *attribute;
+  }
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexBindingDescriptionCount = 1;
   vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+  vertexInputInfo.vertexAttributeDescriptionCount = attributeCount;
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
   // 3. Input assembly
@@ -63,26 +104,29 @@ GraphicsPipeline::GraphicsPipeline(
   VkPipelineMultisampleStateCreateInfo multisampling{};
   multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.rasterizationSamples = samples;
 
   // 8. Color blend
   VkPipelineColorBlendAttachmentState colorBlendAttachment{};
   colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
   colorBlendAttachment.blendEnable = VK_FALSE;
+  std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(
+    target.colorAttachmentCount, colorBlendAttachment
+  );
 
   VkPipelineColorBlendStateCreateInfo colorBlending{};
   colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
+  colorBlending.attachmentCount = target.colorAttachmentCount;
+  colorBlending.pAttachments = colorBlendAttachments.data();
 
   // Depth testing
   VkPipelineDepthStencilStateCreateInfo depthStencil{};
   depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+  depthStencil.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = depthCompareOp;
   depthStencil.depthBoundsTestEnable = VK_FALSE;
   depthStencil.minDepthBounds = 0.0f;
   depthStencil.maxDepthBounds = 1.0f;
@@ -104,11 +148,12 @@ GraphicsPipeline::GraphicsPipeline(
   pipelineInfo.pDepthStencilState = &depthStencil;
   pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = layout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
+  VkPipelineRenderingCreateInfoKHR renderingInfo;
+  target.apply(pipelineInfo, renderingInfo);
 
   // 10. Create pipeline
-  VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+  VkPipeline variant;
+  VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &variant);
 
   if (result != VK_SUCCESS)
   {
@@ -116,11 +161,5 @@ GraphicsPipeline::GraphicsPipeline(
     throw std::runtime_error("Failed to create graphics pipeline!");
   }
 
-  std::cout << "Graphics pipeline created successfully!" << std::endl;
-}
-
-GraphicsPipeline::~GraphicsPipeline()
-{
-  if (pipeline != VK_NULL_HANDLE)
-    vkDestroyPipeline(device, pipeline, nullptr);
+  return variant;
 }
@@ -3,17 +3,77 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <filesystem>
+#include <cmath>
+#include <algorithm>
+#include <random>
 
-HertraApp::HertraApp()
-  : surface(VK_NULL_HANDLE), renderPass(VK_NULL_HANDLE), commandPool(VK_NULL_HANDLE), currentFrame(0), running(true)
+static bool isSrgbFormat(VkFormat format)
 {
-  window = std::make_unique<HertraWindow>(800, 600, "Hertra Framework");
-  inputDevice = std::make_unique<InputDevice>(window->getWindow());
-  timer = std::make_unique<Timer>();
+  return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB ||
+    format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
 
-  window->setWindowProc([this](int width, int height) {
-    std::cout << "Window resized: " << width << "x" << height << std::endl;
-  });
+// Draw queue keys of the scene pass: the statistics pass, the pipeline, the texture and the mesh
+static const uint32_t PIPELINE_KEY_DEPTH = 0;
+static const uint32_t PIPELINE_KEY_COLOR = 1;
+static const uint32_t PIPELINE_KEY_LIGHTING = 2;
+static const uint32_t MESH_KEY_POSITIONS = 0;
+static const uint32_t MESH_KEY_VERTICES = 1;
+static const uint32_t MESH_KEY_FULLSCREEN = 2;
+
+// Stages of the scene layout's push constant range, the draw list index
+static const VkShaderStageFlags SCENE_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+static uint64_t sceneKey(StatisticsPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh)
+{
+  // One instanced draw per pass, nothing to order by depth
+  return DrawQueue::makeKey(static_cast<uint32_t>(pass), pipeline, material, mesh, 0.0f);
+}
+
+static VkImageAspectFlags getDepthAspect(VkFormat format)
+{
+  if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT)
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+// Background of the scene pass
+static const VkClearColorValue CLEAR_COLOR = {{0.05f, 0.05f, 0.05f, 1.0f}};
+
+// A minimized or covered window may never show a present, pacing gives up after this many nanoseconds
+static const uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+// Size of the window as opened, and of the offscreen target without one
+static const VkExtent2D WINDOW_SIZE = {800, 600};
+// Mouse orbit: radians per pixel dragged, and the pitch limit either side of the simulated camera
+static const float ORBIT_SPEED = 0.005f;
+static const float MAX_ORBIT_PITCH = 0.5f;
+
+HertraApp::HertraApp(const RenderSettings& renderSettings)
+  : settings(renderSettings), apiVersion(VK_API_VERSION_1_0), surface(VK_NULL_HANDLE), renderPass(VK_NULL_HANDLE),
+    dynamicRendering(false), commandPool(VK_NULL_HANDLE), presentId(0),
+    msaaSamples(VK_SAMPLE_COUNT_1_BIT), renderExtent{0, 0}, swapChainTarget(NO_RESOURCE), depthTarget(NO_RESOURCE),
+    sceneTarget(NO_RESOURCE), msaaColorTarget(NO_RESOURCE), msaaDepthTarget(NO_RESOURCE), upscaleSource(NO_RESOURCE),
+    shadowTarget(NO_RESOURCE), shadowCacheTarget(NO_RESOURCE), hiZTarget(NO_RESOURCE),
+    recordingFrame(nullptr), recordingImage(0), staticSceneVersion(1), spinningCube(0), cubeTexture(0), running(true),
+    orbitYaw(0.0f), orbitPitch(0.0f), cursorX(0.0), cursorY(0.0), dragging(false), inputPending(false)
+{
+  // Headless runs never initialize GLFW, they need no display
+  if (settings.headlessFrames == 0)
+  {
+    window = std::make_unique<HertraWindow>(WINDOW_SIZE.width, WINDOW_SIZE.height, "Hertra Framework");
+    inputDevice = std::make_unique<InputDevice>(window->getWindow());
+    window->setWindowProc([this](int width, int height) {
+      std::cout << "Window resized: " << width << "x" << height << std::endl;
+    });
+  }
+  else
+    std::cout << "Headless: rendering " << settings.headlessFrames << " frames offscreen" << std::endl;
+  timer = std::make_unique<Timer>();
+  frameLimiter = std::make_unique<FrameLimiter>(settings.frameRateLimit);
+  latencyTracker = std::make_unique<LatencyTracker>();
+  if (settings.frameRateLimit > 0)
+    std::cout << "Frame rate limited to " << settings.frameRateLimit << " fps" << std::endl;
 
   initVulkan();
   timer->start();
@@ -28,108 +88,710 @@ void HertraApp::initVulkan()
 {
   std::cout << "=== initVulkan started ===" << std::endl;
 
-  std::cout << "[1/10] Creating instance..." << std::endl;
+  if (!settings.shaderDirectory.empty())
+    setShaderOverrideDirectory(settings.shaderDirectory);
+
+  std::cout << "[1/9] Creating instance..." << std::endl;
   createInstance();
   std::cout << "Instance created" << std::endl;
 
-  std::cout << "[2/10] Creating surface..." << std::endl;
+  std::cout << "[2/9] Creating surface..." << std::endl;
   createSurface();
   std::cout << "Surface created" << std::endl;
 
-  std::cout << "[3/10] Creating device..." << std::endl;
+  std::cout << "[3/9] Creating device..." << std::endl;
   device = std::make_unique<VulkanDevice>();
-  device->init(instance, surface);
-  std::cout << "Device created" << std::endl;
-
-  std::cout << "[4/10] Creating swapchain..." << std::endl;
-  swapChain = std::make_unique<SwapChain>(*device, surface, window->getWindow());
+  device->init(instance, surface, apiVersion, settings.asyncCompute);
+  // Every submission to the graphics queue goes through its timeline
+  graphicsTimeline = std::make_unique<QueueTimeline>(
+    *device, device->getGraphicsQueue(), settings.timelineSemaphores
+  );
+  std::cout << "Device created, synchronized with "
+            << (graphicsTimeline->usesTimelineSemaphore() ? "a timeline semaphore" : "fences") << std::endl;
+  // The fence fallback waits for other queues on the CPU, which would serialize the two queues again
+  if (device->hasAsyncCompute() && graphicsTimeline->usesTimelineSemaphore())
+    computeTimeline = std::make_unique<QueueTimeline>(*device, device->getComputeQueue(), true);
+  const uint32_t graphicsFamily = device->getQueueFamilies().graphicsFamily;
+  const uint32_t computeFamily = computeTimeline ? device->getQueueFamilies().computeFamily : graphicsFamily;
+  std::cout << "Light binning on the " << (computeTimeline ? "async compute" : "graphics") << " queue"
+            << (computeFamily != graphicsFamily ? ", a separate queue family" : "") << std::endl;
+
+  std::cout << "[4/9] Creating swapchain..." << std::endl;
+  if (window)
+    swapChain = std::make_unique<SwapChain>(*device, surface, window->getWindow());
+  else
+    swapChain = std::make_unique<SwapChain>(*device, WINDOW_SIZE);
+  swapChain->setPresentMode(settings.presentMode);
+  // Captures are copied out of the swapchain or offscreen image itself
+  if (!settings.captureOutput.empty())
+    swapChain->requestUsage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+  // The post chain tonemaps and encodes sRGB itself
+  if (settings.postProcess)
+    swapChain->setPreferredFormat(VK_FORMAT_B8G8R8A8_UNORM);
   swapChain->init();
+  if (settings.postProcess && !canBlitToSwapChain())
+  {
+    std::cout << "Swapchain images cannot be blitted to, post processing is disabled" << std::endl;
+    settings.postProcess = false;
+    swapChain->setPreferredFormat(VK_FORMAT_B8G8R8A8_SRGB);
+    swapChain->recreate();
+  }
   std::cout << "Swapchain created" << std::endl;
+  if (settings.presentWait && !device->supportsPresentWait())
+    settings.presentWait = false;
 
-  std::cout << "[5/10] Creating depth buffer..." << std::endl;
-  createDepthBuffer();
-  std::cout << "Depth buffer created" << std::endl;
+  // Needed by the post chain's render targets
+  createCommandPool();
+  samplerCache = std::make_unique<SamplerCache>(
+    device->getPhysicalDevice(), device->getDevice(), device->getEnabledFeatures().samplerAnisotropy
+  );
+  layoutCache = std::make_unique<LayoutCache>(device->getDevice());
+  std::cout << "Command pool created" << std::endl;
 
-  std::cout << "[6/10] Creating render pass..." << std::endl;
-  createRenderPass();
-  std::cout << "Render pass created" << std::endl;
+  // Everything written per frame is sized by the ring depth, not by the swapchain image count
+  frames = std::make_unique<FrameRing>(
+    device->getDevice(), *graphicsTimeline, graphicsFamily, settings.framesInFlight,
+    computeTimeline ? computeFamily : UINT32_MAX, settings.arenaPoison
+  );
+  const uint32_t frameCount = frames->getDepth();
 
-  std::cout << "[7/10] Creating framebuffers..." << std::endl;
-  createFramebuffers();
-  std::cout << "Framebuffers created" << std::endl;
+  if (!settings.captureOutput.empty())
+  {
+    if (!(swapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+      std::cout << "Swapchain images cannot be copied from, frame capture is disabled" << std::endl;
+    else if (!FrameCapture::supportsFormat(swapChain->getImageFormat()))
+      std::cout << "Frame capture does not support the swapchain format, it is disabled" << std::endl;
+    else
+      frameCapture = std::make_unique<FrameCapture>(
+        device->getPhysicalDevice(), device->getDevice(), swapChain->getImageFormat(), swapChain->getExtent(),
+        frameCount, settings.captureFormat, settings.captureOutput, settings.captureInterval,
+        settings.frameRateLimit > 0 ? settings.frameRateLimit : 60
+      );
+  }
 
-  std::cout << "[8/10] Creating command pool..." << std::endl;
-  createCommandPool();
-  std::cout << "Command pool created" << std::endl;
+  std::cout << "[5/9] Creating depth buffer..." << std::endl;
+  if (settings.deferred)
+  {
+    // Input attachments are read per sample, the G-buffer stays single-sampled
+    if (settings.msaaSamples > 1 || settings.depthPrepass)
+      std::cout << "Deferred shading: MSAA and the depth pre-pass are disabled" << std::endl;
+    settings.msaaSamples = 1;
+    settings.depthPrepass = false;
+  }
+  createDepthBuffer();
+  msaaSamples = device->clampSampleCount(settings.msaaSamples);
+  gpuTimer = std::make_unique<GpuTimer>(
+    device->getPhysicalDevice(), device->getDevice(), device->getQueueFamilies().graphicsFamily, frameCount
+  );
+  if (settings.dynamicResolution)
+    setupDynamicResolution();
+  createRenderTargets();
+  std::cout << "Depth buffer created, MSAA " << msaaSamples << "x" << std::endl;
+
+  // The deferred lighting subpass reads the G-buffer as input attachments, which needs a render pass
+  dynamicRendering = settings.dynamicRendering && device->supportsDynamicRendering() && !settings.deferred;
+  if (dynamicRendering)
+    std::cout << "[6-7/9] Dynamic rendering: attachments are bound at record time" << std::endl;
+  else
+  {
+    std::cout << "[6/9] Creating render pass..." << std::endl;
+    createRenderPass();
+    std::cout << "Render pass created" << std::endl;
 
-  std::cout << "[9/10] Creating shader..." << std::endl;
-  shader = std::make_unique<Shader>(device->getDevice(), "shaders/vert.spv", "shaders/frag.spv");
+    std::cout << "[7/9] Creating framebuffers..." << std::endl;
+    createFramebuffers();
+    std::cout << "Framebuffers created" << std::endl;
+  }
+
+  std::cout << "[8/9] Creating shader..." << std::endl;
+  // Baked into the pipelines: the light loop bound and the PCF kernel fold like literals
+  uint32_t lightLimit = ClusteredLighting::MAX_LIGHTS_PER_CLUSTER;
+  SpecializationConstants lightingConstants;
+  lightingConstants.set(LIGHT_LIMIT_CONSTANT, std::min(settings.lightCount, lightLimit))
+    .set(SHADOW_FILTER_SIZE_CONSTANT, settings.shadowFilterSize);
+  shader = std::make_unique<Shader>(
+    device->getDevice(), "shaders/vert.spv", settings.deferred ? "shaders/gbuffer.spv" : "shaders/frag.spv",
+    lightingConstants
+  );
+  if (settings.deferred)
+    lightingShader = std::make_unique<Shader>(
+      device->getDevice(), "shaders/fullscreen.spv", "shaders/deferred.spv", lightingConstants
+    );
   std::cout << "Shader created" << std::endl;
 
-  std::cout << "[10/10] Creating cube..." << std::endl;
+  std::cout << "[9/9] Creating cube..." << std::endl;
   cube = std::make_unique<Cube>(
-    device->getPhysicalDevice(), device->getDevice(), commandPool, device->getGraphicsQueue()
+    device->getPhysicalDevice(), device->getDevice(), commandPool, *graphicsTimeline
   );
   std::cout << "Cube created" << std::endl;
 
+  createTexture();
+  std::cout << "Texture created" << std::endl;
+
+  // Light binning reads the camera too
+  const uint32_t sharedFamilies[] = {graphicsFamily, computeFamily};
   uniformBuffer = std::make_unique<UniformBuffer>(
-    device->getPhysicalDevice(), device->getDevice(), swapChain->getImages().size()
+    device->getPhysicalDevice(), device->getDevice(), frameCount,
+    std::span<const uint32_t>(sharedFamilies, computeFamily != graphicsFamily ? 2 : 1)
   );
+  // Graphics queue only: the compute queue's binning keeps the camera of the UBO
+  lateLatch = std::make_unique<LateLatch>(device->getPhysicalDevice(), device->getDevice(), frameCount);
+  mipFeedback = std::make_unique<MipFeedback>(device->getPhysicalDevice(), device->getDevice(), frameCount);
   std::cout << "Uniform buffer created" << std::endl;
 
+  // Every shader bound with the scene descriptor set shapes its layout
+  auto sceneReflection = ShaderReflection::fromFiles({
+    "shaders/vert.spv", "shaders/frag.spv", "shaders/gbuffer.spv", "shaders/fullscreen.spv", "shaders/deferred.spv",
+    "shaders/depth.spv", "shaders/cluster.spv", "shaders/cull.spv"
+  });
   descriptor = std::make_unique<Descriptor>(
-    device->getPhysicalDevice(), device->getDevice(), swapChain->getImages().size()
+    device->getPhysicalDevice(), device->getDevice(), frameCount, *layoutCache, sceneReflection
   );
+  // Each frame's set points at its own uniform slice for good
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    descriptor->update(i, *uniformBuffer);
+    descriptor->updateLateLatch(i, *lateLatch);
+    descriptor->updateMipFeedback(i, *mipFeedback);
+    frames->get(i).descriptorSet = descriptor->getDescriptorSet(i);
+  }
   std::cout << "Descriptor created" << std::endl;
 
-  pipeline = std::make_unique<GraphicsPipeline>(
-    device->getDevice(), swapChain->getExtent(), renderPass, *shader, descriptor->getPipelineLayout()
+  lighting = std::make_unique<ClusteredLighting>(
+    device->getPhysicalDevice(), device->getDevice(), frameCount,
+    settings.lightCount, descriptor->getPipelineLayout(), graphicsFamily, computeFamily
+  );
+  for (uint32_t i = 0; i < frameCount; i++)
+    descriptor->updateLighting(i, lighting->getLightBufferInfo(i), lighting->getClusterBufferInfo(i));
+  std::cout << "Lighting created" << std::endl;
+
+  shadowMap = std::make_unique<ShadowMap>(
+    device->getPhysicalDevice(), device->getDevice(), commandPool, *graphicsTimeline, settings.shadowMapSize,
+    *layoutCache
   );
-  std::cout << "Pipeline created" << std::endl;
+  SamplerKey shadowSampler{};
+  shadowSampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  shadowSampler.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  shadowSampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  shadowSampler.anisotropy = false;
+  shadowSampler.compare = true;
+  for (uint32_t i = 0; i < frameCount; i++)
+    descriptor->updateShadowMap(i, shadowMap->getDescriptorInfo(samplerCache->get(shadowSampler)));
+  createScene();
+  std::cout << "Shadow map created" << std::endl;
+
+  // Depth and the Hi-Z pyramid are read with texelFetch, no filtering or comparison
+  SamplerKey hiZSampler{};
+  hiZSampler.filter = VK_FILTER_NEAREST;
+  hiZSampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  hiZSampler.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  hiZSampler.anisotropy = false;
+  occlusion = std::make_unique<OcclusionCulling>(
+    device->getPhysicalDevice(), device->getDevice(), commandPool, *graphicsTimeline,
+    frameCount, *depthBuffer, samplerCache->get(hiZSampler),
+    descriptor->getPipelineLayout(), *layoutCache, cube->getIndexCount(), settings.occlusionCulling
+  );
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    descriptor->updateCulling(
+      i, occlusion->getObjectBufferInfo(i), occlusion->getDrawBufferInfo(), occlusion->getHistoryBufferInfo()
+    );
+    descriptor->updateHiZ(i, occlusion->getPyramidInfo());
+  }
+  std::cout << "Occlusion culling created" << std::endl;
+
+  if (settings.deferred)
+  {
+    for (uint32_t i = 0; i < frameCount; i++)
+      descriptor->updateGBuffer(
+        i, gbufferAlbedo->getImageView(), gbufferNormal->getImageView(), depthBuffer->getImageView()
+      );
+
+    // Subpass 0 fills the G-buffer, subpass 1 lights every pixel once from it
+    pipeline = std::make_unique<GraphicsPipeline>(
+      device->getDevice(), swapChain->getExtent(), PipelineTarget(renderPass, 0, 2), *shader,
+      descriptor->getPipelineLayout()
+    );
+    lightingPipeline = std::make_unique<FullscreenPipeline>(
+      device->getDevice(), PipelineTarget(renderPass, 1), *lightingShader, descriptor->getPipelineLayout()
+    );
+  }
+  else
+  {
+    // With dynamic rendering the pipelines only know the formats, the pre-pass is a depth-only instance
+    const VkFormat depthFormat = depthBuffer->getFormat();
+    PipelineTarget depthTarget = dynamicRendering ? PipelineTarget(depthFormat) : PipelineTarget(renderPass, 0);
+    PipelineTarget colorTarget = dynamicRendering ? PipelineTarget(depthFormat, {getColorFormat()}) :
+      PipelineTarget(renderPass, settings.depthPrepass ? 1 : 0);
 
-  createCommandBuffers();
-  std::cout << "Command buffers created" << std::endl;
+    if (settings.depthPrepass)
+    {
+      // The pre-pass lays down depth, the color pass shades only the visible fragment of each pixel
+      depthPipeline = std::make_unique<DepthPipeline>(
+        device->getDevice(), depthTarget, "shaders/depth.spv", descriptor->getPipelineLayout(), msaaSamples
+      );
+      pipeline = std::make_unique<GraphicsPipeline>(
+        device->getDevice(), swapChain->getExtent(), colorTarget, *shader, descriptor->getPipelineLayout(),
+        VK_COMPARE_OP_EQUAL, false, msaaSamples
+      );
+    }
+    else
+      pipeline = std::make_unique<GraphicsPipeline>(
+        device->getDevice(), swapChain->getExtent(), colorTarget, *shader, descriptor->getPipelineLayout(),
+        VK_COMPARE_OP_LESS, true, msaaSamples
+      );
+  }
+  std::cout << "Pipeline created, " << layoutCache->getSetLayoutCount() << " descriptor set layouts, "
+            << layoutCache->getPipelineLayoutCount() << " pipeline layouts" << std::endl;
 
-  createSyncObjects();
-  std::cout << "Sync objects created" << std::endl;
+  pipelineStatistics = std::make_unique<PipelineStatistics>(
+    device->getDevice(), device->getEnabledFeatures().pipelineStatisticsQuery && settings.pipelineStatistics,
+    frameCount
+  );
 
   std::cout << "=== initVulkan completed ===" << std::endl;
 }
 
-void HertraApp::updateUniformBuffer(uint32_t currentImage)
+FrameSnapshot HertraApp::createSnapshot() const
+{
+  FrameSnapshot snapshot{};
+  snapshot.objects = sceneObjects;
+  snapshot.lights.reserve(lighting->getLightCount());
+  return snapshot;
+}
+
+void HertraApp::simulate(float time, FrameSnapshot& snapshot) const
+{
+  snapshot.time = time;
+  snapshot.objects[spinningCube].model =
+    glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  snapshot.viewPos = glm::vec3(2.0f, 2.0f, 2.0f);
+  snapshot.view = glm::lookAt(snapshot.viewPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  snapshot.fovY = glm::radians(45.0f);
+  snapshot.zNear = 0.1f;
+  snapshot.zFar = 10.0f;
+
+  snapshot.sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+  snapshot.sunColor = glm::vec3(0.6f, 0.58f, 0.52f);
+  lighting->animate(time, snapshot.lights);
+}
+
+glm::mat4 HertraApp::getView(const FrameSnapshot& snapshot) const
+{
+  // Turning the world about the origin moves the camera around it; pitch turns about the camera's right axis
+  const glm::vec3 right(snapshot.view[0][0], snapshot.view[1][0], snapshot.view[2][0]);
+  glm::mat4 orbit = glm::rotate(glm::mat4(1.0f), orbitPitch, right);
+  orbit = glm::rotate(orbit, orbitYaw, glm::vec3(0.0f, 1.0f, 0.0f));
+  return snapshot.view * orbit;
+}
+
+glm::mat4 HertraApp::getProjection(const FrameSnapshot& snapshot) const
 {
-  static auto startTime = std::chrono::high_resolution_clock::now();
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+  const float aspect = swapChain->getExtent().width / (float)swapChain->getExtent().height;
+  glm::mat4 proj = glm::perspective(snapshot.fovY, aspect, snapshot.zNear, snapshot.zFar);
+  proj[1][1] *= -1; // Flip Y for Vulkan
+  return proj;
+}
+
+void HertraApp::latchCamera(uint32_t frame, const FrameSnapshot& snapshot)
+{
+  LatchedCamera camera{};
+  camera.viewProj = getProjection(snapshot) * getView(snapshot);
+  camera.invViewProj = glm::inverse(camera.viewProj);
+  camera.viewPos = glm::inverse(getView(snapshot))[3];
+  lateLatch->write(frame, camera);
+}
 
+void HertraApp::updateUniformBuffer(uint32_t frame, const FrameSnapshot& snapshot)
+{
+  const float aspect = swapChain->getExtent().width / (float)swapChain->getExtent().height;
+
+  // Camera as sampled at the start of the frame: cascades, light binning and the cluster lookup follow it
   UniformBufferObject ubo{};
-  ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-  ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-  ubo.proj = glm::perspective(
-    glm::radians(45.0f), swapChain->getExtent().width / (float)swapChain->getExtent().height, 0.1f, 10.0f
+  ubo.view = getView(snapshot);
+  ubo.zNear = snapshot.zNear;
+  ubo.zFar = snapshot.zFar;
+  ubo.proj = getProjection(snapshot);
+  ubo.invViewProj = glm::inverse(ubo.proj * ubo.view);
+
+  ubo.sunDirection = snapshot.sunDirection;
+  ubo.sunColor = snapshot.sunColor;
+  shadowMap->updateCascades(ubo.view, snapshot.fovY, aspect, ubo.zNear, ubo.zFar, ubo.sunDirection);
+  for (uint32_t i = 0; i < ShadowMap::CASCADE_COUNT; i++)
+    ubo.lightViewProj[i] = shadowMap->getLightViewProj()[i];
+  ubo.cascadeSplits = shadowMap->getCascadeSplits();
+
+  ubo.viewPos = glm::vec3(glm::inverse(ubo.view)[3]);
+  ubo.screenSize = glm::vec2(renderExtent.width, renderExtent.height);
+  ubo.lightCount = lighting->getLightCount();
+
+  occlusion->updateObjects(frame, snapshot.objects);
+  ubo.objectCount = occlusion->getObjectCount();
+
+  lighting->upload(frame, snapshot.lights);
+  uniformBuffer->update(frame, ubo);
+  // The same camera for the scene passes, unless the late latch replaces it
+  lateLatch->write(frame, {ubo.proj * ubo.view, ubo.invViewProj, glm::vec4(ubo.viewPos, 1.0f)});
+
+  // The streamer's sampler follows the residency, so the set may change every frame
+  if (textureStreamer)
+    descriptor->updateTexture(frame, textureStreamer->getDescriptorInfo(cubeTexture));
+  else
+    descriptor->updateTexture(frame, texture->getDescriptorInfo());
+}
+
+void HertraApp::createDepthBuffer()
+{
+  // The deferred lighting subpass reads depth back as an input attachment
+  VkImageUsageFlags extraUsage = settings.deferred ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : 0;
+  depthBuffer = std::make_unique<DepthBuffer>(
+    device->getPhysicalDevice(), device->getDevice(), swapChain->getExtent(), extraUsage
+  );
+}
+
+bool HertraApp::canBlitToSwapChain()
+{
+  // Upscaling and the post output reach the swapchain image with a linear blit
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), swapChain->getImageFormat(), &formatProperties);
+  const VkFormatFeatureFlags blitFeatures =
+    VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  return (swapChain->getImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+    (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+}
+
+void HertraApp::setupDynamicResolution()
+{
+  if (!gpuTimer->isSupported())
+  {
+    std::cout << "Dynamic resolution needs GPU timestamps, keeping the full resolution" << std::endl;
+    return;
+  }
+
+  if (!canBlitToSwapChain())
+  {
+    std::cout << "Swapchain images cannot be blitted to, dynamic resolution is disabled" << std::endl;
+    return;
+  }
+
+  resolutionController = std::make_unique<ResolutionController>(
+    settings.targetFrameTime / 1000.0f, std::clamp(settings.minRenderScale, 10u, 100u) / 100.0f
   );
-  ubo.proj[1][1] *= -1; // Flip Y for Vulkan
+}
+
+void HertraApp::createRenderTargets()
+{
+  // Every target has the full window size; lower render scales use only its top-left corner
+  renderExtent = swapChain->getExtent();
+  if (resolutionController)
+    renderExtent = resolutionController->getExtent(renderExtent);
+
+  if (!postProcess && settings.postProcess)
+  {
+    SamplerKey postSampler{};
+    postSampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    postSampler.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    postSampler.anisotropy = false;
+    postProcess = std::make_unique<PostProcess>(
+      device->getPhysicalDevice(), device->getDevice(), commandPool, *graphicsTimeline,
+      samplerCache->get(postSampler), !isSrgbFormat(swapChain->getImageFormat()), *layoutCache
+    );
+  }
 
-  ubo.lightPos = glm::vec3(2.0f, 2.0f, 2.0f);
-  ubo.viewPos = glm::vec3(2.0f, 2.0f, 2.0f);
-  ubo.lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+  gbufferAlbedo.reset();
+  gbufferNormal.reset();
+  if (settings.deferred)
+  {
+    // Written and read within the render pass, never stored
+    const VkImageUsageFlags gbufferUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    gbufferAlbedo = std::make_unique<RenderTarget>(
+      device->getPhysicalDevice(), device->getDevice(), VK_FORMAT_R8G8B8A8_UNORM, swapChain->getExtent(),
+      VK_SAMPLE_COUNT_1_BIT, gbufferUsage, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+    gbufferNormal = std::make_unique<RenderTarget>(
+      device->getPhysicalDevice(), device->getDevice(), VK_FORMAT_A2B10G10R10_UNORM_PACK32, swapChain->getExtent(),
+      VK_SAMPLE_COUNT_1_BIT, gbufferUsage, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+  }
 
-  uniformBuffer->update(currentImage, ubo);
-  descriptor->update(currentImage, *uniformBuffer);
+  buildFrameGraph();
 }
 
-void HertraApp::createDepthBuffer()
+void HertraApp::buildFrameGraph()
+{
+  const VkExtent2D extent = swapChain->getExtent();
+  const bool offscreen = resolutionController != nullptr || postProcess != nullptr;
+
+  // The old targets go first, the new ones may take their memory
+  frameGraph.reset();
+  frameGraph = std::make_unique<RenderGraph>(device->getPhysicalDevice(), device->getDevice());
+
+  // 1. Imported: the swapchain image is bound once acquired and first written after the acquire semaphore's
+  // wait; the depth buffer is cleared by its first pass, which waits for last frame's depth writes and Hi-Z reads
+  if (swapChain->isOffscreen())
+  {
+    // The offscreen image stands in for it: no acquire or present, last frame's writes and capture copy
+    // are what the first write waits for, and the image stays in its last layout
+    const VkPipelineStageFlags lastStages =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    swapChainTarget = frameGraph->importImage(
+      "offscreen", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+      {
+        VK_IMAGE_LAYOUT_UNDEFINED, lastStages,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+      },
+      {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0}
+    );
+  }
+  else
+    swapChainTarget = frameGraph->importImage(
+      "swapchain", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+      {VK_IMAGE_LAYOUT_UNDEFINED, getAcquireStage(), 0},
+      {VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0}
+    );
+
+  const VkImageAspectFlags depthAspect = getDepthAspect(depthBuffer->getFormat());
+  depthTarget = frameGraph->importImage(
+    "depth", depthBuffer->getImage(), depthBuffer->getImageView(), depthAspect,
+    {
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+    },
+    {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0}
+  );
+
+  // The modules' images are created after the graph and bound every frame. Between frames the shadow map rests
+  // sampled, its static cache as copy source and the Hi-Z pyramid in GENERAL
+  shadowTarget = frameGraph->importImage(
+    "shadow map", VK_NULL_HANDLE, VK_NULL_HANDLE, getDepthAspect(ShadowMap::findFormat(device->getPhysicalDevice())),
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0}
+  );
+  shadowCacheTarget = frameGraph->importImage(
+    "shadow cache", VK_NULL_HANDLE, VK_NULL_HANDLE, getDepthAspect(ShadowMap::findFormat(device->getPhysicalDevice())),
+    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0},
+    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0}
+  );
+  hiZTarget = frameGraph->importImage(
+    "hi-z", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+    {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0},
+    {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0}
+  );
+
+  // Buffers only order the passes, their barriers are global memory barriers. The clusters are the frame's own
+  const GraphResource clusterTarget = frameGraph->importBuffer("clusters", VK_NULL_HANDLE);
+  const GraphResource drawListTarget = frameGraph->importBuffer("draw lists", VK_NULL_HANDLE);
+  const GraphResource historyTarget = frameGraph->importBuffer("visibility history", VK_NULL_HANDLE);
+
+  // 2. Transients at the full window size: the scene color when it does not go straight to the window,
+  // and the multisampled attachments resolved and dropped inside the scene pass
+  sceneTarget = swapChainTarget;
+  if (offscreen)
+  {
+    GraphImageDesc sceneDesc{};
+    sceneDesc.format = getColorFormat();
+    sceneDesc.extent = extent;
+    sceneTarget = frameGraph->createImage(postProcess ? "hdr" : "scene color", sceneDesc);
+  }
+
+  msaaColorTarget = NO_RESOURCE;
+  msaaDepthTarget = NO_RESOURCE;
+  if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+  {
+    GraphImageDesc msaaDesc{};
+    msaaDesc.format = getColorFormat();
+    msaaDesc.extent = extent;
+    msaaDesc.samples = msaaSamples;
+    msaaColorTarget = frameGraph->createImage("msaa color", msaaDesc);
+
+    msaaDesc.format = depthBuffer->getFormat();
+    msaaDesc.aspect = depthAspect;
+    msaaDepthTarget = frameGraph->createImage("msaa depth", msaaDesc);
+  }
+
+  // 3. Passes before the scene. Light binning, unless the compute queue bins and hands the clusters over
+  if (computeTimeline)
+    frameGraph->addPass("cluster acquire", [this](VkCommandBuffer commandBuffer) {
+      lighting->acquireClusters(commandBuffer, recordingFrame->index);
+    }).write(clusterTarget, GraphAccess::StorageCompute);
+  else
+    frameGraph->addPass("cluster bin", [this](VkCommandBuffer commandBuffer) {
+      lighting->recordCulling(
+        commandBuffer, recordingFrame->index, descriptor->getPipelineLayout(), recordingFrame->descriptorSet
+      );
+    }).write(clusterTarget, GraphAccess::StorageCompute);
+
+  // Changed static casters into the cache, the cache into the shadow map, the dynamic casters on top.
+  // The statistics queries span the passes
+  frameGraph->addPass("shadow cache", [this](VkCommandBuffer commandBuffer) {
+    pipelineStatistics->begin(commandBuffer, recordingFrame->index, StatisticsPass::Shadows);
+    shadowMap->recordStatic(commandBuffer, *cube);
+  }).write(shadowCacheTarget, GraphAccess::DepthAttachment);
+  frameGraph->addPass("shadow restore", [this](VkCommandBuffer commandBuffer) {
+    shadowMap->recordRestore(commandBuffer);
+  })
+    .read(shadowCacheTarget, GraphAccess::TransferSrc)
+    .write(shadowTarget, GraphAccess::TransferDst);
+  frameGraph->addPass("shadows", [this](VkCommandBuffer commandBuffer) {
+    shadowMap->recordDynamic(commandBuffer, *cube);
+    pipelineStatistics->end(commandBuffer, recordingFrame->index, StatisticsPass::Shadows);
+  }).write(shadowTarget, GraphAccess::DepthAttachment);
+
+  // Culling into the draw lists: with Hi-Z last frame's visible set is drawn and reduced first
+  frameGraph->addPass("cull reset", [this](VkCommandBuffer commandBuffer) {
+    pipelineStatistics->begin(commandBuffer, recordingFrame->index, StatisticsPass::Occluders);
+    occlusion->recordReset(commandBuffer);
+  })
+    .write(drawListTarget, GraphAccess::TransferDst)
+    .write(historyTarget, GraphAccess::TransferDst);
+
+  if (settings.occlusionCulling)
+  {
+    frameGraph->addPass("occluder list", [this](VkCommandBuffer commandBuffer) {
+      occlusion->recordOccluderList(commandBuffer, descriptor->getPipelineLayout(), recordingFrame->descriptorSet);
+    })
+      .read(historyTarget, GraphAccess::StorageCompute)
+      .write(drawListTarget, GraphAccess::StorageCompute);
+    frameGraph->addPass("occluders", [this](VkCommandBuffer commandBuffer) {
+      occlusion->recordOccluders(
+        commandBuffer, descriptor->getPipelineLayout(), recordingFrame->descriptorSet,
+        cube->getPositionBuffer(), cube->getIndexBuffer(), renderExtent
+      );
+    })
+      .read(drawListTarget, GraphAccess::IndirectRead)
+      .read(drawListTarget, GraphAccess::StorageGraphics)
+      .write(depthTarget, GraphAccess::DepthAttachment);
+    frameGraph->addPass("hi-z", [this](VkCommandBuffer commandBuffer) { occlusion->recordPyramid(commandBuffer); })
+      .read(depthTarget, GraphAccess::SampledCompute)
+      .write(hiZTarget, GraphAccess::StorageCompute);
+  }
+
+  RenderGraph::PassBuilder cull = frameGraph->addPass("cull", [this](VkCommandBuffer commandBuffer) {
+    occlusion->recordCull(commandBuffer, descriptor->getPipelineLayout(), recordingFrame->descriptorSet);
+    pipelineStatistics->end(commandBuffer, recordingFrame->index, StatisticsPass::Occluders);
+  });
+  cull.write(drawListTarget, GraphAccess::StorageCompute).write(historyTarget, GraphAccess::StorageCompute);
+  if (settings.occlusionCulling)
+    cull.read(hiZTarget, GraphAccess::StorageCompute);
+
+  // The list sizes go to a readback slot, the host reads it
+  frameGraph->addPass("cull statistics", [this](VkCommandBuffer commandBuffer) {
+    occlusion->recordStatistics(commandBuffer, recordingFrame->index);
+  }).sideEffect().read(drawListTarget, GraphAccess::TransferSrc);
+
+  // The scene pass also writes pipeline statistics queries, which the host reads
+  RenderGraph::PassBuilder scene = frameGraph->addPass("scene", [this](VkCommandBuffer commandBuffer) {
+    recordScene(commandBuffer);
+  });
+  scene.sideEffect()
+    .write(sceneTarget, GraphAccess::ColorAttachment)
+    .write(msaaDepthTarget != NO_RESOURCE ? msaaDepthTarget : depthTarget, GraphAccess::DepthAttachment)
+    .read(shadowTarget, GraphAccess::SampledFragment)
+    .read(clusterTarget, GraphAccess::StorageGraphics)
+    .read(drawListTarget, GraphAccess::IndirectRead)
+    .read(drawListTarget, GraphAccess::StorageGraphics);
+  if (msaaColorTarget != NO_RESOURCE)
+    scene.write(msaaColorTarget, GraphAccess::ColorAttachment);
+
+  upscaleSource = sceneTarget;
+  if (postProcess)
+    upscaleSource = postProcess->addPasses(*frameGraph, sceneTarget, extent, renderExtent);
+
+  if (offscreen)
+    frameGraph->addPass("upscale", [this](VkCommandBuffer commandBuffer) { recordUpscale(commandBuffer); })
+      .read(upscaleSource, GraphAccess::TransferSrc)
+      .write(swapChainTarget, GraphAccess::TransferDst);
+
+  // Copies the finished image into a readback slot on the frames it picks, the slot is the side effect
+  if (frameCapture)
+  {
+    RenderGraph::PassBuilder capture = frameGraph->addPass("capture", [this](VkCommandBuffer commandBuffer) {
+      frameCapture->record(commandBuffer, frameGraph->getImage(swapChainTarget));
+    });
+    capture.sideEffect().read(swapChainTarget, GraphAccess::TransferSrc);
+  }
+
+  frameGraph->compile(settings.transientAliasing);
+  if (postProcess)
+    postProcess->bind(*frameGraph);
+}
+
+void HertraApp::createTexture()
 {
-  depthBuffer = std::make_unique<DepthBuffer>(device->getPhysicalDevice(),device->getDevice(), swapChain->getExtent());
+  // Block-compressed textures are streamed mip by mip, everything else is loaded whole
+  const std::string texturePath = "textures/cube.ktx2";
+  if (std::filesystem::exists(texturePath))
+  {
+    textureStreamer = std::make_unique<TextureStreamer>(
+      device->getPhysicalDevice(), device->getDevice(), device->getQueueFamilies().graphicsFamily,
+      *graphicsTimeline, *samplerCache, settings.textureBudget
+    );
+    cubeTexture = textureStreamer->add(texturePath, settings.textureInitialSize);
+  }
+  else
+  {
+    std::cout << "No " << texturePath << ", using a white texture" << std::endl;
+    texture = std::make_unique<Texture>(
+      device->getPhysicalDevice(), device->getDevice(), commandPool, *graphicsTimeline,
+      *samplerCache, 0xFFFFFFFF
+    );
+  }
+}
+
+void HertraApp::createScene()
+{
+  // Static ground and posts: their shadows are rendered once and then cached
+  glm::mat4 ground = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.8f, 0.0f));
+  sceneObjects.push_back({glm::scale(ground, glm::vec3(12.0f, 0.1f, 12.0f)), true});
+
+  for (float x : {-1.5f, 1.5f})
+  {
+    glm::mat4 post = glm::translate(glm::mat4(1.0f), glm::vec3(x, -0.25f, -1.5f));
+    sceneObjects.push_back({glm::scale(post, glm::vec3(0.3f, 1.0f, 0.3f)), true});
+  }
+
+  // The spinning cube is the only dynamic caster
+  spinningCube = sceneObjects.size();
+  sceneObjects.push_back({glm::mat4(1.0f), false});
+
+  // City blocks around a clearing: most of them hide behind the first rows
+  const float spacing = 0.7f;
+  const float clearing = 2.1f;
+  const float half = (settings.cityGridSize - 1) * spacing / 2.0f;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> height(0.4f, 2.4f);
+
+  for (uint32_t z = 0; z < settings.cityGridSize; z++)
+    for (uint32_t x = 0; x < settings.cityGridSize; x++)
+    {
+      glm::vec2 position(x * spacing - half, z * spacing - half);
+      if (std::abs(position.x) < clearing && std::abs(position.y) < clearing)
+        continue;
+      if (sceneObjects.size() >= OcclusionCulling::MAX_OBJECTS)
+        break;
+
+      float h = height(random);
+      glm::mat4 block = glm::translate(glm::mat4(1.0f), glm::vec3(position.x, -0.75f + h / 2.0f, position.y));
+      sceneObjects.push_back({glm::scale(block, glm::vec3(0.5f, h, 0.5f)), true});
+    }
+
+  std::cout << "Scene: " << sceneObjects.size() << " objects" << std::endl;
 }
 
 void HertraApp::createInstance()
 {
+  // Surface extensions only with a window, GLFW is not initialized without one
   uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  if (glfwExtensions == nullptr)
-    throw std::runtime_error("Failed to get required GLFW instance extensions");
+  const char** glfwExtensions = nullptr;
+  if (window)
+  {
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (glfwExtensions == nullptr)
+      throw std::runtime_error("Failed to get required GLFW instance extensions");
+  }
 
   VkApplicationInfo appInfo{};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -137,7 +799,15 @@ void HertraApp::createInstance()
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "HertraEngine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // The highest version up to 1.3 the loader offers: 1.3 brings dynamic rendering, 1.1 the extension for it
+  apiVersion = VK_API_VERSION_1_0;
+  auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+    vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion")
+  );
+  if (enumerateInstanceVersion && enumerateInstanceVersion(&apiVersion) != VK_SUCCESS)
+    apiVersion = VK_API_VERSION_1_0;
+  apiVersion = std::min(apiVersion, VK_API_VERSION_1_3);
+  appInfo.apiVersion = apiVersion;
 
   VkInstanceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -151,43 +821,62 @@ void HertraApp::createInstance()
   if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS)
     throw std::runtime_error("Failed to create Vulkan instance!");
 
-  std::cout << "Vulkan instance created successfully!" << std::endl;
+  std::cout << "Vulkan instance created successfully, API " << VK_API_VERSION_MAJOR(apiVersion) << "."
+            << VK_API_VERSION_MINOR(apiVersion) << std::endl;
 }
 
 void HertraApp::createSurface()
 {
+  // Headless: the device is created without one
+  if (!window)
+    return;
+
   if (glfwCreateWindowSurface(instance, window->getWindow(), nullptr, &surface) != VK_SUCCESS)
     throw std::runtime_error("Failed to create window surface!");
 }
 
 void HertraApp::createRenderPass()
 {
-  // Color attachment
+  const bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+  // Color attachment, the resolve target with MSAA; the HDR target the post chain reads,
+  // or without it the scene target that is blitted with dynamic resolution.
+  // The frame graph moves the attachments it owns into their layouts before the pass and out of them after
   VkAttachmentDescription colorAttachment{};
-  colorAttachment.format = swapChain->getImageFormat();
+  colorAttachment.format = getColorFormat();
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
   // Depth attachment
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = depthBuffer->getFormat();
-  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.samples = msaaSamples;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
   depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+  // Multisampled color, resolved into attachment 0 at the end of the subpass
+  VkAttachmentDescription msaaColorAttachment = colorAttachment;
+  msaaColorAttachment.samples = msaaSamples;
+  msaaColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  msaaColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
   VkAttachmentReference colorAttachmentRef{};
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+  VkAttachmentReference msaaColorAttachmentRef{};
+  msaaColorAttachmentRef.attachment = 2;
+  msaaColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
   VkAttachmentReference depthAttachmentRef{};
   depthAttachmentRef.attachment = 1;
   depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -195,26 +884,117 @@ void HertraApp::createRenderPass()
   VkSubpassDescription subpass{};
   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pColorAttachments = multisampled ? &msaaColorAttachmentRef : &colorAttachmentRef;
+  subpass.pResolveAttachments = multisampled ? &colorAttachmentRef : nullptr;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  // Optional depth pre-pass: a depth-only subpass in front of the color subpass
+  VkSubpassDescription prepass{};
+  prepass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  prepass.colorAttachmentCount = 0;
+  prepass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  // Deferred: G-buffer attachments 2 and 3 are cleared, filled in subpass 0, read in subpass 1 and dropped
+  VkAttachmentDescription albedoAttachment = colorAttachment;
+  albedoAttachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+  albedoAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  albedoAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentDescription normalAttachment = albedoAttachment;
+  normalAttachment.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+
+  std::array<VkAttachmentReference, 2> gbufferRefs{};
+  gbufferRefs[0] = {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  gbufferRefs[1] = {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription gbufferPass{};
+  gbufferPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  gbufferPass.colorAttachmentCount = static_cast<uint32_t>(gbufferRefs.size());
+  gbufferPass.pColorAttachments = gbufferRefs.data();
+  gbufferPass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  // Input attachment indices match deferred.glsl
+  std::array<VkAttachmentReference, 3> inputRefs{};
+  inputRefs[0] = {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[1] = {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[2] = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+  VkSubpassDescription lightingPass{};
+  lightingPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  lightingPass.colorAttachmentCount = 1;
+  lightingPass.pColorAttachments = &colorAttachmentRef;
+  lightingPass.inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+  lightingPass.pInputAttachments = inputRefs.data();
+
+  std::vector<VkSubpassDescription> subpasses;
+  if (settings.deferred)
+    subpasses = {gbufferPass, lightingPass};
+  else
+  {
+    if (settings.depthPrepass)
+      subpasses.push_back(prepass);
+    subpasses.push_back(subpass);
+  }
+
+  std::vector<VkSubpassDependency> dependencies(1);
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  // Last frame's lighting subpass reads the G-buffer before this pass clears it; the G-buffer is the one
+  // set of attachments outside the frame graph
+  dependencies[0].srcStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstStageMask =
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  if (settings.depthPrepass)
+  {
+    // Pre-pass depth writes before the color subpass tests against them, per pixel
+    VkSubpassDependency depthDependency{};
+    depthDependency.srcSubpass = 0;
+    depthDependency.dstSubpass = 1;
+    depthDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    depthDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(depthDependency);
+  }
 
-  VkSubpassDependency dependency{};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  if (settings.deferred)
+  {
+    // Each lighting invocation reads only its own pixel of the G-buffer, so the tiles can stay on chip
+    VkSubpassDependency gbufferDependency{};
+    gbufferDependency.srcSubpass = 0;
+    gbufferDependency.dstSubpass = 1;
+    gbufferDependency.srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    gbufferDependency.srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    gbufferDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    gbufferDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    gbufferDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(gbufferDependency);
+  }
 
-  std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+  std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment};
+  if (multisampled)
+    attachments.push_back(msaaColorAttachment);
+  if (settings.deferred)
+    attachments.insert(attachments.end(), {albedoAttachment, normalAttachment});
 
   VkRenderPassCreateInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
   renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
   renderPassInfo.pAttachments = attachments.data();
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
 
   if (vkCreateRenderPass(device->getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
     throw std::runtime_error("Failed to create render pass!");
@@ -239,11 +1019,14 @@ void HertraApp::createFramebuffers()
 
   for (size_t i = 0; i < swapChain->getImageViews().size(); i++)
   {
-    std::array<VkImageView, 2> attachments =
-    {
-      swapChain->getImageViews()[i],
-      depthBuffer->getImageView()
-    };
+    VkImageView colorView = getSceneColorView(static_cast<uint32_t>(i));
+    std::vector<VkImageView> attachments = {colorView, depthBuffer->getImageView()};
+    if (msaaColorTarget != NO_RESOURCE)
+      attachments = {
+        colorView, frameGraph->getImageView(msaaDepthTarget), frameGraph->getImageView(msaaColorTarget)
+      };
+    if (gbufferAlbedo)
+      attachments.insert(attachments.end(), {gbufferAlbedo->getImageView(), gbufferNormal->getImageView()});
 
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -261,107 +1044,297 @@ void HertraApp::createFramebuffers()
   std::cout << "Created " << swapChainFramebuffers.size() << " framebuffers" << std::endl;
 }
 
-void HertraApp::createCommandBuffers()
+void HertraApp::recreateSwapChain()
 {
-  commandBuffers.resize(swapChainFramebuffers.size());
+  swapChain->recreate();
+  // Present ids count per swapchain
+  presentId = 0;
+  latencyTracker->discardPending();
+  // The device is idle, every copy in flight is complete
+  if (frameCapture)
+    frameCapture->resize(*graphicsTimeline, swapChain->getExtent());
 
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+  for (auto framebuffer : swapChainFramebuffers)
+    vkDestroyFramebuffer(device->getDevice(), framebuffer, nullptr);
 
-  if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-    throw std::runtime_error("Failed to allocate command buffers!");
+  createDepthBuffer();
+  createRenderTargets();
+  if (!dynamicRendering)
+    createFramebuffers();
 
-  for (size_t i = 0; i < commandBuffers.size(); i++)
+  // The occluder pass renders into the depth buffer and the pyramid follows its size
+  occlusion->resize(commandPool, *graphicsTimeline, *depthBuffer);
+  for (uint32_t i = 0; i < frames->getDepth(); i++)
   {
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    descriptor->updateHiZ(i, occlusion->getPyramidInfo());
+    if (gbufferAlbedo)
+      descriptor->updateGBuffer(
+        i, gbufferAlbedo->getImageView(), gbufferNormal->getImageView(), depthBuffer->getImageView()
+      );
+  }
+}
+
+void HertraApp::recordCommandBuffer(const FrameContext& frame, uint32_t imageIndex, const FrameSnapshot& snapshot)
+{
+  VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw std::runtime_error("Failed to begin recording command buffer!");
+
+  gpuTimer->begin(commandBuffer, frame.index);
+  pipelineStatistics->reset(commandBuffer, frame.index);
+  // Which shadow cascades are redrawn, picked before the graph records them
+  shadowMap->prepare(snapshot.objects, staticSceneVersion, frame.arena->get());
+
+  // Light binning to presentation, with the barriers the graph worked out when it was compiled
+  recordingFrame = &frame;
+  recordingImage = imageIndex;
+  frameGraph->setImage(swapChainTarget, swapChain->getImages()[imageIndex], swapChain->getImageViews()[imageIndex]);
+  frameGraph->setImage(shadowTarget, shadowMap->getImage(), VK_NULL_HANDLE);
+  frameGraph->setImage(shadowCacheTarget, shadowMap->getCacheImage(), VK_NULL_HANDLE);
+  frameGraph->setImage(hiZTarget, occlusion->getPyramid(), VK_NULL_HANDLE);
+  frameGraph->execute(commandBuffer);
+  mipFeedback->record(commandBuffer);
+  gpuTimer->end(commandBuffer, frame.index);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to record command buffer!");
+}
 
-    if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
-      throw std::runtime_error("Failed to begin recording command buffer!");
+uint64_t HertraApp::submitCompute(const FrameContext& frame)
+{
+  VkCommandBuffer commandBuffer = frame.computeCommandBuffer;
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapChainFramebuffers[i];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChain->getExtent();
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {{0.05f, 0.05f, 0.05f, 1.0f}};
-    clearValues[1].depthStencil = {1.0f, 0};
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw std::runtime_error("Failed to begin recording compute command buffer!");
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+  lighting->recordCulling(commandBuffer, frame.index, descriptor->getPipelineLayout(), frame.descriptorSet);
 
-    vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to record compute command buffer!");
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapChain->getExtent().width);
-    viewport.height = static_cast<float>(swapChain->getExtent().height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
+  // Only reads what the host wrote for this frame, so it waits for nothing
+  return computeTimeline->submit({&commandBuffer, 1});
+}
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapChain->getExtent();
-    vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
+void HertraApp::recordScene(VkCommandBuffer commandBuffer)
+{
+  const FrameContext& frame = *recordingFrame;
+
+  // Every subpass's draws in one sorted queue. The pre-pass and the color pass draw the visible set with one
+  // indirect instanced draw, the deferred lighting is a fullscreen triangle
+  const DrawMesh positions{cube->getPositionBuffer(), cube->getIndexBuffer(), cube->getIndexCount()};
+  const DrawMesh vertices{cube->getVertexBuffer(), cube->getIndexBuffer(), cube->getIndexCount()};
+  const DrawMesh fullscreen{VK_NULL_HANDLE, VK_NULL_HANDLE, 3};
+  const uint32_t drawList = OcclusionCulling::VISIBLE_LIST;
+  const DrawConstants visibleList = DrawConstants::of(drawList);
+  const DrawIndirect visible = occlusion->getVisibleDraw();
+
+  DrawQueue queue(frame.arena->get(), 3);
+  if (depthPipeline)
+    queue.push({
+      sceneKey(StatisticsPass::DepthPrepass, PIPELINE_KEY_DEPTH, cubeTexture, MESH_KEY_POSITIONS),
+      depthPipeline->getPipeline(), frame.descriptorSet, &positions, visibleList, visible
+    });
+  queue.push({
+    sceneKey(StatisticsPass::Color, PIPELINE_KEY_COLOR, cubeTexture, MESH_KEY_VERTICES),
+    pipeline->getPipeline(), frame.descriptorSet, &vertices, visibleList, visible
+  });
+  if (lightingPipeline)
+    queue.push({
+      sceneKey(StatisticsPass::Lighting, PIPELINE_KEY_LIGHTING, 0, MESH_KEY_FULLSCREEN),
+      lightingPipeline->getPipeline(), frame.descriptorSet, &fullscreen, {}
+    });
+  queue.sort();
+
+  beginScenePass(commandBuffer);
+
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(renderExtent.width);
+  viewport.height = static_cast<float>(renderExtent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = renderExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // Queries may not cross subpasses: each pass of the queue is counted apart
+  auto recordPass = [&](StatisticsPass pass) {
+    pipelineStatistics->begin(commandBuffer, frame.index, pass);
+    queue.record(
+      commandBuffer, descriptor->getPipelineLayout(), SCENE_CONSTANT_STAGES, static_cast<uint32_t>(pass),
+      sceneDrawStats
+    );
+    pipelineStatistics->end(commandBuffer, frame.index, pass);
+  };
 
-    VkBuffer vertexBuffers[] = {cube->getVertexBuffer()};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+  if (depthPipeline)
+  {
+    recordPass(StatisticsPass::DepthPrepass);
+    nextScenePass(commandBuffer);
+  }
 
-    vkCmdBindIndexBuffer(commandBuffers[i], cube->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+  recordPass(StatisticsPass::Color);
 
-    VkDescriptorSet descriptorSet = descriptor->getDescriptorSet(i);
-    vkCmdBindDescriptorSets(
-      commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-      descriptor->getPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr
-    );
+  // Lighting runs once per covered pixel, whatever the overdraw was
+  if (lightingPipeline)
+  {
+    nextScenePass(commandBuffer);
+    recordPass(StatisticsPass::Lighting);
+  }
 
-    vkCmdDrawIndexed(commandBuffers[i], cube->getIndexCount(), 1, 0, 0, 0);
-    vkCmdEndRenderPass(commandBuffers[i]);
+  endScenePass(commandBuffer);
+}
 
-    if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-      throw std::runtime_error("Failed to record command buffer!");
+void HertraApp::beginScenePass(VkCommandBuffer commandBuffer)
+{
+  if (dynamicRendering)
+  {
+    // The pre-pass is its own depth-only instance, the color pass loads what it stored
+    beginSceneRendering(commandBuffer, depthPipeline != nullptr, false);
+    return;
   }
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = renderPass;
+  renderPassInfo.framebuffer = swapChainFramebuffers[recordingImage];
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = renderExtent;
+
+  // Attachment 2 is the multisampled color or the G-buffer albedo, 3 the G-buffer normal
+  std::array<VkClearValue, 4> clearValues{};
+  clearValues[0].color = CLEAR_COLOR;
+  clearValues[1].depthStencil = {1.0f, 0};
+  clearValues[2].color = clearValues[0].color;
+  clearValues[3].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 }
 
-void HertraApp::createSyncObjects()
+void HertraApp::nextScenePass(VkCommandBuffer commandBuffer)
 {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  if (!dynamicRendering)
+  {
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    return;
+  }
+
+  // Only the depth pre-pass gets here: its depth writes before the color pass tests against them
+  device->endRendering(commandBuffer);
 
-  VkSemaphoreCreateInfo semaphoreInfo{};
-  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+    VK_DEPENDENCY_BY_REGION_BIT, 1, &barrier, 0, nullptr, 0, nullptr
+  );
+
+  beginSceneRendering(commandBuffer, false, true);
+}
 
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+void HertraApp::endScenePass(VkCommandBuffer commandBuffer)
+{
+  // The graph hands the scene color on to the post chain, the upscaling blit or the presentation engine
+  if (dynamicRendering)
+    device->endRendering(commandBuffer);
+  else
+    vkCmdEndRenderPass(commandBuffer);
+}
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+void HertraApp::beginSceneRendering(VkCommandBuffer commandBuffer, bool depthOnly, bool loadDepth)
+{
+  // Same attachments as the render pass: MSAA color resolves into the scene color at the end of the instance
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.clearValue.color = CLEAR_COLOR;
+  colorAttachment.imageView = frameGraph->getImageView(sceneTarget);
+  if (msaaColorTarget != NO_RESOURCE)
   {
-    if (
-      vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-      vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-      vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS
-    ) {
-      throw std::runtime_error("Failed to create synchronization objects!");
-    }
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+    colorAttachment.resolveImageView = colorAttachment.imageView;
+    colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.imageView = frameGraph->getImageView(msaaColorTarget);
   }
+
+  // Stored only for the color pass after a depth pre-pass
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView =
+    frameGraph->getImageView(msaaDepthTarget != NO_RESOURCE ? msaaDepthTarget : depthTarget);
+  depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = loadDepth ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = depthOnly ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = renderExtent;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = depthOnly ? 0 : 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  device->beginRendering(commandBuffer, renderingInfo);
+}
+
+VkImageView HertraApp::getSceneColorView(uint32_t imageIndex) const
+{
+  if (sceneTarget == swapChainTarget)
+    return swapChain->getImageViews()[imageIndex];
+  return frameGraph->getImageView(sceneTarget);
+}
+
+void HertraApp::recordUpscale(VkCommandBuffer commandBuffer)
+{
+  // The rendered corner of the post output or scene target, stretched over the whole window
+  VkImageBlit blit{};
+  blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  blit.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1};
+  blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  blit.dstOffsets[1] = {
+    static_cast<int32_t>(swapChain->getExtent().width), static_cast<int32_t>(swapChain->getExtent().height), 1
+  };
+
+  vkCmdBlitImage(
+    commandBuffer,
+    frameGraph->getImage(upscaleSource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    frameGraph->getImage(swapChainTarget), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    1, &blit, VK_FILTER_LINEAR
+  );
 }
 
 void HertraApp::cleanup()
 {
   std::cout << "=== Starting cleanup ===" << std::endl;
 
+  // Its steps read the lighting, stop it before anything is destroyed
+  simulation.reset();
+
   if (device && device->getDevice() != VK_NULL_HANDLE)
   {
     std::cout << "Waiting for device idle..." << std::endl;
@@ -369,62 +1342,61 @@ void HertraApp::cleanup()
   }
 
   // 1. Pipeline (использует shader + pipeline layout)
-  std::cout << "[1/13] Destroying pipeline..." << std::endl;
+  std::cout << "[1/14] Destroying pipeline..." << std::endl;
+  depthPipeline.reset();
+  lightingPipeline.reset();
   pipeline.reset();
+  pipelineStatistics.reset();
+  gpuTimer.reset();
 
   // 2. Shader (нужен device)
-  std::cout << "[2/13] Destroying shader..." << std::endl;
+  std::cout << "[2/14] Destroying shader..." << std::endl;
+  lightingShader.reset();
   shader.reset();
 
-  // 3. Descriptor (содержит pipeline layout, нужен device)
-  std::cout << "[3/13] Destroying descriptor..." << std::endl;
+  // 3. Lighting, shadows and descriptor (содержит pipeline layout, нужен device)
+  std::cout << "[3/14] Destroying descriptor..." << std::endl;
+  postProcess.reset();
+  occlusion.reset();
+  shadowMap.reset();
+  lighting.reset();
   descriptor.reset();
+  layoutCache.reset();
 
   // 4. Cube (vertex/index buffers, нужен device)
-  std::cout << "[4/13] Destroying cube..." << std::endl;
+  std::cout << "[4/14] Destroying cube..." << std::endl;
   cube.reset();
 
-  // 5. Uniform buffer (нужен device)
-  std::cout << "[5/13] Destroying uniform buffer..." << std::endl;
+  // 5. Texture and samplers (нужен device)
+  std::cout << "[5/14] Destroying texture..." << std::endl;
+  textureStreamer.reset();
+  texture.reset();
+  std::cout << "[6/14] Destroying samplers..." << std::endl;
+  samplerCache.reset();
+
+  // 6. Uniform buffer (нужен device)
+  std::cout << "[7/14] Destroying uniform buffer..." << std::endl;
   uniformBuffer.reset();
+  lateLatch.reset();
+  mipFeedback.reset();
 
-  std::cout << "[6/13] Destroying uniform buffer..." << std::endl;
+  std::cout << "[8/14] Destroying depth buffer..." << std::endl;
+  frameCapture.reset();
+  frameGraph.reset();
   depthBuffer.reset();
+  gbufferAlbedo.reset();
+  gbufferNormal.reset();
 
-  // 6. SwapChain (нужен device)
-  std::cout << "[7/13] Destroying swapchain..." << std::endl;
+  // 7. SwapChain (нужен device)
+  std::cout << "[9/14] Destroying swapchain..." << std::endl;
   swapChain.reset();
 
-  // 7. Command buffers
-  std::cout << "[8/13] Clearing command buffers..." << std::endl;
-  commandBuffers.clear();
-
-  // 8. Sync objects
-  std::cout << "[9/13] Destroying sync objects..." << std::endl;
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-  {
-    if (device && device->getDevice() != VK_NULL_HANDLE)
-    {
-      if (renderFinishedSemaphores[i] != VK_NULL_HANDLE)
-      {
-        vkDestroySemaphore(device->getDevice(), renderFinishedSemaphores[i], nullptr);
-        renderFinishedSemaphores[i] = VK_NULL_HANDLE;
-      }
-      if (imageAvailableSemaphores[i] != VK_NULL_HANDLE)
-      {
-        vkDestroySemaphore(device->getDevice(), imageAvailableSemaphores[i], nullptr);
-        imageAvailableSemaphores[i] = VK_NULL_HANDLE;
-      }
-      if (inFlightFences[i] != VK_NULL_HANDLE)
-      {
-        vkDestroyFence(device->getDevice(), inFlightFences[i], nullptr);
-        inFlightFences[i] = VK_NULL_HANDLE;
-      }
-    }
-  }
+  // 8. Frame contexts: command pools, fences and semaphores
+  std::cout << "[10/14] Destroying frame contexts..." << std::endl;
+  frames.reset();
 
   // 9. Command pool
-  std::cout << "[10/13] Destroying command pool..." << std::endl;
+  std::cout << "[11/14] Destroying command pool..." << std::endl;
   if (device && device->getDevice() != VK_NULL_HANDLE && commandPool != VK_NULL_HANDLE)
   {
     vkDestroyCommandPool(device->getDevice(), commandPool, nullptr);
@@ -432,7 +1404,7 @@ void HertraApp::cleanup()
   }
 
   // 10. Framebuffers
-  std::cout << "[11/13] Destroying framebuffers..." << std::endl;
+  std::cout << "[12/14] Destroying framebuffers..." << std::endl;
   if (device && device->getDevice() != VK_NULL_HANDLE)
   {
     for (auto& framebuffer : swapChainFramebuffers)
@@ -445,7 +1417,7 @@ void HertraApp::cleanup()
   }
 
   // 11. Render pass
-  std::cout << "[12/13] Destroying render pass..." << std::endl;
+  std::cout << "[13/14] Destroying render pass..." << std::endl;
   if (device && device->getDevice() != VK_NULL_HANDLE && renderPass != VK_NULL_HANDLE)
   {
     vkDestroyRenderPass(device->getDevice(), renderPass, nullptr);
@@ -453,7 +1425,9 @@ void HertraApp::cleanup()
   }
 
   // 12. Device
-  std::cout << "[13/13] Destroying device..." << std::endl;
+  std::cout << "[14/14] Destroying device..." << std::endl;
+  computeTimeline.reset();
+  graphicsTimeline.reset();
   device.reset();
 
   // Surface
@@ -475,83 +1449,217 @@ void HertraApp::cleanup()
   std::cout << "=== Cleanup completed ===" << std::endl;
 }
 
+void HertraApp::sampleInput()
+{
+  double x, y;
+  inputDevice->getMousePosition(x, y);
+  const bool pressed = inputDevice->isMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT);
+  if (dragging && pressed && (x != cursorX || y != cursorY))
+  {
+    orbitYaw += static_cast<float>(x - cursorX) * ORBIT_SPEED;
+    orbitPitch = std::clamp(
+      orbitPitch + static_cast<float>(y - cursorY) * ORBIT_SPEED, -MAX_ORBIT_PITCH, MAX_ORBIT_PITCH
+    );
+    if (!inputPending)
+    {
+      inputPending = true;
+      inputTime = LatencyTracker::Clock::now();
+    }
+  }
+  dragging = pressed;
+  cursorX = x;
+  cursorY = y;
+}
+
 void HertraApp::processInput()
 {
+  sampleInput();
+
   if (inputDevice->isKeyPressed(GLFW_KEY_ESCAPE))
     running = false;
+
+  // F1-F4 pick the present mode, the swapchain is recreated with it right away
+  static const std::pair<int, VkPresentModeKHR> PRESENT_KEYS[] =
+  {
+    {GLFW_KEY_F1, VK_PRESENT_MODE_FIFO_KHR},
+    {GLFW_KEY_F2, VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+    {GLFW_KEY_F3, VK_PRESENT_MODE_MAILBOX_KHR},
+    {GLFW_KEY_F4, VK_PRESENT_MODE_IMMEDIATE_KHR}
+  };
+  for (const auto& [key, mode] : PRESENT_KEYS)
+    if (inputDevice->isKeyPressed(key) && swapChain->getRequestedPresentMode() != mode)
+    {
+      swapChain->setPresentMode(mode);
+      recreateSwapChain();
+    }
 }
 
-void HertraApp::drawFrame()
+void HertraApp::paceFrame()
 {
-  vkWaitForFences(device->getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-  uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(device->getDevice(), swapChain->getSwapChain(),
-    UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+  // Waiting for the present before last keeps one frame queued for the display and samples input
+  // right after a flip
+  if (
+    settings.presentWait && presentId > 1 &&
+    device->waitForPresent(swapChain->getSwapChain(), presentId - 1, PRESENT_WAIT_TIMEOUT) == VK_SUCCESS
+  )
+    latencyTracker->complete(presentId - 1);
+  frameLimiter->wait();
+}
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR)
+void HertraApp::drawFrame()
+{
+  // Everything indexed by frame.index was last used by the submission its fence guarded
+  FrameContext& frame = frames->begin();
+  // Without present ids the latency ends when the GPU finished the frame, at the ring's wait for this
+  // context's last submission rather than whenever a later frame polls the timeline
+  if (!settings.presentWait)
+    latencyTracker->complete(frame.submitValue, frame.completeTime);
+  if (frameCapture)
+    frameCapture->collect(*graphicsTimeline);
+  pipelineStatistics->collect(frame.index);
+  occlusion->collect(frame.index);
+
+  // The render targets are full size, a new scale only changes the rendered area
+  if (
+    gpuTimer->collect(frame.index) && resolutionController &&
+    resolutionController->update(static_cast<float>(gpuTimer->getLastMilliseconds()))
+  )
+    renderExtent = resolutionController->getExtent(swapChain->getExtent());
+
+  // Demand comes from the mips this frame's previous use actually sampled
+  uint32_t sampledLevel = mipFeedback->collect(frame.index);
+  if (textureStreamer)
   {
-    swapChain->recreate();
-    createFramebuffers();
-    createCommandBuffers();
-    return;
-  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-    throw std::runtime_error("Failed to acquire swap chain image!");
+    textureStreamer->reportSampledLevel(cubeTexture, sampledLevel);
+    textureStreamer->update();
+  }
 
-  updateUniformBuffer(imageIndex);
-  vkResetFences(device->getDevice(), 1, &inFlightFences[currentFrame]);
+  // Offscreen there is one image and nothing to acquire
+  uint32_t imageIndex = 0;
+  const bool presenting = !swapChain->isOffscreen();
+  if (presenting)
+  {
+    VkResult result = vkAcquireNextImageKHR(device->getDevice(), swapChain->getSwapChain(),
+      UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
 
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+      recreateSwapChain();
+      return;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+      throw std::runtime_error("Failed to acquire swap chain image!");
+  }
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+  // The newest simulation state; the simulation thread may be several steps ahead of the last frame
+  const FrameSnapshot* snapshot = &inlineSnapshot;
+  if (simulation)
+    snapshot = &simulation->acquire();
+  else
+    simulate(static_cast<float>(timer->getElapsedSeconds()), inlineSnapshot);
+
+  updateUniformBuffer(frame.index, *snapshot);
+  if (frameCapture)
+    frameCapture->beginFrame();
+  // Submitted first: the GPU bins the lights while the graphics commands are still being recorded
+  TimelineWait binned{computeTimeline.get(), 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+  if (computeTimeline)
+    binned.value = submitCompute(frame);
+  recordCommandBuffer(frame, imageIndex, *snapshot);
+
+  // Presentation only takes binary semaphores, the timeline value is what the ring waits for
+  SemaphoreWait acquired{
+    frame.imageAvailable,
+    // With post processing or dynamic resolution the swapchain image is only written by the blit
+    getAcquireStage()
+  };
+  // Late latch: input that arrived while the frame was recorded still makes it into the scene passes
+  if (settings.lateLatch)
+  {
+    if (window)
+    {
+      window->pollEvents();
+      sampleInput();
+    }
+    latchCamera(frame.index, *snapshot);
+  }
 
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  // Waiting for the binning also makes the ring's graphics value cover the compute submission
+  const uint32_t binarySemaphores = presenting ? 1u : 0u;
+  uint64_t submitValue = graphicsTimeline->submit(
+    {&frame.commandBuffer, 1}, {&acquired, binarySemaphores}, {&binned, computeTimeline ? 1u : 0u},
+    {&frame.renderFinished, binarySemaphores}
+  );
+  if (frameCapture)
+    frameCapture->endFrame(submitValue);
 
-  if (vkQueueSubmit(device->getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-    throw std::runtime_error("Failed to submit draw command buffer!");
+  if (!presenting)
+  {
+    frames->end(submitValue);
+    return;
+  }
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
+  presentInfo.pWaitSemaphores = &frame.renderFinished;
+
+  // Numbered presents are what paceFrame waits for
+  const uint64_t nextPresentId = presentId + 1;
+  VkPresentIdKHR presentIdInfo{};
+  presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  presentIdInfo.swapchainCount = 1;
+  presentIdInfo.pPresentIds = &nextPresentId;
+  if (settings.presentWait)
+  {
+    presentInfo.pNext = &presentIdInfo;
+    presentId = nextPresentId;
+  }
+  if (inputPending)
+  {
+    latencyTracker->submit(settings.presentWait ? presentId : submitValue, inputTime);
+    inputPending = false;
+  }
 
   VkSwapchainKHR swapChains[] = {swapChain->getSwapChain()};
   presentInfo.swapchainCount = 1;
   presentInfo.pSwapchains = swapChains;
   presentInfo.pImageIndices = &imageIndex;
 
-  result = vkQueuePresentKHR(device->getPresentQueue(), &presentInfo);
+  VkResult result = vkQueuePresentKHR(device->getPresentQueue(), &presentInfo);
+  frames->end(submitValue);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
-  {
-    swapChain->recreate();
-    createFramebuffers();
-    createCommandBuffers();
-  }
+    recreateSwapChain();
   else if (result != VK_SUCCESS)
     throw std::runtime_error("Failed to present swap chain image!");
-
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 void HertraApp::run()
 {
   std::cout << "Starting main loop..." << std::endl;
-  std::cout << "Press ESC to exit" << std::endl;
+  if (window)
+    std::cout << "Press ESC to exit" << std::endl;
+
+  // Window events and input stay on this thread, GLFW requires it
+  if (settings.simulationThread)
+    simulation = std::make_unique<Simulation>(
+      createSnapshot(), settings.simulationRate, [this](float time, FrameSnapshot& snapshot) {
+        simulate(time, snapshot);
+      }
+    );
+  else
+    inlineSnapshot = createSnapshot();
 
-  while (!window->shouldClose() && running)
+  // Headless runs end after their frames instead of with the window
+  uint32_t headlessFramesLeft = settings.headlessFrames;
+  while (running && (window ? !window->shouldClose() : headlessFramesLeft-- > 0))
   {
-    window->pollEvents();
-    processInput();
+    paceFrame();
+    if (window)
+    {
+      window->pollEvents();
+      processInput();
+    }
     drawFrame();
 
     // Print FPS every second
@@ -562,13 +1670,102 @@ void HertraApp::run()
 
     if (currentTime - lastTime >= 1.0)
     {
-      std::cout << "FPS: " << frameCount << std::endl;
+      std::cout << "FPS: " << frameCount
+                << " | shadow cascades re-rendered: " << shadowMap->takeStaticRenderCount();
+      if (simulation)
+        std::cout << " | simulation steps: " << simulation->takeStepCount();
+      std::cout << std::endl;
+
+      // Throughput above, what it costs in latency here: a deeper ring waits less on fences but lags more
+      double fenceWait, latency;
+      frames->takeTimings(fenceWait, latency);
+      std::cout << "Frames in flight: " << frames->getDepth() << " | fence wait " << fenceWait
+                << " ms | frame latency " << latency << " ms" << std::endl;
+      // Interval between frame starts: its spread is the stutter a steady frame rate hides
+      double interval, jitter, longest;
+      frameLimiter->takeIntervals(interval, jitter, longest);
+      std::cout << "Frame pacing: "
+                << (swapChain->isOffscreen() ? "offscreen" : presentModeName(swapChain->getPresentMode()));
+      if (frameLimiter->getLimit() > 0)
+        std::cout << ", limit " << frameLimiter->getLimit() << " fps";
+      if (settings.presentWait)
+        std::cout << ", present wait";
+      std::cout << " | interval " << interval << " ms, jitter " << jitter << " ms, longest " << longest << " ms"
+                << std::endl;
+      // Input to display, from the first sample of a mouse drag to the frame that showed it
+      double p50, p90, p99;
+      if (size_t inputFrames = latencyTracker->takePercentiles(p50, p90, p99))
+        std::cout << "Input latency " << (settings.presentWait ? "to present" : "to GPU completion") << " (late latch "
+                  << (settings.lateLatch ? "on" : "off") << "): p50 " << p50 << " ms, p90 " << p90 << " ms, p99 "
+                  << p99 << " ms over " << inputFrames << " frames" << std::endl;
+      if (frameCapture)
+      {
+        uint64_t captured, dropped;
+        frameCapture->takeCounts(captured, dropped);
+        std::cout << "Capture: " << captured << " frames written, " << dropped << " dropped" << std::endl;
+      }
+      // Only what the arenas took from the heap, not every allocation of the frame loop
+      std::cout << "Frame arena: " << frames->getArenaHighWater() / 1024 << " KB peak, "
+                << frames->takeArenaHeapAllocations() << " arena heap allocations"
+                << (settings.arenaPoison ? ", poisoned on reset" : "") << std::endl;
+
+      // Draws go through sorted draw queues, the skipped binds are what they saved
+      auto logDraws = [](const char* name, const DrawStats& draws) {
+        std::cout << name << ": " << draws.draws / frameCount << " per frame, "
+                  << draws.pipelineBinds / frameCount << " pipeline, " << draws.descriptorBinds / frameCount
+                  << " descriptor and " << draws.meshBinds / frameCount << " mesh binds, "
+                  << draws.skippedBinds / frameCount << " redundant binds skipped" << std::endl;
+      };
+      logDraws("Shadow draws", shadowMap->takeDrawStats());
+      logDraws("Scene draws", sceneDrawStats);
+      sceneDrawStats = {};
+      if (postProcess)
+        logDraws("Post dispatches", postProcess->takeDrawStats());
+
+      // Work per pass and frame: culling shows in the input counts, overdraw in fragments per pixel
+      if (pipelineStatistics->isEnabled())
+      {
+        std::array<PipelineCounters, PipelineStatistics::PASS_COUNT> counters;
+        auto ran = pipelineStatistics->takeAverages(counters);
+        double pixels = static_cast<double>(renderExtent.width) * renderExtent.height;
+        std::cout << "Pipeline statistics per frame (depth pre-pass " << (settings.depthPrepass ? "on" : "off")
+                  << "):" << std::endl;
+        for (uint32_t pass = 0; pass < PipelineStatistics::PASS_COUNT; pass++)
+        {
+          if (ran[pass] == 0)
+            continue;
+          const PipelineCounters& c = counters[pass];
+          std::cout << "  " << PipelineStatistics::passName(static_cast<StatisticsPass>(pass)) << ": "
+                    << c.inputVertices << " vertices, " << c.inputPrimitives << " primitives, "
+                    << c.vertexInvocations << " vertex invocations, " << c.clippingInvocations << " clipped to "
+                    << c.clippingPrimitives << " primitives, " << c.fragmentInvocations << " fragments ("
+                    << c.fragmentInvocations / pixels << " per pixel)" << std::endl;
+        }
+      }
+
+      if (gpuTimer->isSupported())
+      {
+        std::cout << "GPU frame: " << gpuTimer->getLastMilliseconds() << " ms, render "
+                  << renderExtent.width << "x" << renderExtent.height;
+        if (resolutionController)
+          std::cout << " (scale " << resolutionController->getScale() << ")";
+        std::cout << std::endl;
+      }
+
+      std::cout << "Objects drawn: " << occlusion->getDrawnCount() << " of " << occlusion->getObjectCount();
+      if (occlusion->isHiZEnabled())
+        std::cout << " (" << occlusion->getOccluderCount() << " occluders)";
+      std::cout << std::endl;
       frameCount = 0;
       lastTime = currentTime;
     }
   }
 
+  simulation.reset();
   vkDeviceWaitIdle(device->getDevice());
+  // The last captures are written before the writers stop
+  if (frameCapture)
+    frameCapture->collect(*graphicsTimeline);
   std::cout << "Main loop ended." << std::endl;
   std::cout << "Total time: " << timer->getElapsedSeconds() << " seconds" << std::endl;
 }
@@ -0,0 +1,48 @@
+#include "late_latch.hpp"
+#include "vulkan_memory.hpp"
+#include <cstring>
+
+LateLatch::LateLatch(VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t frameCount)
+  : buffer(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), mapped(nullptr), device(dev)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+  sliceSize = (sizeof(LatchedCamera) + alignment - 1) / alignment * alignment;
+
+  // Coherent, so a write just before the submission needs no flush
+  VkDeviceSize bufferSize = sliceSize * frameCount;
+  buffer = createBuffer(
+    physicalDevice, device, bufferSize,
+    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    memory
+  );
+  void* data;
+  vkMapMemory(device, memory, 0, bufferSize, 0, &data);
+  mapped = static_cast<char*>(data);
+}
+
+LateLatch::~LateLatch()
+{
+  if (buffer == VK_NULL_HANDLE)
+    return;
+
+  vkUnmapMemory(device, memory);
+  vkDestroyBuffer(device, buffer, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+void LateLatch::write(uint32_t frame, const LatchedCamera& camera)
+{
+  memcpy(mapped + sliceSize * frame, &camera, sizeof(camera));
+}
+
+VkDescriptorBufferInfo LateLatch::getDescriptorInfo(uint32_t frame) const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = sliceSize * frame;
+  bufferInfo.range = sizeof(LatchedCamera);
+  return bufferInfo;
+}
@@ -0,0 +1,53 @@
+#include "latency_tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+LatencyTracker::LatencyTracker() : pending{}, pendingFirst(0), pendingCount(0)
+{
+  latencies.reserve(MAX_SAMPLES);
+}
+
+void LatencyTracker::submit(uint64_t id, Clock::time_point inputTime)
+{
+  if (pendingCount == MAX_PENDING)
+  {
+    pendingFirst = (pendingFirst + 1) % MAX_PENDING;
+    pendingCount--;
+  }
+  pending[(pendingFirst + pendingCount) % MAX_PENDING] = {id, inputTime};
+  pendingCount++;
+}
+
+void LatencyTracker::complete(uint64_t id, Clock::time_point completeTime)
+{
+  while (pendingCount > 0 && pending[pendingFirst].id <= id)
+  {
+    if (latencies.size() < MAX_SAMPLES)
+      latencies.push_back(
+        std::chrono::duration<double, std::milli>(completeTime - pending[pendingFirst].inputTime).count()
+      );
+    pendingFirst = (pendingFirst + 1) % MAX_PENDING;
+    pendingCount--;
+  }
+}
+
+size_t LatencyTracker::takePercentiles(double& p50, double& p90, double& p99)
+{
+  p50 = p90 = p99 = 0.0;
+  const size_t count = latencies.size();
+  if (count > 0)
+  {
+    std::sort(latencies.begin(), latencies.end());
+    auto rank = [&](double fraction) {
+      const size_t index = static_cast<size_t>(std::ceil(fraction * count));
+      return latencies[std::max<size_t>(index, 1) - 1];
+    };
+    p50 = rank(0.50);
+    p90 = rank(0.90);
+    p99 = rank(0.99);
+  }
+
+  latencies.clear();
+  return count;
+}
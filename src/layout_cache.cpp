@@ -0,0 +1,117 @@
+#include "layout_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+static void hashCombine(size_t& seed, size_t value)
+{
+  seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+bool LayoutCache::SetLayoutKey::operator==(const SetLayoutKey& other) const
+{
+  return std::equal(
+    bindings.begin(), bindings.end(), other.bindings.begin(), other.bindings.end(),
+    [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+      return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+             a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+    }
+  );
+}
+
+bool LayoutCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const
+{
+  return setLayouts == other.setLayouts && pushConstants.stageFlags == other.pushConstants.stageFlags &&
+         pushConstants.offset == other.pushConstants.offset && pushConstants.size == other.pushConstants.size;
+}
+
+size_t LayoutCache::KeyHash::operator()(const SetLayoutKey& key) const
+{
+  size_t seed = key.bindings.size();
+  for (const auto& binding : key.bindings)
+  {
+    hashCombine(seed, binding.binding);
+    hashCombine(seed, binding.descriptorType);
+    hashCombine(seed, binding.descriptorCount);
+    hashCombine(seed, binding.stageFlags);
+  }
+  return seed;
+}
+
+size_t LayoutCache::KeyHash::operator()(const PipelineLayoutKey& key) const
+{
+  size_t seed = key.setLayouts.size();
+  for (VkDescriptorSetLayout setLayout : key.setLayouts)
+    hashCombine(seed, std::hash<VkDescriptorSetLayout>()(setLayout));
+  hashCombine(seed, key.pushConstants.stageFlags);
+  hashCombine(seed, key.pushConstants.offset);
+  hashCombine(seed, key.pushConstants.size);
+  return seed;
+}
+
+LayoutCache::LayoutCache(VkDevice dev) : device(dev)
+{
+}
+
+LayoutCache::~LayoutCache()
+{
+  for (const auto& [key, layout] : pipelineLayouts)
+    vkDestroyPipelineLayout(device, layout, nullptr);
+  for (const auto& [key, layout] : setLayouts)
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+}
+
+VkDescriptorSetLayout LayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+  SetLayoutKey key{bindings};
+  std::sort(key.bindings.begin(), key.bindings.end(), [](const auto& a, const auto& b) {
+    return a.binding < b.binding;
+  });
+
+  auto cached = setLayouts.find(key);
+  if (cached != setLayouts.end())
+    return cached->second;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+  layoutInfo.pBindings = key.bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create descriptor set layout!");
+
+  setLayouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+VkDescriptorSetLayout LayoutCache::getSetLayout(const ShaderReflection& reflection, uint32_t set)
+{
+  return getSetLayout(reflection.getSetBindings(set));
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const ShaderReflection& reflection)
+{
+  PipelineLayoutKey key{};
+  for (uint32_t set = 0; set < reflection.getSetCount(); set++)
+    key.setLayouts.push_back(getSetLayout(reflection, set));
+  key.pushConstants = reflection.getPushConstants();
+
+  auto cached = pipelineLayouts.find(key);
+  if (cached != pipelineLayouts.end())
+    return cached->second;
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+  layoutInfo.pSetLayouts = key.setLayouts.data();
+  layoutInfo.pushConstantRangeCount = key.pushConstants.size > 0 ? 1 : 0;
+  layoutInfo.pPushConstantRanges = &key.pushConstants;
+
+  VkPipelineLayout layout;
+  if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create pipeline layout!");
+
+  pipelineLayouts.emplace(std::move(key), layout);
+  return layout;
+}
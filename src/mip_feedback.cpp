@@ -0,0 +1,72 @@
+#include "mip_feedback.hpp"
+#include "vulkan_memory.hpp"
+#include <cstring>
+
+MipFeedback::MipFeedback(VkPhysicalDevice physicalDevice, VkDevice dev, uint32_t frameCount)
+  : buffer(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), mapped(nullptr), device(dev)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  const VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+  sliceSize = (sizeof(uint32_t) + alignment - 1) / alignment * alignment;
+
+  // Coherent, so collect reads the GPU's writes and resets the slice without flushes
+  VkDeviceSize bufferSize = sliceSize * frameCount;
+  buffer = createBuffer(
+    physicalDevice, device, bufferSize,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    memory
+  );
+  void* data;
+  vkMapMemory(device, memory, 0, bufferSize, 0, &data);
+  mapped = static_cast<char*>(data);
+
+  for (uint32_t i = 0; i < frameCount; i++)
+  {
+    const uint32_t none = UINT32_MAX;
+    memcpy(mapped + sliceSize * i, &none, sizeof(none));
+  }
+}
+
+MipFeedback::~MipFeedback()
+{
+  if (buffer == VK_NULL_HANDLE)
+    return;
+
+  vkUnmapMemory(device, memory);
+  vkDestroyBuffer(device, buffer, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+uint32_t MipFeedback::collect(uint32_t frame)
+{
+  uint32_t level;
+  memcpy(&level, mapped + sliceSize * frame, sizeof(level));
+
+  const uint32_t none = UINT32_MAX;
+  memcpy(mapped + sliceSize * frame, &none, sizeof(none));
+  return level;
+}
+
+void MipFeedback::record(VkCommandBuffer commandBuffer) const
+{
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0,
+    nullptr
+  );
+}
+
+VkDescriptorBufferInfo MipFeedback::getDescriptorInfo(uint32_t frame) const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = sliceSize * frame;
+  bufferInfo.range = sizeof(uint32_t);
+  return bufferInfo;
+}
@@ -0,0 +1,557 @@
+#include "occlusion_culling.hpp"
+#include "shader.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t REDUCE_GROUP_SIZE = 8;
+
+static uint32_t nextPowerOfTwo(uint32_t value)
+{
+  uint32_t result = 1;
+  while (result < value)
+    result <<= 1;
+  return result;
+}
+
+static void computeBarrier(
+  VkCommandBuffer commandBuffer,
+  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess
+) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+OcclusionCulling::OcclusionCulling(
+  VkPhysicalDevice physDev, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue,
+  uint32_t frameCount, const DepthBuffer& depthBuffer, VkSampler depthSampler,
+  VkPipelineLayout layout, LayoutCache& layouts, uint32_t meshIndexCount, bool enableHiZ
+) : physicalDevice(physDev), device(dev), sampler(depthSampler), hiZEnabled(enableHiZ), indexCount(meshIndexCount),
+    objectCount(0), historyCleared(false), drawBuffer(VK_NULL_HANDLE), drawBufferMemory(VK_NULL_HANDLE),
+    historyBuffer(VK_NULL_HANDLE), historyBufferMemory(VK_NULL_HANDLE), occluderCount(0), drawnCount(0),
+    occluderPass(VK_NULL_HANDLE), occluderFramebuffer(VK_NULL_HANDLE), depthView(VK_NULL_HANDLE),
+    pyramid(VK_NULL_HANDLE), pyramidMemory(VK_NULL_HANDLE), pyramidView(VK_NULL_HANDLE),
+    reduceSetLayout(VK_NULL_HANDLE), reduceLayout(VK_NULL_HANDLE), reducePool(VK_NULL_HANDLE)
+{
+  // 1. Buffers
+  VkDeviceSize objectBufferSize = sizeof(ObjectData) * MAX_OBJECTS;
+  objectBuffers.resize(frameCount);
+  objectBuffersMemory.resize(frameCount);
+  objectBuffersMapped.resize(frameCount);
+
+  for (size_t i = 0; i < frameCount; i++)
+  {
+    objectBuffers[i] = createBuffer(
+      physicalDevice, device, objectBufferSize,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      objectBuffersMemory[i]
+    );
+    vkMapMemory(device, objectBuffersMemory[i], 0, objectBufferSize, 0, &objectBuffersMapped[i]);
+  }
+
+  // Both indirect commands followed by both index lists
+  drawBufferSize = sizeof(DrawCommand) * 2 + sizeof(uint32_t) * MAX_OBJECTS * 2;
+  drawBuffer = createBuffer(
+    physicalDevice, device, drawBufferSize,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBufferMemory
+  );
+
+  historyBuffer = createBuffer(
+    physicalDevice, device, sizeof(uint32_t) * MAX_OBJECTS,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, historyBufferMemory
+  );
+
+  statsBuffers.resize(frameCount);
+  statsBuffersMemory.resize(frameCount);
+  statsBuffersMapped.resize(frameCount);
+  statsPending.assign(frameCount, false);
+
+  for (size_t i = 0; i < frameCount; i++)
+  {
+    statsBuffers[i] = createBuffer(
+      physicalDevice, device, sizeof(uint32_t) * 2,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      statsBuffersMemory[i]
+    );
+    vkMapMemory(device, statsBuffersMemory[i], 0, sizeof(uint32_t) * 2, 0, &statsBuffersMapped[i]);
+  }
+
+  // 2. Occluder pass and pipelines
+  createOccluderPass(depthBuffer.getFormat());
+  ShaderReflection reduceReflection(loadShaderCode("shaders/hiz.spv"));
+  reduceSetLayout = layouts.getSetLayout(reduceReflection, 0);
+  reduceLayout = layouts.getPipelineLayout(reduceReflection);
+
+  occluderPipeline = std::make_unique<DepthPipeline>(device, PipelineTarget(occluderPass), "shaders/depth.spv", layout);
+  reducePipeline = std::make_unique<ComputePipeline>(device, "shaders/hiz.spv", reduceLayout);
+  cullPipeline = std::make_unique<ComputePipeline>(device, "shaders/cull.spv", layout);
+
+  // 3. Size dependent resources
+  resize(commandPool, queue, depthBuffer);
+
+  std::cout << "Occlusion culling: Hi-Z " << (hiZEnabled ? "on" : "off")
+            << ", " << levelViews.size() << " pyramid levels" << std::endl;
+}
+
+OcclusionCulling::~OcclusionCulling()
+{
+  cullPipeline.reset();
+  reducePipeline.reset();
+  occluderPipeline.reset();
+
+  destroyPyramid();
+  if (occluderFramebuffer != VK_NULL_HANDLE)
+    vkDestroyFramebuffer(device, occluderFramebuffer, nullptr);
+  if (occluderPass != VK_NULL_HANDLE)
+    vkDestroyRenderPass(device, occluderPass, nullptr);
+
+  for (size_t i = 0; i < objectBuffers.size(); i++)
+  {
+    vkUnmapMemory(device, objectBuffersMemory[i]);
+    vkDestroyBuffer(device, objectBuffers[i], nullptr);
+    vkFreeMemory(device, objectBuffersMemory[i], nullptr);
+  }
+
+  for (size_t i = 0; i < statsBuffers.size(); i++)
+  {
+    vkUnmapMemory(device, statsBuffersMemory[i]);
+    vkDestroyBuffer(device, statsBuffers[i], nullptr);
+    vkFreeMemory(device, statsBuffersMemory[i], nullptr);
+  }
+
+  if (drawBuffer != VK_NULL_HANDLE)
+    vkDestroyBuffer(device, drawBuffer, nullptr);
+  if (drawBufferMemory != VK_NULL_HANDLE)
+    vkFreeMemory(device, drawBufferMemory, nullptr);
+  if (historyBuffer != VK_NULL_HANDLE)
+    vkDestroyBuffer(device, historyBuffer, nullptr);
+  if (historyBufferMemory != VK_NULL_HANDLE)
+    vkFreeMemory(device, historyBufferMemory, nullptr);
+}
+
+void OcclusionCulling::createOccluderPass(VkFormat depthFormat)
+{
+  // Depth of last frame's visible set, kept for the pyramid reduction. The frame graph transitions the depth
+  // buffer around the pass and orders it against last frame's uses and the reduction
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = depthFormat;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 0;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &depthAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+
+  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &occluderPass) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create occluder render pass!");
+}
+
+void OcclusionCulling::resize(VkCommandPool commandPool, QueueTimeline& queue, const DepthBuffer& depthBuffer)
+{
+  if (occluderFramebuffer != VK_NULL_HANDLE)
+    vkDestroyFramebuffer(device, occluderFramebuffer, nullptr);
+  destroyPyramid();
+
+  depthExtent = depthBuffer.getExtent();
+  depthView = depthBuffer.getImageView();
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = occluderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &depthView;
+  framebufferInfo.width = depthExtent.width;
+  framebufferInfo.height = depthExtent.height;
+  framebufferInfo.layers = 1;
+
+  if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &occluderFramebuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create occluder framebuffer!");
+
+  createPyramid(commandPool, queue);
+}
+
+void OcclusionCulling::createPyramid(VkCommandPool commandPool, QueueTimeline& queue)
+{
+  // Power-of-two level 0: every texel of level n then covers exactly 2^(n+1) depth pixels per axis
+  VkExtent2D extent = {
+    nextPowerOfTwo(std::max(1u, (depthExtent.width + 1) / 2)),
+    nextPowerOfTwo(std::max(1u, (depthExtent.height + 1) / 2))
+  };
+
+  levelExtents.clear();
+  for (VkExtent2D level = extent; ; level = {std::max(1u, level.width / 2), std::max(1u, level.height / 2)})
+  {
+    levelExtents.push_back(level);
+    if (level.width == 1 && level.height == 1)
+      break;
+  }
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  // 1. Image and views
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  pyramid = createImage(physicalDevice, device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramidMemory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = pyramid;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &pyramidView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create Hi-Z image view!");
+
+  levelViews.resize(levelCount);
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    viewInfo.subresourceRange.baseMipLevel = i;
+    viewInfo.subresourceRange.levelCount = 1;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[i]) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create Hi-Z level view!");
+  }
+
+  // 2. One reduction set per level: previous level (or depth) in, this level out
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = levelCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = levelCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = levelCount;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &reducePool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create Hi-Z descriptor pool!");
+
+  std::vector<VkDescriptorSetLayout> layouts(levelCount, reduceSetLayout);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = reducePool;
+  allocInfo.descriptorSetCount = levelCount;
+  allocInfo.pSetLayouts = layouts.data();
+
+  reduceSets.resize(levelCount);
+  if (vkAllocateDescriptorSets(device, &allocInfo, reduceSets.data()) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate Hi-Z descriptor sets!");
+
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    VkDescriptorImageInfo sourceInfo{};
+    sourceInfo.sampler = sampler;
+    sourceInfo.imageView = i == 0 ? depthView : levelViews[i - 1];
+    sourceInfo.imageLayout = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo destinationInfo{};
+    destinationInfo.imageView = levelViews[i];
+    destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = reduceSets[i];
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pImageInfo = &sourceInfo;
+
+    descriptorWrites[1] = descriptorWrites[0];
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[1].pImageInfo = &destinationInfo;
+
+    vkUpdateDescriptorSets(
+      device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr
+    );
+  }
+
+  // 3. The pyramid stays in GENERAL: written as storage image, read with texelFetch
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = pyramid;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(
+    commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &barrier
+  );
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+}
+
+void OcclusionCulling::destroyPyramid()
+{
+  if (reducePool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device, reducePool, nullptr);
+  reducePool = VK_NULL_HANDLE;
+  reduceSets.clear();
+
+  for (auto view : levelViews)
+    vkDestroyImageView(device, view, nullptr);
+  levelViews.clear();
+
+  if (pyramidView != VK_NULL_HANDLE)
+    vkDestroyImageView(device, pyramidView, nullptr);
+  if (pyramid != VK_NULL_HANDLE)
+    vkDestroyImage(device, pyramid, nullptr);
+  if (pyramidMemory != VK_NULL_HANDLE)
+    vkFreeMemory(device, pyramidMemory, nullptr);
+  pyramidView = VK_NULL_HANDLE;
+  pyramid = VK_NULL_HANDLE;
+  pyramidMemory = VK_NULL_HANDLE;
+}
+
+void OcclusionCulling::updateObjects(uint32_t frame, const std::vector<SceneObject>& objects)
+{
+  objectCount = static_cast<uint32_t>(std::min<size_t>(objects.size(), MAX_OBJECTS));
+  ObjectData* data = static_cast<ObjectData*>(objectBuffersMapped[frame]);
+
+  for (uint32_t i = 0; i < objectCount; i++)
+  {
+    // World AABB of the unit cube under this transform
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (uint32_t c = 0; c < 8; c++)
+    {
+      glm::vec3 corner((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f);
+      glm::vec3 world = glm::vec3(objects[i].model * glm::vec4(corner, 1.0f));
+      boundsMin = glm::min(boundsMin, world);
+      boundsMax = glm::max(boundsMax, world);
+    }
+
+    data[i].model = objects[i].model;
+    data[i].boundsMin = glm::vec4(boundsMin, 0.0f);
+    data[i].boundsMax = glm::vec4(boundsMax, 0.0f);
+  }
+}
+
+void OcclusionCulling::dispatchCull(
+  VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet, uint32_t mode
+) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->getPipeline());
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(
+    commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(mode), &mode
+  );
+  vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void OcclusionCulling::recordReset(VkCommandBuffer commandBuffer)
+{
+  if (!historyCleared)
+  {
+    vkCmdFillBuffer(commandBuffer, historyBuffer, 0, VK_WHOLE_SIZE, 0);
+    historyCleared = true;
+  }
+
+  std::array<DrawCommand, 2> commands{};
+  for (auto& command : commands)
+    command.indexCount = indexCount;
+  vkCmdUpdateBuffer(commandBuffer, drawBuffer, 0, sizeof(commands), commands.data());
+}
+
+void OcclusionCulling::recordOccluderList(
+  VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet
+) {
+  dispatchCull(commandBuffer, layout, descriptorSet, MODE_OCCLUDERS);
+}
+
+void OcclusionCulling::recordOccluders(
+  VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet,
+  VkBuffer positionBuffer, VkBuffer indexBuffer, VkExtent2D renderExtent
+) {
+  VkClearValue clearValue{};
+  clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = occluderPass;
+  renderPassInfo.framebuffer = occluderFramebuffer;
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = depthExtent;
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, occluderPipeline->getPipeline());
+
+  VkViewport viewport{};
+  viewport.width = static_cast<float>(renderExtent.width);
+  viewport.height = static_cast<float>(renderExtent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = renderExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  vkCmdBindDescriptorSets(
+    commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &descriptorSet, 0, nullptr
+  );
+
+  uint32_t drawList = OCCLUDER_LIST;
+  vkCmdPushConstants(
+    commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(drawList), &drawList
+  );
+  vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, sizeof(DrawCommand) * OCCLUDER_LIST, 1, sizeof(DrawCommand));
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void OcclusionCulling::recordPyramid(VkCommandBuffer commandBuffer)
+{
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline->getPipeline());
+
+  for (size_t i = 0; i < levelExtents.size(); i++)
+  {
+    // Each level is the input of the next one; the graph orders the last one before the cull pass
+    if (i > 0)
+      computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+      );
+
+    vkCmdBindDescriptorSets(
+      commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduceLayout, 0, 1, &reduceSets[i], 0, nullptr
+    );
+    vkCmdDispatch(
+      commandBuffer,
+      (levelExtents[i].width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+      (levelExtents[i].height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+      1
+    );
+  }
+}
+
+void OcclusionCulling::recordCull(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkDescriptorSet descriptorSet)
+{
+  dispatchCull(commandBuffer, layout, descriptorSet, hiZEnabled ? MODE_HIZ : MODE_FRUSTUM);
+}
+
+void OcclusionCulling::recordStatistics(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  std::array<VkBufferCopy, 2> regions{};
+  regions[0].srcOffset = sizeof(DrawCommand) * OCCLUDER_LIST + offsetof(DrawCommand, instanceCount);
+  regions[0].dstOffset = 0;
+  regions[0].size = sizeof(uint32_t);
+  regions[1].srcOffset = sizeof(DrawCommand) * VISIBLE_LIST + offsetof(DrawCommand, instanceCount);
+  regions[1].dstOffset = sizeof(uint32_t);
+  regions[1].size = sizeof(uint32_t);
+  vkCmdCopyBuffer(
+    commandBuffer, drawBuffer, statsBuffers[frame], static_cast<uint32_t>(regions.size()), regions.data()
+  );
+
+  // The graph knows no host reads
+  computeBarrier(
+    commandBuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+    VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT
+  );
+  statsPending[frame] = true;
+}
+
+void OcclusionCulling::collect(uint32_t frame)
+{
+  if (!statsPending[frame])
+    return;
+
+  const uint32_t* counts = static_cast<const uint32_t*>(statsBuffersMapped[frame]);
+  occluderCount = counts[0];
+  drawnCount = counts[1];
+  statsPending[frame] = false;
+}
+
+VkDescriptorBufferInfo OcclusionCulling::getObjectBufferInfo(uint32_t frame) const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = objectBuffers[frame];
+  bufferInfo.offset = 0;
+  bufferInfo.range = sizeof(ObjectData) * MAX_OBJECTS;
+  return bufferInfo;
+}
+
+VkDescriptorBufferInfo OcclusionCulling::getDrawBufferInfo() const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = drawBuffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = drawBufferSize;
+  return bufferInfo;
+}
+
+VkDescriptorBufferInfo OcclusionCulling::getHistoryBufferInfo() const
+{
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = historyBuffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = sizeof(uint32_t) * MAX_OBJECTS;
+  return bufferInfo;
+}
+
+VkDescriptorImageInfo OcclusionCulling::getPyramidInfo() const
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = pyramidView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  return imageInfo;
+}
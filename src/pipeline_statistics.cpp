@@ -0,0 +1,112 @@
+#include "pipeline_statistics.hpp"
+
+#include <algorithm>
+
+// Results come back in bit order, as PipelineCounters lays them out
+static const VkQueryPipelineStatisticFlags STATISTICS =
+  VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+  VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+PipelineStatistics::PipelineStatistics(VkDevice dev, bool supported, uint32_t frameCount)
+  : device(dev), queryPool(VK_NULL_HANDLE), written(frameCount, 0), totals{}, samples{}
+{
+  if (!supported)
+  {
+    std::cout << "Pipeline statistics queries are disabled, no pass counters" << std::endl;
+    return;
+  }
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  poolInfo.queryCount = frameCount * PASS_COUNT;
+  poolInfo.pipelineStatistics = STATISTICS;
+
+  if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create pipeline statistics query pool!");
+}
+
+PipelineStatistics::~PipelineStatistics()
+{
+  if (queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+const char* PipelineStatistics::passName(StatisticsPass pass)
+{
+  static const char* NAMES[PASS_COUNT] = {"shadows", "occluders", "depth pre-pass", "color", "lighting"};
+  return NAMES[static_cast<uint32_t>(pass)];
+}
+
+void PipelineStatistics::collect(uint32_t frame)
+{
+  if (queryPool == VK_NULL_HANDLE)
+    return;
+
+  for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+  {
+    if (!(written[frame] & (1u << pass)))
+      continue;
+
+    PipelineCounters counters{};
+    VkResult result = vkGetQueryPoolResults(
+      device, queryPool, queryIndex(frame, static_cast<StatisticsPass>(pass)), 1, sizeof(counters), &counters,
+      sizeof(counters), VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS)
+      continue;
+
+    PipelineCounters& total = totals[pass];
+    total.inputVertices += counters.inputVertices;
+    total.inputPrimitives += counters.inputPrimitives;
+    total.vertexInvocations += counters.vertexInvocations;
+    total.clippingInvocations += counters.clippingInvocations;
+    total.clippingPrimitives += counters.clippingPrimitives;
+    total.fragmentInvocations += counters.fragmentInvocations;
+    samples[pass]++;
+  }
+  written[frame] = 0;
+}
+
+void PipelineStatistics::reset(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+  if (queryPool != VK_NULL_HANDLE)
+    vkCmdResetQueryPool(commandBuffer, queryPool, queryIndex(frame, StatisticsPass::Shadows), PASS_COUNT);
+}
+
+void PipelineStatistics::begin(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass)
+{
+  if (queryPool != VK_NULL_HANDLE)
+    vkCmdBeginQuery(commandBuffer, queryPool, queryIndex(frame, pass), 0);
+}
+
+void PipelineStatistics::end(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass)
+{
+  if (queryPool == VK_NULL_HANDLE)
+    return;
+
+  vkCmdEndQuery(commandBuffer, queryPool, queryIndex(frame, pass));
+  written[frame] |= 1u << static_cast<uint32_t>(pass);
+}
+
+std::array<uint32_t, PipelineStatistics::PASS_COUNT> PipelineStatistics::takeAverages(
+  std::array<PipelineCounters, PASS_COUNT>& averages
+) {
+  std::array<uint32_t, PASS_COUNT> counts = samples;
+  for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+  {
+    const uint64_t n = std::max<uint64_t>(samples[pass], 1);
+    const PipelineCounters& total = totals[pass];
+    averages[pass] = {
+      total.inputVertices / n, total.inputPrimitives / n, total.vertexInvocations / n,
+      total.clippingInvocations / n, total.clippingPrimitives / n, total.fragmentInvocations / n
+    };
+  }
+  totals = {};
+  samples = {};
+  return counts;
+}
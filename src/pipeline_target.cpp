@@ -0,0 +1,26 @@
+#include "pipeline_target.hpp"
+
+PipelineTarget::PipelineTarget(VkRenderPass renderPass, uint32_t subpass, uint32_t colorAttachmentCount)
+  : renderPass(renderPass), subpass(subpass), colorAttachmentCount(colorAttachmentCount),
+    depthFormat(VK_FORMAT_UNDEFINED) {}
+
+PipelineTarget::PipelineTarget(VkFormat depthFormat, const std::vector<VkFormat>& colorFormats)
+  : renderPass(VK_NULL_HANDLE), subpass(0), colorAttachmentCount(static_cast<uint32_t>(colorFormats.size())),
+    colorFormats(colorFormats), depthFormat(depthFormat) {}
+
+void PipelineTarget::apply(
+  VkGraphicsPipelineCreateInfo& pipelineInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo
+) const {
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = subpass;
+  if (renderPass != VK_NULL_HANDLE)
+    return;
+
+  renderingInfo = {};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = colorAttachmentCount;
+  renderingInfo.pColorAttachmentFormats = colorFormats.data();
+  renderingInfo.depthAttachmentFormat = depthFormat;
+  renderingInfo.pNext = pipelineInfo.pNext;
+  pipelineInfo.pNext = &renderingInfo;
+}
@@ -0,0 +1,435 @@
+#include "post_process.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+// Every post shader runs 8x8 groups, one destination texel per invocation
+static const uint32_t POST_GROUP_SIZE = 8;
+// Must match HISTOGRAM_BINS in the shaders
+static const uint32_t HISTOGRAM_BINS = 256;
+
+// Matches PostConstants in the post shaders
+struct PostConstants
+{
+  int32_t sourceSize[2];       // rendered part of the source
+  int32_t destinationSize[2];  // part of the destination to fill
+  float deltaTime;
+  uint32_t frame;
+  uint32_t encodeSrgb;
+};
+
+static void computeBarrier(
+  VkCommandBuffer commandBuffer,
+  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess
+) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+static VkExtent2D halve(VkExtent2D extent)
+{
+  return {std::max(1u, (extent.width + 1) / 2), std::max(1u, (extent.height + 1) / 2)};
+}
+
+PostProcess::PostProcess(
+  VkPhysicalDevice physDev, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue,
+  VkSampler linearSampler, bool srgbOutput, LayoutCache& layouts
+) : physicalDevice(physDev), device(dev), sampler(linearSampler), encodeSrgb(srgbOutput), frameIndex(0),
+    lastRecord(std::chrono::steady_clock::now()), deltaTime(0.0f), luminanceBuffer(VK_NULL_HANDLE),
+    luminanceBufferMemory(VK_NULL_HANDLE), hdr(NO_RESOURCE), bloom(NO_RESOURCE), output(NO_RESOURCE),
+    hdrView(VK_NULL_HANDLE), setLayout(VK_NULL_HANDLE), layout(VK_NULL_HANDLE), pool(VK_NULL_HANDLE),
+    boundPipeline(VK_NULL_HANDLE), boundSet(VK_NULL_HANDLE)
+{
+  createLayout(layouts);
+  createLuminanceBuffer(commandPool, queue);
+
+  prefilterPipeline = std::make_unique<ComputePipeline>(device, "shaders/post_prefilter.spv", layout);
+  exposurePipeline = std::make_unique<ComputePipeline>(device, "shaders/exposure.spv", layout);
+  downsamplePipeline = std::make_unique<ComputePipeline>(device, "shaders/bloom_down.spv", layout);
+  upsamplePipeline = std::make_unique<ComputePipeline>(device, "shaders/bloom_up.spv", layout);
+  resolvePipeline = std::make_unique<ComputePipeline>(device, "shaders/post_resolve.spv", layout);
+
+  std::cout << "Post processing: " << (encodeSrgb ? "sRGB encoded in the shader" : "linear output") << std::endl;
+}
+
+PostProcess::~PostProcess()
+{
+  resolvePipeline.reset();
+  upsamplePipeline.reset();
+  downsamplePipeline.reset();
+  exposurePipeline.reset();
+  prefilterPipeline.reset();
+
+  destroyViews();
+
+  if (luminanceBuffer != VK_NULL_HANDLE)
+    vkDestroyBuffer(device, luminanceBuffer, nullptr);
+  if (luminanceBufferMemory != VK_NULL_HANDLE)
+    vkFreeMemory(device, luminanceBufferMemory, nullptr);
+}
+
+void PostProcess::createLayout(LayoutCache& layouts)
+{
+  // One layout for every stage: source, destination level, luminance, bloom input and 8-bit output
+  auto reflection = ShaderReflection::fromFiles({
+    "shaders/post_prefilter.spv", "shaders/exposure.spv", "shaders/bloom_down.spv", "shaders/bloom_up.spv",
+    "shaders/post_resolve.spv"
+  });
+  if (reflection.getPushConstants().size != sizeof(PostConstants))
+    throw std::runtime_error("PostConstants does not match the post processing shaders!");
+
+  setLayout = layouts.getSetLayout(reflection, 0);
+  layout = layouts.getPipelineLayout(reflection);
+}
+
+void PostProcess::createLuminanceBuffer(VkCommandPool commandPool, QueueTimeline& queue)
+{
+  const VkDeviceSize histogramSize = sizeof(uint32_t) * HISTOGRAM_BINS;
+  luminanceBuffer = createBuffer(
+    physicalDevice, device, histogramSize + sizeof(float),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, luminanceBufferMemory
+  );
+
+  // Empty histogram, neutral exposure to adapt from
+  const float initialExposure = 1.0f;
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+  vkCmdFillBuffer(commandBuffer, luminanceBuffer, 0, histogramSize, 0);
+  vkCmdUpdateBuffer(commandBuffer, luminanceBuffer, histogramSize, sizeof(float), &initialExposure);
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+}
+
+GraphResource PostProcess::addPasses(
+  RenderGraph& graph, GraphResource hdrTarget, VkExtent2D extent, const VkExtent2D& renderExtent
+) {
+  // Mip sizes round down; stop before the levels get too small to add any blur
+  levelExtents.clear();
+  for (
+    VkExtent2D level = halve(extent);
+    levelExtents.size() < MAX_BLOOM_LEVELS;
+    level = {std::max(1u, level.width / 2), std::max(1u, level.height / 2)}
+  ) {
+    levelExtents.push_back(level);
+    if (level.width < 4 || level.height < 4)
+      break;
+  }
+  validExtents.resize(levelExtents.size());
+
+  // Bloom levels are written as storage images and read with the sampler, both in GENERAL
+  GraphImageDesc bloomDesc{};
+  bloomDesc.format = HDR_FORMAT;
+  bloomDesc.extent = levelExtents[0];
+  bloomDesc.mipLevels = static_cast<uint32_t>(levelExtents.size());
+  bloomDesc.extraUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  GraphImageDesc outputDesc{};
+  outputDesc.format = OUTPUT_FORMAT;
+  outputDesc.extent = extent;
+
+  hdr = hdrTarget;
+  bloom = graph.createImage("bloom", bloomDesc);
+  output = graph.createImage("post output", outputDesc);
+  GraphResource luminance = graph.importBuffer("luminance", luminanceBuffer);
+
+  graph.addPass("bloom", [this, &renderExtent](VkCommandBuffer commandBuffer) {
+    recordBloom(commandBuffer, renderExtent);
+  })
+    .read(hdr, GraphAccess::SampledCompute)
+    .write(bloom, GraphAccess::StorageCompute)
+    .write(luminance, GraphAccess::StorageCompute);
+
+  graph.addPass("post resolve", [this, &renderExtent](VkCommandBuffer commandBuffer) {
+    recordResolve(commandBuffer, renderExtent);
+  })
+    .read(hdr, GraphAccess::SampledCompute)
+    .read(bloom, GraphAccess::StorageCompute)
+    .read(luminance, GraphAccess::StorageCompute)
+    .write(output, GraphAccess::StorageCompute);
+
+  return output;
+}
+
+void PostProcess::bind(const RenderGraph& graph)
+{
+  destroyViews();
+  hdrView = graph.getImageView(hdr);
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  // 1. One view per bloom level
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = graph.getImage(bloom);
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = HDR_FORMAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  levelViews.resize(levelCount);
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    viewInfo.subresourceRange.baseMipLevel = i;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[i]) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create bloom level view!");
+  }
+
+  // 2. Sets: prefilter, downsample into levels 1.., upsample into levels ..0, resolve
+  uint32_t setCount = levelCount * 2;
+
+  std::array<VkDescriptorPoolSize, 3> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = setCount * 2;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = setCount * 2;
+  poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[2].descriptorCount = setCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = setCount;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create post processing descriptor pool!");
+
+  std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = pool;
+  allocInfo.descriptorSetCount = setCount;
+  allocInfo.pSetLayouts = layouts.data();
+
+  sets.resize(setCount);
+  if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate post processing descriptor sets!");
+
+  writeSet(sets[0], hdrView, levelViews[0], VK_NULL_HANDLE, VK_NULL_HANDLE);
+  for (uint32_t i = 1; i < levelCount; i++)
+    writeSet(sets[i], levelViews[i - 1], levelViews[i], VK_NULL_HANDLE, VK_NULL_HANDLE);
+  for (uint32_t i = 0; i + 1 < levelCount; i++)
+    writeSet(sets[levelCount + i], levelViews[i + 1], levelViews[i], VK_NULL_HANDLE, VK_NULL_HANDLE);
+  writeSet(sets[setCount - 1], hdrView, VK_NULL_HANDLE, levelViews[0], graph.getImageView(output));
+}
+
+void PostProcess::destroyViews()
+{
+  if (pool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  pool = VK_NULL_HANDLE;
+  sets.clear();
+
+  for (auto view : levelViews)
+    vkDestroyImageView(device, view, nullptr);
+  levelViews.clear();
+}
+
+void PostProcess::writeSet(
+  VkDescriptorSet set, VkImageView source, VkImageView destination, VkImageView bloomSource, VkImageView outputView
+) {
+  // The HDR target is read after the render pass, everything else lives in GENERAL
+  VkDescriptorImageInfo sourceInfo{};
+  sourceInfo.sampler = sampler;
+  sourceInfo.imageView = source;
+  sourceInfo.imageLayout =
+    source == hdrView ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorImageInfo destinationInfo{};
+  destinationInfo.imageView = destination;
+  destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorBufferInfo luminanceInfo{};
+  luminanceInfo.buffer = luminanceBuffer;
+  luminanceInfo.offset = 0;
+  luminanceInfo.range = VK_WHOLE_SIZE;
+
+  VkDescriptorImageInfo bloomInfo{};
+  bloomInfo.sampler = sampler;
+  bloomInfo.imageView = bloomSource;
+  bloomInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorImageInfo outputInfo{};
+  outputInfo.imageView = outputView;
+  outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  // Bindings a stage does not use are left unwritten
+  std::vector<VkWriteDescriptorSet> descriptorWrites;
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstArrayElement = 0;
+  write.descriptorCount = 1;
+
+  write.dstBinding = 0;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &sourceInfo;
+  descriptorWrites.push_back(write);
+
+  write.dstBinding = 2;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pImageInfo = nullptr;
+  write.pBufferInfo = &luminanceInfo;
+  descriptorWrites.push_back(write);
+  write.pBufferInfo = nullptr;
+
+  if (destination != VK_NULL_HANDLE)
+  {
+    write.dstBinding = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &destinationInfo;
+    descriptorWrites.push_back(write);
+  }
+
+  if (bloomSource != VK_NULL_HANDLE)
+  {
+    write.dstBinding = 3;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &bloomInfo;
+    descriptorWrites.push_back(write);
+  }
+
+  if (outputView != VK_NULL_HANDLE)
+  {
+    write.dstBinding = 4;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &outputInfo;
+    descriptorWrites.push_back(write);
+  }
+
+  vkUpdateDescriptorSets(
+    device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr
+  );
+}
+
+void PostProcess::dispatch(
+  VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet set,
+  VkExtent2D sourceSize, VkExtent2D destinationSize, VkExtent2D groups
+) {
+  PostConstants constants{};
+  constants.sourceSize[0] = static_cast<int32_t>(sourceSize.width);
+  constants.sourceSize[1] = static_cast<int32_t>(sourceSize.height);
+  constants.destinationSize[0] = static_cast<int32_t>(destinationSize.width);
+  constants.destinationSize[1] = static_cast<int32_t>(destinationSize.height);
+  constants.deltaTime = deltaTime;
+  constants.frame = frameIndex;
+  constants.encodeSrgb = encodeSrgb ? 1 : 0;
+
+  // Ordered by barriers, so not sorted like the draws, but binds are skipped the same way
+  if (pipeline.getPipeline() != boundPipeline)
+  {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getPipeline());
+    boundPipeline = pipeline.getPipeline();
+    drawStats.pipelineBinds++;
+  }
+  else
+    drawStats.skippedBinds++;
+
+  // All pipelines share the layout, sets stay bound across them
+  if (set != boundSet)
+  {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    boundSet = set;
+    drawStats.descriptorBinds++;
+  }
+  else
+    drawStats.skippedBinds++;
+
+  vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdDispatch(commandBuffer, groups.width, groups.height, 1);
+  drawStats.draws++;
+}
+
+static VkExtent2D groupCount(VkExtent2D size, uint32_t groupSize)
+{
+  return {(size.width + groupSize - 1) / groupSize, (size.height + groupSize - 1) / groupSize};
+}
+
+void PostProcess::recordBloom(VkCommandBuffer commandBuffer, VkExtent2D renderExtent)
+{
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+  uint32_t resolveSet = levelCount * 2 - 1;
+  boundPipeline = VK_NULL_HANDLE;
+  boundSet = VK_NULL_HANDLE;
+
+  // Long stalls should not make the exposure jump
+  auto now = std::chrono::steady_clock::now();
+  deltaTime = std::min(std::chrono::duration<float>(now - lastRecord).count(), 0.1f);
+  lastRecord = now;
+
+  std::vector<VkExtent2D>& valid = validExtents;
+  valid[0] = halve(renderExtent);
+  for (uint32_t i = 1; i < levelCount; i++)
+  {
+    VkExtent2D half = halve(valid[i - 1]);
+    valid[i] = {std::min(half.width, levelExtents[i].width), std::min(half.height, levelExtents[i].height)};
+  }
+
+  // 1. HDR -> bloom level 0 and the luminance histogram
+  dispatch(
+    commandBuffer, *prefilterPipeline, sets[0], renderExtent, valid[0], groupCount(valid[0], POST_GROUP_SIZE)
+  );
+  computeBarrier(
+    commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+  );
+
+  // 2. Exposure, independent of the bloom levels; the graph orders it before the resolve
+  dispatch(commandBuffer, *exposurePipeline, sets[resolveSet], renderExtent, renderExtent, {1, 1});
+
+  // 3. Bloom down the chain, then back up adding every level into the one above
+  for (uint32_t i = 1; i < levelCount; i++)
+  {
+    dispatch(
+      commandBuffer, *downsamplePipeline, sets[i], valid[i - 1], valid[i], groupCount(valid[i], POST_GROUP_SIZE)
+    );
+    computeBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+  }
+
+  for (uint32_t i = levelCount - 1; i > 0; i--)
+  {
+    dispatch(
+      commandBuffer, *upsamplePipeline, sets[levelCount + i - 1], valid[i], valid[i - 1],
+      groupCount(valid[i - 1], POST_GROUP_SIZE)
+    );
+    // The last level is waited for by the resolve pass's barrier
+    if (i > 1)
+      computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+      );
+  }
+}
+
+void PostProcess::recordResolve(VkCommandBuffer commandBuffer, VkExtent2D renderExtent)
+{
+  uint32_t resolveSet = static_cast<uint32_t>(levelExtents.size()) * 2 - 1;
+  boundPipeline = VK_NULL_HANDLE;
+  boundSet = VK_NULL_HANDLE;
+
+  // 4. Composite, expose, tonemap and dither into the 8-bit output
+  dispatch(
+    commandBuffer, *resolvePipeline, sets[resolveSet], renderExtent, renderExtent,
+    groupCount(renderExtent, POST_GROUP_SIZE)
+  );
+
+  frameIndex++;
+}
+
+DrawStats PostProcess::takeDrawStats()
+{
+  DrawStats stats = drawStats;
+  drawStats = {};
+  return stats;
+}
@@ -0,0 +1,217 @@
+#include "queue_timeline.hpp"
+
+#include <algorithm>
+#include <array>
+
+QueueTimeline::QueueTimeline(const VulkanDevice& vulkanDevice, VkQueue targetQueue, bool useTimelineSemaphore)
+  : device(vulkanDevice), queue(targetQueue), semaphore(VK_NULL_HANDLE), submittedValue(0), completedValue(0)
+{
+  if (!useTimelineSemaphore || !device.supportsTimelineSemaphores())
+    return;
+
+  VkSemaphoreTypeCreateInfoKHR typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create timeline semaphore!");
+}
+
+QueueTimeline::~QueueTimeline()
+{
+  wait(submittedValue);
+
+  for (VkFence fence : freeFences)
+    vkDestroyFence(device.getDevice(), fence, nullptr);
+  if (semaphore != VK_NULL_HANDLE)
+    vkDestroySemaphore(device.getDevice(), semaphore, nullptr);
+}
+
+VkFence QueueTimeline::acquireFence()
+{
+  if (!freeFences.empty())
+  {
+    VkFence fence = freeFences.back();
+    freeFences.pop_back();
+    return fence;
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkFence fence;
+  if (vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create submission fence!");
+  return fence;
+}
+
+void QueueTimeline::retireFence()
+{
+  // A fence also covers every earlier submission to the queue, so they signal in order
+  auto [value, fence] = pendingFences.front();
+  pendingFences.pop_front();
+  vkResetFences(device.getDevice(), 1, &fence);
+  freeFences.push_back(fence);
+  completedValue = value;
+}
+
+uint64_t QueueTimeline::submit(
+  std::span<const VkCommandBuffer> commandBuffers, std::span<const SemaphoreWait> waits,
+  std::span<const TimelineWait> after, std::span<const VkSemaphore> signals
+) {
+  if (waits.size() + after.size() > MAX_WAITS || signals.size() + 1 > MAX_SIGNALS)
+    throw std::runtime_error("Too many semaphores in one submission!");
+
+  // Binary semaphores ignore their value, but the value arrays must cover every semaphore
+  std::array<VkSemaphore, MAX_WAITS> waitSemaphores;
+  std::array<uint64_t, MAX_WAITS> waitValues;
+  std::array<VkPipelineStageFlags, MAX_WAITS> waitStages;
+  uint32_t waitCount = 0;
+  for (const SemaphoreWait& wait : waits)
+  {
+    waitSemaphores[waitCount] = wait.semaphore;
+    waitValues[waitCount] = 0;
+    waitStages[waitCount++] = wait.stages;
+  }
+  for (const TimelineWait& wait : after)
+  {
+    if (!wait.timeline->usesTimelineSemaphore())
+    {
+      wait.timeline->wait(wait.value);
+      continue;
+    }
+    waitSemaphores[waitCount] = wait.timeline->semaphore;
+    waitValues[waitCount] = wait.value;
+    waitStages[waitCount++] = wait.stages;
+  }
+
+  std::array<VkSemaphore, MAX_SIGNALS> signalSemaphores;
+  std::array<uint64_t, MAX_SIGNALS> signalValues;
+  uint32_t signalCount = 0;
+  for (VkSemaphore signal : signals)
+  {
+    signalSemaphores[signalCount] = signal;
+    signalValues[signalCount++] = 0;
+  }
+  const uint64_t value = submittedValue + 1;
+  if (semaphore != VK_NULL_HANDLE)
+  {
+    signalSemaphores[signalCount] = semaphore;
+    signalValues[signalCount++] = value;
+  }
+
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+  timelineInfo.waitSemaphoreValueCount = waitCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineInfo.signalSemaphoreValueCount = signalCount;
+  timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = semaphore != VK_NULL_HANDLE ? &timelineInfo : nullptr;
+  submitInfo.waitSemaphoreCount = waitCount;
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+  submitInfo.pCommandBuffers = commandBuffers.data();
+  submitInfo.signalSemaphoreCount = signalCount;
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+  VkFence fence = semaphore == VK_NULL_HANDLE ? acquireFence() : VK_NULL_HANDLE;
+  if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+  {
+    if (fence != VK_NULL_HANDLE)
+      freeFences.push_back(fence);
+    throw std::runtime_error("Failed to submit command buffers!");
+  }
+
+  submittedValue = value;
+  if (fence != VK_NULL_HANDLE)
+    pendingFences.emplace_back(value, fence);
+  return value;
+}
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+  if (semaphore != VK_NULL_HANDLE)
+    completedValue = std::max(completedValue, device.getSemaphoreValue(semaphore));
+  else
+    while (
+      !pendingFences.empty() && vkGetFenceStatus(device.getDevice(), pendingFences.front().second) == VK_SUCCESS
+    )
+      retireFence();
+  return completedValue;
+}
+
+bool QueueTimeline::isComplete(uint64_t value)
+{
+  return value <= completedValue || value <= getCompletedValue();
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+  if (isComplete(value))
+    return;
+  // Nothing would ever signal it
+  if (value > submittedValue)
+    throw std::runtime_error("Waiting for a timeline value that was never submitted!");
+
+  if (semaphore != VK_NULL_HANDLE)
+  {
+    device.waitSemaphore(semaphore, value, UINT64_MAX);
+    completedValue = std::max(completedValue, value);
+    return;
+  }
+
+  while (completedValue < value)
+  {
+    vkWaitForFences(device.getDevice(), 1, &pendingFences.front().second, VK_TRUE, UINT64_MAX);
+    retireFence();
+  }
+}
+
+void BufferTransfer::release(
+  VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess
+) const {
+  if (!isNeeded())
+    return;
+
+  // The destination half of a release is ignored, the acquiring queue supplies it
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = 0;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(
+    commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr
+  );
+}
+
+void BufferTransfer::acquire(
+  VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess
+) const {
+  if (!isNeeded())
+    return;
+
+  // The source half chains to the semaphore wait, which covers dstStages
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccess;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, dstStages, dstStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
@@ -0,0 +1,617 @@
+#include "render_graph.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+struct AccessInfo
+{
+  VkPipelineStageFlags stages;
+  VkAccessFlags read;
+  VkAccessFlags write;
+  VkImageLayout layout;
+  VkImageUsageFlags imageUsage;
+  VkBufferUsageFlags bufferUsage;
+};
+
+// Indexed by GraphAccess
+static const std::array<AccessInfo, 9> ACCESS_INFO = {{
+  {
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0
+  },
+  {
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0
+  },
+  {
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0
+  },
+  {
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+  },
+  {
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0,
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+  },
+  {
+    VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  },
+  {
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0,
+    VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+  },
+  {
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0
+  },
+  {
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+  }
+}};
+
+static const AccessInfo& accessInfo(GraphAccess access)
+{
+  return ACCESS_INFO[static_cast<size_t>(access)];
+}
+
+static const VkImageUsageFlags ATTACHMENT_USAGE =
+  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(GraphResource resource, GraphAccess access)
+{
+  if (accessInfo(access).read == 0)
+    throw std::runtime_error("Render graph access cannot be read: " + graph.passes[pass].name);
+  graph.passes[pass].uses.push_back({resource, access, false});
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(GraphResource resource, GraphAccess access)
+{
+  if (accessInfo(access).write == 0)
+    throw std::runtime_error("Render graph access cannot be written: " + graph.passes[pass].name);
+  graph.passes[pass].uses.push_back({resource, access, true});
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffect()
+{
+  graph.passes[pass].sideEffect = true;
+  return *this;
+}
+
+RenderGraph::RenderGraph(VkPhysicalDevice physDev, VkDevice dev)
+  : physicalDevice(physDev), device(dev), transientBytes(0), unaliasedBytes(0), compiled(false)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+  for (const Resource& resource : resources)
+  {
+    if (resource.imported)
+      continue;
+    if (resource.view != VK_NULL_HANDLE)
+      vkDestroyImageView(device, resource.view, nullptr);
+    if (resource.image != VK_NULL_HANDLE)
+      vkDestroyImage(device, resource.image, nullptr);
+    if (resource.buffer != VK_NULL_HANDLE)
+      vkDestroyBuffer(device, resource.buffer, nullptr);
+  }
+
+  for (VkDeviceMemory memory : allocations)
+    vkFreeMemory(device, memory, nullptr);
+}
+
+GraphResource RenderGraph::createImage(const std::string& name, const GraphImageDesc& desc)
+{
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.desc = desc;
+  resource.imageUsage = desc.extraUsage;
+  resources.push_back(resource);
+  return static_cast<GraphResource>(resources.size() - 1);
+}
+
+GraphResource RenderGraph::createBuffer(const std::string& name, VkDeviceSize size)
+{
+  Resource resource{};
+  resource.name = name;
+  resource.size = size;
+  resources.push_back(resource);
+  return static_cast<GraphResource>(resources.size() - 1);
+}
+
+GraphResource RenderGraph::importImage(
+  const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+  GraphState initial, GraphState final
+) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.imported = true;
+  resource.desc.aspect = aspect;
+  resource.initial = initial;
+  resource.final = final;
+  resource.image = image;
+  resource.view = view;
+  resources.push_back(resource);
+  return static_cast<GraphResource>(resources.size() - 1);
+}
+
+GraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+  Resource resource{};
+  resource.name = name;
+  resource.imported = true;
+  resource.buffer = buffer;
+  resources.push_back(resource);
+  return static_cast<GraphResource>(resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, Execute execute)
+{
+  if (compiled)
+    throw std::runtime_error("Render graph is already compiled!");
+
+  passes.push_back({name, std::move(execute), {}, false});
+  return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+void RenderGraph::setImage(GraphResource resource, VkImage image, VkImageView view)
+{
+  if (!resources[resource].imported)
+    throw std::runtime_error("Only imported images can be replaced: " + resources[resource].name);
+  resources[resource].image = image;
+  resources[resource].view = view;
+}
+
+void RenderGraph::cull()
+{
+  // Backwards from the roots: a pass is needed when something needed reads what it writes
+  std::vector<bool> needed(resources.size(), false);
+  std::vector<bool> alive(passes.size(), false);
+
+  for (size_t i = passes.size(); i-- > 0;)
+  {
+    const Pass& pass = passes[i];
+    bool live = pass.sideEffect;
+    for (const Use& use : pass.uses)
+      if (use.write && (resources[use.resource].imported || needed[use.resource]))
+        live = true;
+    if (!live)
+      continue;
+
+    alive[i] = true;
+    for (const Use& use : pass.uses)
+      if (!use.write)
+        needed[use.resource] = true;
+  }
+
+  executed.clear();
+  for (uint32_t i = 0; i < passes.size(); i++)
+    if (alive[i])
+      executed.push_back(i);
+    else
+      std::cout << "Render graph: culled pass " << passes[i].name << std::endl;
+}
+
+// Lazily allocated memory type among typeBits, or UINT32_MAX
+static uint32_t findLazyMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits)
+{
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  const VkMemoryPropertyFlags lazy = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & lazy) == lazy)
+      return i;
+  return UINT32_MAX;
+}
+
+void RenderGraph::allocateTransients(bool alias)
+{
+  // 1. Resources with the usage of all their executed passes
+  std::vector<GraphResource> transients;
+  for (GraphResource i = 0; i < resources.size(); i++)
+  {
+    Resource& resource = resources[i];
+    if (resource.imported || resource.firstPass == UINT32_MAX)
+      continue;
+    transients.push_back(i);
+
+    if (resource.isImage)
+    {
+      // Attachments nothing else touches can stay in tile memory
+      if ((resource.imageUsage & ~ATTACHMENT_USAGE) == 0)
+        resource.imageUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+      VkImageCreateInfo imageInfo{};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+      imageInfo.mipLevels = resource.desc.mipLevels;
+      imageInfo.arrayLayers = 1;
+      imageInfo.format = resource.desc.format;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.usage = resource.imageUsage;
+      imageInfo.samples = resource.desc.samples;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create render graph image " + resource.name + "!");
+      vkGetImageMemoryRequirements(device, resource.image, &resource.requirements);
+    }
+    else
+    {
+      VkBufferCreateInfo bufferInfo{};
+      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferInfo.size = resource.size;
+      bufferInfo.usage = resource.bufferUsage;
+      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      if (vkCreateBuffer(device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create render graph buffer " + resource.name + "!");
+      vkGetBufferMemoryRequirements(device, resource.buffer, &resource.requirements);
+    }
+  }
+
+  // 2. Largest first, each into the first block whose users all live at other times. Every user
+  // of a block is bound at offset 0, the block is as large as its largest user
+  struct Block
+  {
+    uint32_t typeBits;
+    VkDeviceSize size;
+    std::vector<GraphResource> users;
+  };
+  std::vector<Block> blocks;
+
+  std::sort(transients.begin(), transients.end(), [this](GraphResource a, GraphResource b) {
+    return resources[a].requirements.size > resources[b].requirements.size;
+  });
+
+  auto bind = [this](GraphResource index, VkDeviceMemory memory) {
+    Resource& resource = resources[index];
+    VkResult result = resource.isImage ? vkBindImageMemory(device, resource.image, memory, 0) :
+      vkBindBufferMemory(device, resource.buffer, memory, 0);
+    if (result != VK_SUCCESS)
+      throw std::runtime_error("Failed to bind render graph memory for " + resource.name + "!");
+  };
+
+  unaliasedBytes = 0;
+  transientBytes = 0;
+  for (GraphResource index : transients)
+  {
+    Resource& resource = resources[index];
+    resource.previous = index;
+
+    if (resource.imageUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+    {
+      uint32_t lazyType = findLazyMemoryType(physicalDevice, resource.requirements.memoryTypeBits);
+      if (lazyType != UINT32_MAX)
+      {
+        // Never backed on tilers, nothing to gain from sharing it
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = resource.requirements.size;
+        allocInfo.memoryTypeIndex = lazyType;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+          throw std::runtime_error("Failed to allocate render graph memory!");
+        allocations.push_back(memory);
+        bind(index, memory);
+        continue;
+      }
+    }
+
+    unaliasedBytes += resource.requirements.size;
+    Block* target = nullptr;
+    for (Block& block : blocks)
+    {
+      if (!alias || (block.typeBits & resource.requirements.memoryTypeBits) == 0)
+        continue;
+      bool disjoint = std::all_of(block.users.begin(), block.users.end(), [&](GraphResource user) {
+        return resources[user].lastPass < resource.firstPass || resource.lastPass < resources[user].firstPass;
+      });
+      // Offset 0 has every alignment, only the size can grow
+      if (disjoint)
+      {
+        target = &block;
+        break;
+      }
+    }
+    if (!target)
+    {
+      blocks.push_back({resource.requirements.memoryTypeBits, 0, {}});
+      target = &blocks.back();
+    }
+    target->typeBits &= resource.requirements.memoryTypeBits;
+    target->size = std::max(target->size, resource.requirements.size);
+    target->users.push_back(index);
+  }
+
+  // 3. One allocation per block; in lifetime order every user follows the previous one, the first one
+  // follows the last of the previous frame
+  for (Block& block : blocks)
+  {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = block.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, block.typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+      throw std::runtime_error("Failed to allocate render graph memory!");
+    allocations.push_back(memory);
+    transientBytes += block.size;
+
+    std::sort(block.users.begin(), block.users.end(), [this](GraphResource a, GraphResource b) {
+      return resources[a].firstPass < resources[b].firstPass;
+    });
+    for (size_t i = 0; i < block.users.size(); i++)
+    {
+      bind(block.users[i], memory);
+      resources[block.users[i]].previous = block.users[(i + block.users.size() - 1) % block.users.size()];
+    }
+  }
+
+  // 4. Views over every mip level
+  for (GraphResource index : transients)
+  {
+    Resource& resource = resources[index];
+    if (!resource.isImage)
+      continue;
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = resource.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = resource.desc.format;
+    viewInfo.subresourceRange = {resource.desc.aspect, 0, resource.desc.mipLevels, 0, 1};
+
+    if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS)
+      throw std::runtime_error("Failed to create render graph view " + resource.name + "!");
+  }
+}
+
+void RenderGraph::replay(std::vector<Tracker>& trackers, std::vector<Batch>& output) const
+{
+  // The end state of a transient's predecessor is only known after a first replay, trackers carries it over
+  const std::vector<Tracker> previousFrame = trackers;
+
+  for (GraphResource i = 0; i < resources.size(); i++)
+  {
+    const Resource& resource = resources[i];
+    Tracker& tracker = trackers[i];
+    if (resource.isImage && resource.imported)
+      tracker = {true, resource.initial.layout, resource.initial.stages, resource.initial.access, 0, 0};
+    else if (resource.imported)
+      tracker.used = true;
+    else
+      tracker = {false, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0};
+  }
+
+  output.assign(executed.size() + 1, {});
+  for (Batch& batch : output)
+  {
+    batch.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    batch.empty = true;
+  }
+
+  auto imageBarrier = [this](Batch& batch, GraphResource index, VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    // Every mip and layer, e.g. all cascades of an imported shadow map
+    barrier.subresourceRange = {
+      resources[index].desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+    };
+    batch.images.push_back(barrier);
+    batch.imageResources.push_back(index);
+  };
+
+  for (uint32_t step = 0; step < executed.size(); step++)
+  {
+    const Pass& pass = passes[executed[step]];
+    Batch& batch = output[step];
+
+    // Uses of one resource within a pass are merged, they must agree on the layout
+    std::vector<GraphResource> seen;
+    for (const Use& first : pass.uses)
+    {
+      if (std::find(seen.begin(), seen.end(), first.resource) != seen.end())
+        continue;
+      seen.push_back(first.resource);
+
+      const Resource& resource = resources[first.resource];
+      VkPipelineStageFlags stages = 0;
+      VkAccessFlags access = 0;
+      VkImageLayout layout = accessInfo(first.access).layout;
+      bool write = false;
+      for (const Use& use : pass.uses)
+      {
+        if (use.resource != first.resource)
+          continue;
+        const AccessInfo& info = accessInfo(use.access);
+        if (resource.isImage && info.layout != layout)
+          throw std::runtime_error("Pass " + pass.name + " uses " + resource.name + " in two layouts!");
+        stages |= info.stages;
+        access |= info.read | (use.write ? info.write : 0);
+        write = write || use.write;
+      }
+
+      Tracker& tracker = trackers[first.resource];
+      VkAccessFlags writeAccess = write ? access & (
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+      ) : 0;
+
+      if (!tracker.used)
+      {
+        // First use of a transient: its memory was last used by its predecessor, in this frame or the last
+        const Tracker& previous = previousFrame[resource.previous];
+        VkPipelineStageFlags srcStages = previous.writeStages | previous.readStages;
+        batch.srcStages |= srcStages;
+        batch.dstStages |= stages;
+        batch.empty = false;
+        if (resource.isImage)
+          imageBarrier(batch, first.resource, VK_IMAGE_LAYOUT_UNDEFINED, layout, previous.writeAccess, access);
+        else
+        {
+          batch.memory.srcAccessMask |= previous.writeAccess;
+          batch.memory.dstAccessMask |= access;
+        }
+        tracker = {true, layout, stages, writeAccess, write ? 0 : stages, write ? 0 : stages};
+      }
+      else if (resource.isImage && tracker.layout != layout)
+      {
+        // Layout transitions order against every earlier use and are visible to the stages they wait for
+        batch.srcStages |= tracker.writeStages | tracker.readStages;
+        batch.dstStages |= stages;
+        batch.empty = false;
+        imageBarrier(batch, first.resource, tracker.layout, layout, tracker.writeAccess, access);
+        tracker = {true, layout, stages, writeAccess, write ? 0 : stages, write ? 0 : stages};
+      }
+      else if (write)
+      {
+        // Write after write or read: the earlier accesses finish first
+        VkPipelineStageFlags srcStages = tracker.writeStages | tracker.readStages;
+        if (srcStages != 0)
+        {
+          batch.srcStages |= srcStages;
+          batch.dstStages |= stages;
+          batch.memory.srcAccessMask |= tracker.writeAccess;
+          batch.memory.dstAccessMask |= tracker.writeAccess != 0 ? access : 0;
+          batch.empty = false;
+        }
+        tracker.writeStages = stages;
+        tracker.writeAccess = writeAccess;
+        tracker.readStages = 0;
+        tracker.visibleStages = 0;
+      }
+      else
+      {
+        // Read after write, unless an earlier read at the same stages already waited for it
+        if (tracker.writeStages != 0 && (stages & ~tracker.visibleStages) != 0)
+        {
+          batch.srcStages |= tracker.writeStages;
+          batch.dstStages |= stages;
+          batch.memory.srcAccessMask |= tracker.writeAccess;
+          batch.memory.dstAccessMask |= tracker.writeAccess != 0 ? access : 0;
+          batch.empty = false;
+          tracker.visibleStages |= stages;
+        }
+        tracker.readStages |= stages;
+      }
+    }
+  }
+
+  // Imported images end in the layout the code after the graph expects, e.g. PRESENT_SRC
+  Batch& last = output.back();
+  for (GraphResource i = 0; i < resources.size(); i++)
+  {
+    const Resource& resource = resources[i];
+    const Tracker& tracker = trackers[i];
+    if (
+      !resource.isImage || !resource.imported || resource.final.layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+      tracker.layout == resource.final.layout
+    )
+      continue;
+
+    last.srcStages |= tracker.writeStages | tracker.readStages;
+    last.dstStages |= resource.final.stages;
+    last.empty = false;
+    imageBarrier(last, i, tracker.layout, resource.final.layout, tracker.writeAccess, resource.final.access);
+  }
+}
+
+void RenderGraph::compile(bool alias)
+{
+  if (compiled)
+    throw std::runtime_error("Render graph is already compiled!");
+  compiled = true;
+
+  // 1. Passes that matter
+  cull();
+
+  // 2. Lifetimes and usage over the executed passes
+  for (Resource& resource : resources)
+  {
+    resource.firstPass = UINT32_MAX;
+    resource.lastPass = 0;
+  }
+  for (uint32_t step = 0; step < executed.size(); step++)
+    for (const Use& use : passes[executed[step]].uses)
+    {
+      Resource& resource = resources[use.resource];
+      resource.firstPass = std::min(resource.firstPass, step);
+      resource.lastPass = std::max(resource.lastPass, step);
+      resource.imageUsage |= accessInfo(use.access).imageUsage;
+      resource.bufferUsage |= accessInfo(use.access).bufferUsage;
+    }
+
+  // 3. Memory
+  allocateTransients(alias);
+
+  // 4. Barriers: the first replay finds where every resource ends up, which is where the second
+  // one starts the transients' successors and the imported buffers
+  std::vector<Tracker> trackers(resources.size(), Tracker{});
+  replay(trackers, batches);
+  replay(trackers, batches);
+
+  uint32_t barrierCount = 0;
+  for (const Batch& batch : batches)
+    barrierCount += batch.empty ? 0 : 1;
+
+  std::cout << "Render graph: " << executed.size() << " of " << passes.size() << " passes, "
+            << barrierCount << " barrier batches, transient memory " << transientBytes / (1024.0 * 1024.0)
+            << " MB (" << unaliasedBytes / (1024.0 * 1024.0) << " MB without aliasing)" << std::endl;
+}
+
+void RenderGraph::recordBatch(VkCommandBuffer commandBuffer, Batch& batch) const
+{
+  if (batch.empty)
+    return;
+
+  for (size_t i = 0; i < batch.images.size(); i++)
+    batch.images[i].image = resources[batch.imageResources[i]].image;
+
+  bool memory = batch.memory.srcAccessMask != 0 || batch.memory.dstAccessMask != 0;
+  vkCmdPipelineBarrier(
+    commandBuffer,
+    batch.srcStages != 0 ? batch.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    batch.dstStages != 0 ? batch.dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+    0, memory ? 1 : 0, &batch.memory, 0, nullptr,
+    static_cast<uint32_t>(batch.images.size()), batch.images.data()
+  );
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+  if (!compiled)
+    throw std::runtime_error("Render graph must be compiled before it is executed!");
+
+  for (uint32_t step = 0; step < executed.size(); step++)
+  {
+    recordBatch(commandBuffer, batches[step]);
+    passes[executed[step]].execute(commandBuffer);
+  }
+  recordBatch(commandBuffer, batches.back());
+}
@@ -0,0 +1,99 @@
+#include "render_target.hpp"
+
+#include <iostream>
+
+// Lazily allocated memory type if the image may use one, otherwise plain device-local memory
+static uint32_t findAttachmentMemoryType(
+  VkPhysicalDevice physicalDevice, uint32_t typeBits, bool transient, bool& lazilyAllocated
+) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  const VkMemoryPropertyFlags lazy = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  lazilyAllocated = false;
+
+  if (transient)
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+      if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & lazy) == lazy)
+      {
+        lazilyAllocated = true;
+        return i;
+      }
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    if (
+      (typeBits & (1 << i)) &&
+      (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    )
+      return i;
+
+  throw std::runtime_error("Failed to find memory type for render target!");
+}
+
+RenderTarget::RenderTarget(
+  VkPhysicalDevice physicalDevice, VkDevice dev, VkFormat imageFormat, VkExtent2D size,
+  VkSampleCountFlagBits sampleCount, VkImageUsageFlags usage, VkImageAspectFlags aspectMask
+) : device(dev), image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE),
+    format(imageFormat), extent(size), samples(sampleCount), lazilyAllocated(false)
+{
+  // 1. Image
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = samples;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create render target image!");
+
+  // 2. Memory
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = findAttachmentMemoryType(
+    physicalDevice, memRequirements.memoryTypeBits, (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0, lazilyAllocated
+  );
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate render target memory!");
+
+  vkBindImageMemory(device, image, memory, 0);
+
+  // 3. View
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange.aspectMask = aspectMask;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create render target view!");
+
+  std::cout << "Render target created: " << extent.width << "x" << extent.height << ", " << samples
+            << "x samples" << (lazilyAllocated ? ", lazily allocated" : "") << std::endl;
+}
+
+RenderTarget::~RenderTarget()
+{
+  if (imageView != VK_NULL_HANDLE)
+    vkDestroyImageView(device, imageView, nullptr);
+  if (image != VK_NULL_HANDLE)
+    vkDestroyImage(device, image, nullptr);
+  if (memory != VK_NULL_HANDLE)
+    vkFreeMemory(device, memory, nullptr);
+}
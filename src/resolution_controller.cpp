@@ -0,0 +1,69 @@
+#include "resolution_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Exponential smoothing of the measured frame time
+static const float SMOOTHING = 0.1f;
+// Scale down when over target, up only when under 80% of it
+static const float UP_THRESHOLD = 0.8f;
+static const uint32_t DOWN_FRAMES = 8;
+static const uint32_t UP_FRAMES = 60;
+// Frames to let the smoothed time settle after a change
+static const uint32_t COOLDOWN_FRAMES = 30;
+// Largest single step down and the fixed step up
+static const float MAX_DOWN_FACTOR = 0.75f;
+static const float UP_STEP = 0.05f;
+// Ignore changes that would not move the extent noticeably
+static const float MIN_CHANGE = 0.01f;
+
+ResolutionController::ResolutionController(float target, float minimum, float maximum)
+  : targetMilliseconds(target), minScale(minimum), maxScale(maximum), scale(maximum), smoothedMilliseconds(0.0f),
+    overBudgetFrames(0), underBudgetFrames(0), cooldownFrames(0)
+{
+}
+
+bool ResolutionController::update(float frameMilliseconds)
+{
+  if (smoothedMilliseconds == 0.0f)
+    smoothedMilliseconds = frameMilliseconds;
+  else
+    smoothedMilliseconds += (frameMilliseconds - smoothedMilliseconds) * SMOOTHING;
+
+  if (cooldownFrames > 0)
+  {
+    cooldownFrames--;
+    return false;
+  }
+
+  overBudgetFrames = smoothedMilliseconds > targetMilliseconds ? overBudgetFrames + 1 : 0;
+  underBudgetFrames = smoothedMilliseconds < targetMilliseconds * UP_THRESHOLD ? underBudgetFrames + 1 : 0;
+
+  float newScale = scale;
+  if (overBudgetFrames >= DOWN_FRAMES)
+  {
+    // GPU time is roughly proportional to the pixel count, i.e. to scale squared
+    float factor = std::sqrt(targetMilliseconds * UP_THRESHOLD / smoothedMilliseconds);
+    newScale = scale * std::max(factor, MAX_DOWN_FACTOR);
+  }
+  else if (underBudgetFrames >= UP_FRAMES)
+    newScale = scale + UP_STEP;
+
+  newScale = std::clamp(newScale, minScale, maxScale);
+  if (std::abs(newScale - scale) < MIN_CHANGE)
+    return false;
+
+  scale = newScale;
+  overBudgetFrames = 0;
+  underBudgetFrames = 0;
+  cooldownFrames = COOLDOWN_FRAMES;
+  return true;
+}
+
+VkExtent2D ResolutionController::getExtent(VkExtent2D maxExtent) const
+{
+  return {
+    std::clamp(static_cast<uint32_t>(maxExtent.width * scale), 1u, maxExtent.width),
+    std::clamp(static_cast<uint32_t>(maxExtent.height * scale), 1u, maxExtent.height)
+  };
+}
@@ -0,0 +1,127 @@
+#include "settings.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+static const std::pair<const char*, VkPresentModeKHR> PRESENT_MODES[] =
+{
+  {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+  {"fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+  {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+  {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR}
+};
+
+static const std::pair<const char*, CaptureFormat> CAPTURE_FORMATS[] =
+{
+  {"png", CaptureFormat::Png},
+  {"y4m", CaptureFormat::Y4m},
+  {"rgb", CaptureFormat::Rgb}
+};
+
+static bool readEnv(const char* name, unsigned long long& value)
+{
+  const char* text = std::getenv(name);
+  if (!text)
+    return false;
+
+  try
+  {
+    value = std::stoull(text);
+    return true;
+  } catch (const std::exception&)
+  {
+    std::cerr << "Ignoring invalid " << name << "=" << text << std::endl;
+    return false;
+  }
+}
+
+RenderSettings RenderSettings::fromEnvironment()
+{
+  RenderSettings settings;
+  unsigned long long value;
+
+  if (readEnv("HERTRA_TEXTURE_BUDGET_MB", value))
+    settings.textureBudget = value * 1024 * 1024;
+  if (readEnv("HERTRA_TEXTURE_INITIAL_SIZE", value))
+    settings.textureInitialSize = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_LIGHTS", value))
+    settings.lightCount = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_SHADOW_SIZE", value))
+    settings.shadowMapSize = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_SHADOW_FILTER", value))
+    settings.shadowFilterSize = static_cast<uint32_t>(std::min(value, 8ull));
+  if (readEnv("HERTRA_DEPTH_PREPASS", value))
+    settings.depthPrepass = value != 0;
+  if (readEnv("HERTRA_MSAA", value))
+    settings.msaaSamples = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_DYNAMIC_RESOLUTION", value))
+    settings.dynamicResolution = value != 0;
+  if (readEnv("HERTRA_TARGET_FRAME_US", value))
+    settings.targetFrameTime = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_MIN_RENDER_SCALE", value))
+    settings.minRenderScale = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_OCCLUSION_CULLING", value))
+    settings.occlusionCulling = value != 0;
+  if (readEnv("HERTRA_CITY_SIZE", value))
+    settings.cityGridSize = static_cast<uint32_t>(value);
+  if (readEnv("HERTRA_DEFERRED", value))
+    settings.deferred = value != 0;
+  if (readEnv("HERTRA_POST_PROCESS", value))
+    settings.postProcess = value != 0;
+  if (readEnv("HERTRA_DYNAMIC_RENDERING", value))
+    settings.dynamicRendering = value != 0;
+  if (readEnv("HERTRA_SIMULATION_THREAD", value))
+    settings.simulationThread = value != 0;
+  if (readEnv("HERTRA_SIMULATION_HZ", value))
+    settings.simulationRate = static_cast<uint32_t>(std::clamp(value, 1ull, 10000ull));
+  if (readEnv("HERTRA_FRAMES_IN_FLIGHT", value))
+    settings.framesInFlight = static_cast<uint32_t>(std::clamp(value, 1ull, 4ull));
+  if (readEnv("HERTRA_TIMELINE_SEMAPHORES", value))
+    settings.timelineSemaphores = value != 0;
+  if (readEnv("HERTRA_ASYNC_COMPUTE", value))
+    settings.asyncCompute = value != 0;
+  if (const char* mode = std::getenv("HERTRA_PRESENT_MODE"))
+  {
+    auto found = std::find_if(std::begin(PRESENT_MODES), std::end(PRESENT_MODES), [mode](const auto& entry) {
+      return std::string(entry.first) == mode;
+    });
+    if (found != std::end(PRESENT_MODES))
+      settings.presentMode = found->second;
+    else
+      std::cerr << "Ignoring invalid HERTRA_PRESENT_MODE=" << mode << std::endl;
+  }
+  if (readEnv("HERTRA_FPS_LIMIT", value))
+    settings.frameRateLimit = static_cast<uint32_t>(std::min(value, 1000ull));
+  if (readEnv("HERTRA_PRESENT_WAIT", value))
+    settings.presentWait = value != 0;
+  if (readEnv("HERTRA_LATE_LATCH", value))
+    settings.lateLatch = value != 0;
+  if (readEnv("HERTRA_ARENA_POISON", value))
+    settings.arenaPoison = value != 0;
+  if (const char* output = std::getenv("HERTRA_CAPTURE"))
+    settings.captureOutput = output;
+  if (const char* format = std::getenv("HERTRA_CAPTURE_FORMAT"))
+  {
+    auto found = std::find_if(std::begin(CAPTURE_FORMATS), std::end(CAPTURE_FORMATS), [format](const auto& entry) {
+      return std::string(entry.first) == format;
+    });
+    if (found != std::end(CAPTURE_FORMATS))
+      settings.captureFormat = found->second;
+    else
+      std::cerr << "Ignoring invalid HERTRA_CAPTURE_FORMAT=" << format << std::endl;
+  }
+  if (readEnv("HERTRA_CAPTURE_EVERY", value))
+    settings.captureInterval = static_cast<uint32_t>(std::clamp(value, 1ull, 1000000ull));
+  if (readEnv("HERTRA_HEADLESS", value))
+    settings.headlessFrames = static_cast<uint32_t>(std::min(value, 0xFFFFFFFFull));
+  if (readEnv("HERTRA_PIPELINE_STATISTICS", value))
+    settings.pipelineStatistics = value != 0;
+  if (readEnv("HERTRA_TRANSIENT_ALIASING", value))
+    settings.transientAliasing = value != 0;
+  if (const char* directory = std::getenv("HERTRA_SHADER_DIR"))
+    settings.shaderDirectory = directory;
+
+  return settings;
+}
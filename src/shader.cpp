@@ -1,11 +1,29 @@
 #include "shader.hpp"
+#include "embedded_shaders.hpp"
 
+#include <bit>
+#include <filesystem>
 #include <fstream>
+#include <map>
 #include <stdexcept>
 #include <iostream>
 
-static std::vector<char> readFile(const std::string& filename)
+static std::string overrideDirectory;
+// Owns the code of every shader read from disk
+static std::map<std::string, std::vector<uint32_t>> loadedShaders;
+
+void setShaderOverrideDirectory(const std::string& directory)
 {
+  overrideDirectory = directory;
+}
+
+// Reads a SPIR-V binary and checks its magic number
+static std::span<const uint32_t> readShaderFile(const std::string& filename)
+{
+  auto cached = loadedShaders.find(filename);
+  if (cached != loadedShaders.end())
+    return cached->second;
+
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
   if (!file.is_open())
@@ -13,41 +31,94 @@ static std::vector<char> readFile(const std::string& filename)
   size_t fileSize = (size_t)file.tellg();
   if (fileSize == 0)
     throw std::runtime_error("Shader file is empty: " + filename);
+  if (fileSize % sizeof(uint32_t) != 0)
+    throw std::runtime_error("Shader file is not a whole number of words: " + filename);
 
-  std::vector<char> buffer(fileSize);
+  std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
 
   file.seekg(0);
-  file.read(buffer.data(), fileSize);
+  file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
   file.close();
 
+  // Проверка magic number SPIR-V
+  if (buffer[0] != 0x07230203) {
+    std::cerr << "WARNING: Invalid SPIR-V magic number in " << filename << std::endl;
+    std::cerr << "Expected: 0x07230203, Got: 0x" << std::hex << buffer[0] << std::dec << std::endl;
+  }
+
   std::cout << "Loaded shader: " << filename << " (" << fileSize << " bytes)" << std::endl;
+  return loadedShaders.emplace(filename, std::move(buffer)).first->second;
+}
 
-  // Проверка magic number SPIR-V
-  if (fileSize < 4)
-    throw std::runtime_error("Shader file too small: " + filename);
+std::span<const uint32_t> loadShaderCode(const std::string& path)
+{
+  std::string name = std::filesystem::path(path).filename().string();
 
-  uint32_t magic = *reinterpret_cast<uint32_t*>(buffer.data());
-  if (magic != 0x07230203) {
-    std::cerr << "WARNING: Invalid SPIR-V magic number in " << filename << std::endl;
-    std::cerr << "Expected: 0x07230203, Got: 0x" << std::hex << magic << std::dec << std::endl;
+  if (!overrideDirectory.empty())
+  {
+    auto overridePath = std::filesystem::path(overrideDirectory) / name;
+    if (std::filesystem::exists(overridePath))
+      return readShaderFile(overridePath.string());
   }
 
-  return buffer;
+#ifdef HERTRA_EMBEDDED_SHADERS
+  for (size_t i = 0; i < embeddedShaderCount; i++)
+    if (name == embeddedShaders[i].name)
+      return {embeddedShaders[i].code, embeddedShaders[i].wordCount};
+#endif
+
+  // Built without glslc: the binaries next to the working directory
+  return readShaderFile(path);
 }
 
-Shader::Shader(VkDevice dev, const std::string& vertPath, const std::string& fragPath)
-  : device(dev)
+SpecializationConstants& SpecializationConstants::set(uint32_t id, uint32_t value)
 {
-  auto vertCode = readFile(vertPath);
-  auto fragCode = readFile(fragPath);
+  values[id] = value;
+  return *this;
+}
 
-  std::cout << "Creating vertex shader module..." << std::endl;
-  vertShaderModule = createShaderModule(vertCode);
-  std::cout << "Vertex shader module created: " << vertShaderModule << std::endl;
+SpecializationConstants& SpecializationConstants::set(uint32_t id, float value)
+{
+  return set(id, std::bit_cast<uint32_t>(value));
+}
+
+SpecializationConstants& SpecializationConstants::set(uint32_t id, bool value)
+{
+  return set(id, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+}
+
+SpecializationConstants SpecializationConstants::merged(const SpecializationConstants& other) const
+{
+  SpecializationConstants result = other;
+  result.values.insert(values.begin(), values.end());
+  return result;
+}
+
+SpecializationInfo::SpecializationInfo(const SpecializationConstants& constants) : info{}
+{
+  for (const auto& [id, value] : constants.values)
+  {
+    entries.push_back({id, static_cast<uint32_t>(data.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+    data.push_back(value);
+  }
+
+  info.mapEntryCount = static_cast<uint32_t>(entries.size());
+  info.pMapEntries = entries.data();
+  info.dataSize = data.size() * sizeof(uint32_t);
+  info.pData = data.data();
+}
 
-  std::cout << "Creating fragment shader module..." << std::endl;
+Shader::Shader(
+  VkDevice dev, const std::string& vertPath, const std::string& fragPath, const SpecializationConstants& constants
+) : device(dev), constants(constants), specialization(constants)
+{
+  auto vertCode = loadShaderCode(vertPath);
+  auto fragCode = loadShaderCode(fragPath);
+  vertShaderModule = createShaderModule(vertCode);
   fragShaderModule = createShaderModule(fragCode);
-  std::cout << "Fragment shader module created: " << fragShaderModule << std::endl;
+
+  reflection = ShaderReflection(vertCode);
+  reflection.merge(ShaderReflection(fragCode));
 
   vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -55,7 +126,7 @@ Shader::Shader(VkDevice dev, const std::string& vertPath, const std::string& fra
   vertShaderStageInfo.pName = "main";
   vertShaderStageInfo.flags = 0;
   vertShaderStageInfo.pNext = nullptr;
-  vertShaderStageInfo.pSpecializationInfo = nullptr;
+  vertShaderStageInfo.pSpecializationInfo = specialization.get();
 
   fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -63,9 +134,7 @@ Shader::Shader(VkDevice dev, const std::string& vertPath, const std::string& fra
   fragShaderStageInfo.pName = "main";
   fragShaderStageInfo.flags = 0;
   fragShaderStageInfo.pNext = nullptr;
-  fragShaderStageInfo.pSpecializationInfo = nullptr;
-
-  std::cout << "Shader stages configured" << std::endl;
+  fragShaderStageInfo.pSpecializationInfo = specialization.get();
 }
 
 Shader::~Shader()
@@ -76,12 +145,12 @@ Shader::~Shader()
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 
-VkShaderModule Shader::createShaderModule(const std::vector<char>& code)
+VkShaderModule Shader::createShaderModule(std::span<const uint32_t> code)
 {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  createInfo.codeSize = code.size_bytes();
+  createInfo.pCode = code.data();
 
   VkShaderModule shaderModule;
   if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
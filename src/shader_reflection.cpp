@@ -0,0 +1,395 @@
+#include "shader_reflection.hpp"
+#include "shader.hpp"
+
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+
+// The part of the SPIR-V specification describing the resource interface
+enum : uint32_t
+{
+  SPIRV_MAGIC = 0x07230203,
+  SPIRV_HEADER_WORDS = 5,
+
+  OP_ENTRY_POINT = 15,
+  OP_TYPE_BOOL = 20,
+  OP_TYPE_INT = 21,
+  OP_TYPE_FLOAT = 22,
+  OP_TYPE_VECTOR = 23,
+  OP_TYPE_MATRIX = 24,
+  OP_TYPE_IMAGE = 25,
+  OP_TYPE_SAMPLER = 26,
+  OP_TYPE_SAMPLED_IMAGE = 27,
+  OP_TYPE_ARRAY = 28,
+  OP_TYPE_RUNTIME_ARRAY = 29,
+  OP_TYPE_STRUCT = 30,
+  OP_TYPE_POINTER = 32,
+  OP_CONSTANT = 43,
+  OP_SPEC_CONSTANT = 50,
+  OP_VARIABLE = 59,
+  OP_DECORATE = 71,
+  OP_MEMBER_DECORATE = 72,
+
+  DECORATION_BUFFER_BLOCK = 3,
+  DECORATION_ARRAY_STRIDE = 6,
+  DECORATION_MATRIX_STRIDE = 7,
+  DECORATION_BUILT_IN = 11,
+  DECORATION_LOCATION = 30,
+  DECORATION_BINDING = 33,
+  DECORATION_DESCRIPTOR_SET = 34,
+  DECORATION_OFFSET = 35,
+
+  STORAGE_UNIFORM_CONSTANT = 0,
+  STORAGE_INPUT = 1,
+  STORAGE_UNIFORM = 2,
+  STORAGE_PUSH_CONSTANT = 9,
+  STORAGE_STORAGE_BUFFER = 12,
+
+  DIM_BUFFER = 5,
+  DIM_SUBPASS_DATA = 6,
+
+  NO_DECORATION = ~0u
+};
+
+// Everything known about one result id
+struct SpirvId
+{
+  uint32_t opcode = 0;
+  std::span<const uint32_t> operands;  // the words after the opcode
+  uint32_t set = 0;
+  uint32_t binding = NO_DECORATION;
+  uint32_t location = NO_DECORATION;
+  uint32_t arrayStride = 0;
+  bool bufferBlock = false;
+  bool builtIn = false;
+};
+
+struct SpirvMember
+{
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+};
+
+using SpirvMembers = std::unordered_map<uint32_t, std::vector<SpirvMember>>;
+
+static uint32_t constantValue(const std::vector<SpirvId>& ids, uint32_t id)
+{
+  const SpirvId& constant = ids[id];
+  if (constant.opcode != OP_CONSTANT && constant.opcode != OP_SPEC_CONSTANT)
+    throw std::runtime_error("Unsupported array length in shader!");
+  return constant.operands[2];
+}
+
+// Bytes of a type in a block, matrices are column major as in every shader here
+static uint32_t typeSize(
+  const std::vector<SpirvId>& ids, const SpirvMembers& members, uint32_t type, uint32_t matrixStride
+) {
+  const SpirvId& id = ids[type];
+  switch (id.opcode)
+  {
+    case OP_TYPE_BOOL:
+      return sizeof(uint32_t);
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+      return id.operands[1] / 8;
+    case OP_TYPE_VECTOR:
+      return typeSize(ids, members, id.operands[1], 0) * id.operands[2];
+    case OP_TYPE_MATRIX:
+      return matrixStride * id.operands[2];
+    case OP_TYPE_ARRAY:
+      return id.arrayStride * constantValue(ids, id.operands[2]);
+    case OP_TYPE_RUNTIME_ARRAY:
+      return 0;
+    case OP_TYPE_STRUCT:
+    {
+      auto decorations = members.find(type);
+      uint32_t size = 0;
+      for (size_t i = 1; i < id.operands.size(); i++)
+      {
+        SpirvMember member{};
+        if (decorations != members.end() && i - 1 < decorations->second.size())
+          member = decorations->second[i - 1];
+        size = std::max(size, member.offset + typeSize(ids, members, id.operands[i], member.matrixStride));
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("Unsupported type in shader block!");
+  }
+}
+
+static VkFormat inputFormat(const std::vector<SpirvId>& ids, uint32_t type)
+{
+  uint32_t components = 1;
+  if (ids[type].opcode == OP_TYPE_VECTOR)
+  {
+    components = ids[type].operands[2];
+    type = ids[type].operands[1];
+  }
+
+  const SpirvId& scalar = ids[type];
+  if (scalar.opcode == OP_TYPE_FLOAT && scalar.operands[1] == 32)
+  {
+    const VkFormat formats[] = {
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+    };
+    return formats[components - 1];
+  }
+  if (scalar.opcode == OP_TYPE_INT && scalar.operands[1] == 32)
+  {
+    const VkFormat signedFormats[] = {
+      VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+    };
+    const VkFormat unsignedFormats[] = {
+      VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+    };
+    return scalar.operands[2] ? signedFormats[components - 1] : unsignedFormats[components - 1];
+  }
+  throw std::runtime_error("Unsupported vertex input type in shader!");
+}
+
+static bool bindingOrder(const ShaderReflection::Binding& a, const ShaderReflection::Binding& b)
+{
+  return std::tie(a.set, a.layout.binding) < std::tie(b.set, b.layout.binding);
+}
+
+ShaderReflection::ShaderReflection() : stages(0), pushConstants{}
+{
+}
+
+ShaderReflection::ShaderReflection(std::span<const uint32_t> code) : stages(0), pushConstants{}
+{
+  if (code.size() < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC)
+    throw std::runtime_error("Failed to reflect shader: not SPIR-V!");
+
+  // 1. Index every instruction by its result id, with the decorations applied to it
+  std::vector<SpirvId> ids(code[3]);
+  SpirvMembers members;
+  std::vector<uint32_t> variables;
+
+  for (size_t word = SPIRV_HEADER_WORDS; word < code.size();)
+  {
+    uint32_t opcode = code[word] & 0xffff;
+    uint32_t wordCount = code[word] >> 16;
+    if (wordCount == 0 || word + wordCount > code.size())
+      throw std::runtime_error("Failed to reflect shader: truncated instruction!");
+    std::span<const uint32_t> operands = code.subspan(word + 1, wordCount - 1);
+    word += wordCount;
+
+    switch (opcode)
+    {
+      case OP_ENTRY_POINT:
+      {
+        const VkShaderStageFlagBits models[] = {
+          VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+          VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, VK_SHADER_STAGE_GEOMETRY_BIT,
+          VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_COMPUTE_BIT
+        };
+        if (operands[0] < std::size(models))
+          stages |= models[operands[0]];
+        break;
+      }
+      case OP_DECORATE:
+      {
+        SpirvId& target = ids[operands[0]];
+        uint32_t literal = operands.size() > 2 ? operands[2] : 0;
+        switch (operands[1])
+        {
+          case DECORATION_BUFFER_BLOCK: target.bufferBlock = true; break;
+          case DECORATION_ARRAY_STRIDE: target.arrayStride = literal; break;
+          case DECORATION_BUILT_IN: target.builtIn = true; break;
+          case DECORATION_LOCATION: target.location = literal; break;
+          case DECORATION_BINDING: target.binding = literal; break;
+          case DECORATION_DESCRIPTOR_SET: target.set = literal; break;
+        }
+        break;
+      }
+      case OP_MEMBER_DECORATE:
+      {
+        auto& structMembers = members[operands[0]];
+        if (structMembers.size() <= operands[1])
+          structMembers.resize(operands[1] + 1);
+        if (operands[2] == DECORATION_OFFSET)
+          structMembers[operands[1]].offset = operands[3];
+        else if (operands[2] == DECORATION_MATRIX_STRIDE)
+          structMembers[operands[1]].matrixStride = operands[3];
+        break;
+      }
+      case OP_TYPE_BOOL:
+      case OP_TYPE_INT:
+      case OP_TYPE_FLOAT:
+      case OP_TYPE_VECTOR:
+      case OP_TYPE_MATRIX:
+      case OP_TYPE_IMAGE:
+      case OP_TYPE_SAMPLER:
+      case OP_TYPE_SAMPLED_IMAGE:
+      case OP_TYPE_ARRAY:
+      case OP_TYPE_RUNTIME_ARRAY:
+      case OP_TYPE_STRUCT:
+      case OP_TYPE_POINTER:
+        ids[operands[0]].opcode = opcode;
+        ids[operands[0]].operands = operands;
+        break;
+      case OP_CONSTANT:
+      case OP_SPEC_CONSTANT:
+      case OP_VARIABLE:
+        ids[operands[1]].opcode = opcode;
+        ids[operands[1]].operands = operands;
+        if (opcode == OP_VARIABLE)
+          variables.push_back(operands[1]);
+        break;
+    }
+  }
+
+  // 2. Global variables: descriptors, the push constant block and vertex inputs
+  for (uint32_t variableId : variables)
+  {
+    const SpirvId& variable = ids[variableId];
+    uint32_t storage = variable.operands[2];
+    uint32_t type = ids[variable.operands[0]].operands[2];  // pointee of the pointer type
+
+    if (storage == STORAGE_PUSH_CONSTANT)
+    {
+      pushConstants.stageFlags = stages;
+      pushConstants.offset = 0;
+      pushConstants.size = typeSize(ids, members, type, 0);
+      continue;
+    }
+
+    if (storage == STORAGE_INPUT)
+    {
+      if ((stages & VK_SHADER_STAGE_VERTEX_BIT) && !variable.builtIn && variable.location != NO_DECORATION)
+      {
+        VkVertexInputAttributeDescription input{};
+        input.location = variable.location;
+        input.format = inputFormat(ids, type);
+        vertexInputs.push_back(input);
+      }
+      continue;
+    }
+
+    if (storage != STORAGE_UNIFORM_CONSTANT && storage != STORAGE_UNIFORM && storage != STORAGE_STORAGE_BUFFER)
+      continue;
+    if (variable.binding == NO_DECORATION)
+      continue;
+
+    // Arrays of descriptors
+    uint32_t count = 1;
+    while (ids[type].opcode == OP_TYPE_ARRAY)
+    {
+      count *= constantValue(ids, ids[type].operands[2]);
+      type = ids[type].operands[1];
+    }
+    if (ids[type].opcode == OP_TYPE_RUNTIME_ARRAY)
+      throw std::runtime_error("Unbounded descriptor arrays are not supported!");
+
+    Binding binding{};
+    binding.set = variable.set;
+    binding.layout.binding = variable.binding;
+    binding.layout.descriptorCount = count;
+    binding.layout.stageFlags = stages;
+
+    const SpirvId& resource = ids[type];
+    if (storage == STORAGE_UNIFORM || storage == STORAGE_STORAGE_BUFFER)
+    {
+      // GLSL buffer blocks are Uniform + BufferBlock in SPIR-V 1.0
+      bool storageBuffer = storage == STORAGE_STORAGE_BUFFER || resource.bufferBlock;
+      binding.layout.descriptorType =
+        storageBuffer ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      binding.blockSize = typeSize(ids, members, type, 0);
+    }
+    else if (resource.opcode == OP_TYPE_SAMPLED_IMAGE)
+      binding.layout.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    else if (resource.opcode == OP_TYPE_SAMPLER)
+      binding.layout.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    else if (resource.opcode == OP_TYPE_IMAGE)
+    {
+      uint32_t dim = resource.operands[2];
+      bool storageImage = resource.operands[6] == 2;
+      if (dim == DIM_SUBPASS_DATA)
+        binding.layout.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      else if (dim == DIM_BUFFER)
+        binding.layout.descriptorType =
+          storageImage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      else
+        binding.layout.descriptorType =
+          storageImage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    else
+      throw std::runtime_error("Unsupported descriptor type in shader!");
+
+    bindings.push_back(binding);
+  }
+
+  std::sort(bindings.begin(), bindings.end(), bindingOrder);
+  std::sort(vertexInputs.begin(), vertexInputs.end(), [](const auto& a, const auto& b) {
+    return a.location < b.location;
+  });
+}
+
+ShaderReflection ShaderReflection::fromFiles(const std::vector<std::string>& paths)
+{
+  ShaderReflection reflection;
+  for (const auto& path : paths)
+    reflection.merge(ShaderReflection(loadShaderCode(path)));
+  return reflection;
+}
+
+void ShaderReflection::merge(const ShaderReflection& other)
+{
+  stages |= other.stages;
+
+  for (const Binding& binding : other.bindings)
+  {
+    auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const Binding& b) {
+      return b.set == binding.set && b.layout.binding == binding.layout.binding;
+    });
+    if (existing == bindings.end())
+    {
+      bindings.push_back(binding);
+      continue;
+    }
+
+    if (existing->layout.descriptorType != binding.layout.descriptorType ||
+        existing->layout.descriptorCount != binding.layout.descriptorCount)
+      throw std::runtime_error(
+        "Shaders disagree on set " + std::to_string(binding.set) +
+        " binding " + std::to_string(binding.layout.binding) + "!"
+      );
+    existing->layout.stageFlags |= binding.layout.stageFlags;
+    existing->blockSize = std::max(existing->blockSize, binding.blockSize);
+  }
+  std::sort(bindings.begin(), bindings.end(), bindingOrder);
+
+  // One range for every stage, as large as the largest block
+  if (other.pushConstants.size > 0)
+  {
+    pushConstants.stageFlags |= other.pushConstants.stageFlags;
+    pushConstants.size = std::max(pushConstants.size, other.pushConstants.size);
+  }
+
+  if (vertexInputs.empty())
+    vertexInputs = other.vertexInputs;
+}
+
+uint32_t ShaderReflection::getSetCount() const
+{
+  return bindings.empty() ? 0 : bindings.back().set + 1;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> ShaderReflection::getSetBindings(uint32_t set) const
+{
+  std::vector<VkDescriptorSetLayoutBinding> setBindings;
+  for (const Binding& binding : bindings)
+    if (binding.set == set)
+      setBindings.push_back(binding.layout);
+  return setBindings;
+}
+
+uint32_t ShaderReflection::getBlockSize(uint32_t set, uint32_t binding) const
+{
+  for (const Binding& b : bindings)
+    if (b.set == set && b.layout.binding == binding)
+      return b.blockSize;
+  return 0;
+}
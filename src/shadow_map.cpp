@@ -0,0 +1,530 @@
+#include "shadow_map.hpp"
+#include "depth_buffer.hpp"
+#include "shader.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Blend between logarithmic and uniform cascade splits
+static const float SPLIT_LAMBDA = 0.75f;
+// How far behind a cascade casters are still rendered into it
+static const float CASTER_MARGIN = 20.0f;
+
+static void layerBarrier(
+  VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, uint32_t baseLayer, uint32_t layerCount,
+  VkImageLayout oldLayout, VkImageLayout newLayout,
+  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess
+) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = aspectMask;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = baseLayer;
+  barrier.subresourceRange.layerCount = layerCount;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+ShadowMap::ShadowMap(
+  VkPhysicalDevice physicalDevice, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue, uint32_t mapSize,
+  LayoutCache& layouts
+) : device(dev), size(mapSize), image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), arrayView(VK_NULL_HANDLE),
+    staticImage(VK_NULL_HANDLE), staticMemory(VK_NULL_HANDLE), staticPass(VK_NULL_HANDLE), dynamicPass(VK_NULL_HANDLE),
+    pipelineLayout(VK_NULL_HANDLE), pipeline(VK_NULL_HANDLE), cascadeSplits(0.0f), staticRenders(0)
+{
+  format = findFormat(physicalDevice);
+  aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT)
+    aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+  lightViewProj.fill(glm::mat4(1.0f));
+
+  // 1. Images
+  image = createLayeredImage(
+    physicalDevice,
+    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+    memory
+  );
+  staticImage = createLayeredImage(
+    physicalDevice, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, staticMemory
+  );
+
+  arrayView = createView(image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, CASCADE_COUNT);
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+  {
+    layerViews[i] = createView(image, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+    staticLayerViews[i] = createView(staticImage, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+  }
+
+  // 2. Passes: the static pass fills the cache, the dynamic pass draws over the copied cache
+  staticPass = createPass(VK_ATTACHMENT_LOAD_OP_CLEAR);
+  dynamicPass = createPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+  {
+    staticFramebuffers[i] = createFramebuffer(staticPass, staticLayerViews[i]);
+    dynamicFramebuffers[i] = createFramebuffer(dynamicPass, layerViews[i]);
+  }
+
+  // 3. Pipeline
+  createPipeline(layouts);
+
+  // 4. Resting layouts between frames
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+  layerBarrier(
+    commandBuffer, image, aspectMask, 0, CASCADE_COUNT,
+    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+  );
+  layerBarrier(
+    commandBuffer, staticImage, aspectMask, 0, CASCADE_COUNT,
+    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+  );
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+  std::cout << "Shadow map: " << CASCADE_COUNT << " cascades of " << size << "x" << size << std::endl;
+}
+
+ShadowMap::~ShadowMap()
+{
+  if (pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(device, pipeline, nullptr);
+
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+  {
+    vkDestroyFramebuffer(device, staticFramebuffers[i], nullptr);
+    vkDestroyFramebuffer(device, dynamicFramebuffers[i], nullptr);
+    vkDestroyImageView(device, staticLayerViews[i], nullptr);
+    vkDestroyImageView(device, layerViews[i], nullptr);
+  }
+
+  if (staticPass != VK_NULL_HANDLE)
+    vkDestroyRenderPass(device, staticPass, nullptr);
+  if (dynamicPass != VK_NULL_HANDLE)
+    vkDestroyRenderPass(device, dynamicPass, nullptr);
+
+  if (arrayView != VK_NULL_HANDLE)
+    vkDestroyImageView(device, arrayView, nullptr);
+  if (image != VK_NULL_HANDLE)
+    vkDestroyImage(device, image, nullptr);
+  if (memory != VK_NULL_HANDLE)
+    vkFreeMemory(device, memory, nullptr);
+  if (staticImage != VK_NULL_HANDLE)
+    vkDestroyImage(device, staticImage, nullptr);
+  if (staticMemory != VK_NULL_HANDLE)
+    vkFreeMemory(device, staticMemory, nullptr);
+}
+
+VkImage ShadowMap::createLayeredImage(
+  VkPhysicalDevice physicalDevice, VkImageUsageFlags usage, VkDeviceMemory& imageMemory
+) {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {size, size, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = CASCADE_COUNT;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  return createImage(physicalDevice, device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageMemory);
+}
+
+VkImageView ShadowMap::createView(VkImage target, VkImageViewType type, uint32_t baseLayer, uint32_t layerCount)
+{
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = target;
+  viewInfo.viewType = type;
+  viewInfo.format = format;
+  // Sampling reads depth only, attachments need every aspect of the format
+  viewInfo.subresourceRange.aspectMask = type == VK_IMAGE_VIEW_TYPE_2D_ARRAY ? VK_IMAGE_ASPECT_DEPTH_BIT : aspectMask;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = baseLayer;
+  viewInfo.subresourceRange.layerCount = layerCount;
+
+  VkImageView view;
+  if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shadow map image view!");
+  return view;
+}
+
+VkFormat ShadowMap::findFormat(VkPhysicalDevice physicalDevice)
+{
+  return DepthBuffer::findDepthFormat(physicalDevice, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+VkRenderPass ShadowMap::createPass(VkAttachmentLoadOp loadOp)
+{
+  // The frame graph puts the layers in the attachment layout and orders the pass against the copies and lookups
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = format;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = loadOp;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 0;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &depthAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+
+  VkRenderPass pass;
+  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shadow render pass!");
+  return pass;
+}
+
+VkFramebuffer ShadowMap::createFramebuffer(VkRenderPass pass, VkImageView view)
+{
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = pass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &view;
+  framebufferInfo.width = size;
+  framebufferInfo.height = size;
+  framebufferInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shadow framebuffer!");
+  return framebuffer;
+}
+
+void ShadowMap::createPipeline(LayoutCache& layouts)
+{
+  // 1. Layout: the light-space MVP is the only input
+  ShaderReflection reflection(loadShaderCode("shaders/shadow.spv"));
+  if (reflection.getPushConstants().size != sizeof(glm::mat4))
+    throw std::runtime_error("Shadow shader push constants are not a light-space MVP!");
+  pipelineLayout = layouts.getPipelineLayout(reflection);
+
+  // 2. Vertex stage only, depth is written by fixed function
+  auto code = loadShaderCode("shaders/shadow.spv");
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = code.size_bytes();
+  moduleInfo.pCode = code.data();
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shadow shader module!");
+
+  VkPipelineShaderStageCreateInfo stageInfo{};
+  stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stageInfo.module = shaderModule;
+  stageInfo.pName = "main";
+
+  // 3. Position-only stream
+  auto bindingDescription = Vertex::getPositionBindingDescription();
+  auto positionAttribute = Vertex::getPositionAttributeDescription();
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.vertexAttributeDescriptionCount = 1;
+  vertexInputInfo.pVertexAttributeDescriptions = &positionAttribute;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  // 4. Slope-scaled bias against shadow acne
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_TRUE;
+  rasterizer.depthBiasConstantFactor = 1.25f;
+  rasterizer.depthBiasSlopeFactor = 1.75f;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = VK_TRUE;
+  depthStencil.depthWriteEnable = VK_TRUE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
+
+  // 5. Create pipeline, both passes are compatible
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 1;
+  pipelineInfo.pStages = &stageInfo;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.renderPass = staticPass;
+  pipelineInfo.subpass = 0;
+
+  VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+
+  if (result != VK_SUCCESS)
+    throw std::runtime_error("Failed to create shadow pipeline!");
+}
+
+void ShadowMap::updateCascades(
+  const glm::mat4& view, float fovY, float aspect, float zNear, float zFar, const glm::vec3& lightDirection
+) {
+  glm::mat4 cameraToWorld = glm::inverse(view);
+  float tanHalfFov = std::tan(fovY * 0.5f);
+
+  glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+  float sliceNear = zNear;
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+  {
+    float p = static_cast<float>(i + 1) / CASCADE_COUNT;
+    float logSplit = zNear * std::pow(zFar / zNear, p);
+    float uniformSplit = zNear + (zFar - zNear) * p;
+    float sliceFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+
+    // Bounding sphere of the slice: unlike a tight box it does not change when the camera turns
+    std::array<glm::vec3, 8> corners;
+    glm::vec3 center(0.0f);
+    for (uint32_t c = 0; c < 8; c++)
+    {
+      float z = (c & 4) ? sliceFar : sliceNear;
+      float x = ((c & 1) ? 1.0f : -1.0f) * z * tanHalfFov * aspect;
+      float y = ((c & 2) ? 1.0f : -1.0f) * z * tanHalfFov;
+      corners[c] = glm::vec3(cameraToWorld * glm::vec4(x, y, -z, 1.0f));
+      center += corners[c] / 8.0f;
+    }
+
+    float radius = 0.0f;
+    for (const auto& corner : corners)
+      radius = std::max(radius, glm::length(corner - center));
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    // Move the cascade in whole texels only
+    float texelSize = 2.0f * radius / size;
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    lightCenter = glm::floor(lightCenter / texelSize) * texelSize;
+
+    glm::mat4 lightProj = glm::orthoRH_ZO(
+      lightCenter.x - radius, lightCenter.x + radius,
+      lightCenter.y - radius, lightCenter.y + radius,
+      -lightCenter.z - radius - CASTER_MARGIN, -lightCenter.z + radius
+    );
+
+    lightViewProj[i] = lightProj * lightView;
+    cascadeSplits[i] = sliceFar;
+    sliceNear = sliceFar;
+  }
+}
+
+void ShadowMap::drawCasters(
+  VkCommandBuffer commandBuffer, VkRenderPass pass, VkFramebuffer framebuffer, uint32_t cascade,
+  const Cube& mesh, std::span<const uint32_t> casters
+) {
+  const std::vector<SceneObject>& objects = *plan.objects;
+  VkClearValue clearValue{};
+  clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = pass;
+  renderPassInfo.framebuffer = framebuffer;
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = {size, size};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+
+  // Front to back in light space, so the depth test rejects the casters behind the first ones
+  const DrawMesh casterMesh{mesh.getPositionBuffer(), mesh.getIndexBuffer(), mesh.getIndexCount()};
+  DrawQueue queue(*plan.arena, casters.size());
+  for (uint32_t index : casters)
+  {
+    glm::mat4 lightMvp = lightViewProj[cascade] * objects[index].model;
+    float depth = lightMvp[3].z;  // light space depth of the object's origin, orthographic so no divide
+    queue.push({
+      DrawQueue::makeKey(0, 0, 0, 0, depth), pipeline, VK_NULL_HANDLE, &casterMesh, DrawConstants::of(lightMvp)
+    });
+  }
+  queue.sort();
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.width = static_cast<float>(size);
+  viewport.height = static_cast<float>(size);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = {size, size};
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  queue.record(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, drawStats);
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void ShadowMap::prepare(const std::vector<SceneObject>& objects, uint64_t staticVersion, LinearArena& arena)
+{
+  // Split once instead of filtering every object for each cascade and pass; the lists outlive this call
+  const size_t listSize = sizeof(uint32_t) * objects.size();
+  uint32_t* staticCasters = static_cast<uint32_t*>(arena.allocate(listSize, alignof(uint32_t)));
+  uint32_t* dynamicCasters = static_cast<uint32_t*>(arena.allocate(listSize, alignof(uint32_t)));
+  size_t staticCount = 0;
+  size_t dynamicCount = 0;
+  for (uint32_t i = 0; i < objects.size(); i++)
+    if (objects[i].isStatic)
+      staticCasters[staticCount++] = i;
+    else
+      dynamicCasters[dynamicCount++] = i;
+  bool hasDynamic = dynamicCount > 0;
+
+  plan.objects = &objects;
+  plan.arena = &arena;
+  plan.staticCasters = {staticCasters, staticCount};
+  plan.dynamicCasters = {dynamicCasters, dynamicCount};
+
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+  {
+    CascadeCache& entry = cache[i];
+    bool staticDirty = !entry.valid || entry.staticVersion != staticVersion || entry.viewProj != lightViewProj[i];
+
+    // Nothing moved: the sampled layer already holds exactly the cached depth
+    plan.renderStatic[i] = staticDirty;
+    plan.restore[i] = staticDirty || hasDynamic || entry.hasDynamic;
+    if (!plan.restore[i])
+      continue;
+
+    if (staticDirty)
+    {
+      entry.viewProj = lightViewProj[i];
+      entry.staticVersion = staticVersion;
+      entry.valid = true;
+      staticRenders++;
+    }
+    entry.hasDynamic = hasDynamic;
+  }
+}
+
+void ShadowMap::recordStatic(VkCommandBuffer commandBuffer, const Cube& mesh)
+{
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+    if (plan.renderStatic[i])
+      drawCasters(commandBuffer, staticPass, staticFramebuffers[i], i, mesh, plan.staticCasters);
+}
+
+void ShadowMap::recordRestore(VkCommandBuffer commandBuffer)
+{
+  // The cached static depth of every cascade that is redrawn, in one copy
+  std::array<VkImageCopy, CASCADE_COUNT> regions{};
+  uint32_t regionCount = 0;
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+    if (plan.restore[i])
+    {
+      VkImageCopy& region = regions[regionCount++];
+      region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+      region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+      region.extent = {size, size, 1};
+    }
+
+  if (regionCount > 0)
+    vkCmdCopyImage(
+      commandBuffer, staticImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions.data()
+    );
+}
+
+void ShadowMap::recordDynamic(VkCommandBuffer commandBuffer, const Cube& mesh)
+{
+  // Composited over the restored cache
+  for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+    if (plan.restore[i])
+      drawCasters(commandBuffer, dynamicPass, dynamicFramebuffers[i], i, mesh, plan.dynamicCasters);
+}
+
+VkDescriptorImageInfo ShadowMap::getDescriptorInfo(VkSampler sampler) const
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = arrayView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  return imageInfo;
+}
+
+uint32_t ShadowMap::takeStaticRenderCount()
+{
+  uint32_t count = staticRenders;
+  staticRenders = 0;
+  return count;
+}
+
+DrawStats ShadowMap::takeDrawStats()
+{
+  DrawStats stats = drawStats;
+  drawStats = {};
+  return stats;
+}
@@ -0,0 +1,51 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Simulation::Simulation(const FrameSnapshot& initial, uint32_t stepsPerSecond, StepFunction stepFunction)
+  : stepFunction(std::move(stepFunction)),
+    tickInterval(std::chrono::nanoseconds(1000000000ull / std::max(stepsPerSecond, 1u))),
+    snapshots(initial), stopping(false), stepCount(0), reportedSteps(0)
+{
+  FrameSnapshot& first = snapshots.getBack();
+  first.step = 0;
+  this->stepFunction(0.0f, first);
+  snapshots.publish();
+
+  thread = std::thread(&Simulation::run, this);
+  std::cout << "Simulation thread started, " << stepsPerSecond << " steps per second" << std::endl;
+}
+
+Simulation::~Simulation()
+{
+  stopping = true;
+  if (thread.joinable())
+    thread.join();
+}
+
+void Simulation::run()
+{
+  // Fixed steps on a wall-clock schedule: a late step runs at once, without sleeping, until it has caught up
+  auto start = std::chrono::steady_clock::now();
+  const double stepSeconds = std::chrono::duration<double>(tickInterval).count();
+
+  for (uint64_t step = 1; !stopping; step++)
+  {
+    std::this_thread::sleep_until(start + tickInterval * step);
+
+    FrameSnapshot& snapshot = snapshots.getBack();
+    snapshot.step = step;
+    stepFunction(static_cast<float>(step * stepSeconds), snapshot);
+    snapshots.publish();
+    stepCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+uint64_t Simulation::takeStepCount()
+{
+  uint64_t steps = stepCount.load(std::memory_order_relaxed);
+  uint64_t count = steps - reportedSteps;
+  reportedSteps = steps;
+  return count;
+}
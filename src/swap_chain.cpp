@@ -1,14 +1,34 @@
 #include "swap_chain.hpp"
+#include "vulkan_memory.hpp"
 
 #include <iostream>
 #include <algorithm>
 
+const char* presentModeName(VkPresentModeKHR mode)
+{
+  switch (mode)
+  {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default: return "UNKNOWN";
+  }
+}
+
 SwapChain::SwapChain(VulkanDevice& dev, VkSurfaceKHR surf, GLFWwindow* win)
-  : device(dev), surface(surf), window(win), swapChain(VK_NULL_HANDLE), imageFormat(VK_FORMAT_UNDEFINED)
+  : device(dev), surface(surf), window(win), swapChain(VK_NULL_HANDLE), offscreenMemory(VK_NULL_HANDLE),
+    imageFormat(VK_FORMAT_UNDEFINED), imageUsage(0), requestedUsage(0), preferredFormat(VK_FORMAT_B8G8R8A8_SRGB),
+    requestedPresentMode(VK_PRESENT_MODE_MAX_ENUM_KHR), presentMode(VK_PRESENT_MODE_FIFO_KHR)
 {
   extent = {0, 0};
 }
 
+SwapChain::SwapChain(VulkanDevice& dev, VkExtent2D offscreenExtent) : SwapChain(dev, VK_NULL_HANDLE, nullptr)
+{
+  extent = offscreenExtent;
+}
+
 SwapChain::~SwapChain()
 {
   cleanup();
@@ -16,7 +36,10 @@ SwapChain::~SwapChain()
 
 void SwapChain::init()
 {
-  createSwapChain();
+  if (isOffscreen())
+    createOffscreenImage();
+  else
+    createSwapChain();
   createImageViews();
 }
 
@@ -30,10 +53,28 @@ void SwapChain::cleanup()
     vkDestroySwapchainKHR(device.getDevice(), swapChain, nullptr);
     swapChain = VK_NULL_HANDLE;
   }
+
+  // Swapchain images belong to the swapchain, the offscreen one to us
+  if (offscreenMemory != VK_NULL_HANDLE)
+  {
+    for (auto image : images)
+      vkDestroyImage(device.getDevice(), image, nullptr);
+    vkFreeMemory(device.getDevice(), offscreenMemory, nullptr);
+    offscreenMemory = VK_NULL_HANDLE;
+  }
+  images.clear();
 }
 
 void SwapChain::recreate()
 {
+  if (isOffscreen())
+  {
+    vkDeviceWaitIdle(device.getDevice());
+    cleanup();
+    init();
+    return;
+  }
+
   int width = 0, height = 0;
   glfwGetFramebufferSize(window, &width, &height);
   while (width == 0 || height == 0)
@@ -76,16 +117,22 @@ SwapChainSupportDetails SwapChain::querySwapChainSupport()
 VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats)
 {
   for (const auto& format : formats)
-    if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+    if (format.format == preferredFormat && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
       return format;
   return formats[0];
 }
 
 VkPresentModeKHR SwapChain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& presentModes)
 {
+  const VkPresentModeKHR wanted =
+    requestedPresentMode == VK_PRESENT_MODE_MAX_ENUM_KHR ? VK_PRESENT_MODE_MAILBOX_KHR : requestedPresentMode;
   for (const auto& mode : presentModes)
-    if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+    if (mode == wanted)
       return mode;
+
+  if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+    std::cout << "Present mode " << presentModeName(requestedPresentMode) << " is not supported, using FIFO"
+              << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -118,7 +165,7 @@ void SwapChain::createSwapChain()
   SwapChainSupportDetails swapChainSupport = querySwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, window);
 
   uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -133,7 +180,12 @@ void SwapChain::createSwapChain()
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
-  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // Transfer destination for the upscaling blit when the surface allows it
+  imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+    imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  imageUsage |= requestedUsage & swapChainSupport.capabilities.supportedUsageFlags;
+  createInfo.imageUsage = imageUsage;
 
   QueueFamilyIndices indices = device.getQueueFamilies();
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -157,12 +209,44 @@ void SwapChain::createSwapChain()
 
   this->imageFormat = surfaceFormat.format;
   this->extent = extent;
+  std::cout << "Present mode: " << presentModeName(presentMode) << std::endl;
 
   vkGetSwapchainImagesKHR(device.getDevice(), swapChain, &imageCount, nullptr);
   images.resize(imageCount);
   vkGetSwapchainImagesKHR(device.getDevice(), swapChain, &imageCount, images.data());
 }
 
+void SwapChain::createOffscreenImage()
+{
+  // The preferred format where it can be rendered to, else the RGBA one every device renders to
+  VkFormat format = preferredFormat;
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &properties);
+  if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+    format = format == VK_FORMAT_B8G8R8A8_UNORM ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+
+  imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | requestedUsage;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = imageUsage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  images = {createImage(
+    device.getPhysicalDevice(), device.getDevice(), imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreenMemory
+  )};
+  imageFormat = format;
+  std::cout << "Offscreen target: " << extent.width << "x" << extent.height << ", nothing is presented" << std::endl;
+}
+
 void SwapChain::createImageViews()
 {
   imageViews.resize(images.size());
@@ -0,0 +1,608 @@
+#include "texture.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef HERTRA_HAS_PNG
+  #include <png.h>
+#endif
+
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+// DXGI_FORMAT values used by the DDS DX10 extension header
+static const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+static const uint32_t DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+static const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+static const uint32_t DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+static const uint32_t DXGI_FORMAT_BC5_UNORM = 83;
+static const uint32_t DXGI_FORMAT_BC5_SNORM = 84;
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+static const uint32_t DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+
+static constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+  return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+static bool isBlockCompressed(VkFormat format)
+{
+  return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// Bytes per 4x4 block for BC formats, bytes per texel otherwise
+static uint32_t formatBlockBytes(VkFormat format)
+{
+  switch (format)
+  {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static VkDeviceSize levelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+  if (isBlockCompressed(format))
+    return VkDeviceSize((width + 3) / 4) * ((height + 3) / 4) * formatBlockBytes(format);
+  return VkDeviceSize(width) * height * formatBlockBytes(format);
+}
+
+static void readBytes(std::ifstream& file, void* dst, size_t size, const std::string& path)
+{
+  file.read(reinterpret_cast<char*>(dst), size);
+  if (!file)
+    throw std::runtime_error("Unexpected end of texture file: " + path);
+}
+
+static TextureFile parseKtx2(std::ifstream& file, const std::string& path)
+{
+  // vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth, layerCount, faceCount, levelCount, supercompression
+  uint32_t header[9];
+  readBytes(file, header, sizeof(header), path);
+
+  // dfd/kvd offsets and lengths, followed by sgd offset and length
+  uint32_t index[4];
+  uint64_t sgdIndex[2];
+  readBytes(file, index, sizeof(index), path);
+  readBytes(file, sgdIndex, sizeof(sgdIndex), path);
+
+  if (header[8] != 0)
+    throw std::runtime_error("Supercompressed KTX2 files are not supported: " + path);
+  if (header[4] > 1 || header[5] > 1 || header[6] != 1)
+    throw std::runtime_error("Only single 2D KTX2 images are supported: " + path);
+
+  TextureFile result;
+  result.path = path;
+  result.format = static_cast<VkFormat>(header[0]);
+  result.width = header[2];
+  result.height = std::max(1u, header[3]);
+
+  uint32_t levelCount = std::max(1u, header[7]);
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    // byteOffset, byteLength, uncompressedByteLength
+    uint64_t level[3];
+    readBytes(file, level, sizeof(level), path);
+    result.levels.push_back({
+      level[0], level[1], std::max(1u, result.width >> i), std::max(1u, result.height >> i)
+    });
+  }
+  return result;
+}
+
+static TextureFile parseDds(std::ifstream& file, const std::string& path)
+{
+  // DDS_HEADER: height at 2, width at 3, mip count at 6, pixel format FourCC at 20
+  uint32_t header[31];
+  readBytes(file, header, sizeof(header), path);
+
+  TextureFile result;
+  result.path = path;
+  result.height = header[2];
+  result.width = header[3];
+
+  VkDeviceSize dataOffset = 4 + sizeof(header);
+  uint32_t fourCC = header[20];
+
+  if (fourCC == makeFourCC('D', 'X', '1', '0'))
+  {
+    // dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2
+    uint32_t dx10[5];
+    readBytes(file, dx10, sizeof(dx10), path);
+    dataOffset += sizeof(dx10);
+
+    if (dx10[3] > 1)
+      throw std::runtime_error("DDS texture arrays are not supported: " + path);
+
+    switch (dx10[0])
+    {
+      case DXGI_FORMAT_BC1_UNORM: result.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+      case DXGI_FORMAT_BC1_UNORM_SRGB: result.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+      case DXGI_FORMAT_BC3_UNORM: result.format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+      case DXGI_FORMAT_BC3_UNORM_SRGB: result.format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+      case DXGI_FORMAT_BC5_UNORM: result.format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+      case DXGI_FORMAT_BC5_SNORM: result.format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+      case DXGI_FORMAT_BC7_UNORM: result.format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+      case DXGI_FORMAT_BC7_UNORM_SRGB: result.format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+    }
+  }
+  else if (fourCC == makeFourCC('D', 'X', 'T', '1'))
+    result.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  else if (fourCC == makeFourCC('D', 'X', 'T', '5'))
+    result.format = VK_FORMAT_BC3_UNORM_BLOCK;
+  else if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U'))
+    result.format = VK_FORMAT_BC5_UNORM_BLOCK;
+
+  if (result.format == VK_FORMAT_UNDEFINED)
+    throw std::runtime_error("Unsupported DDS pixel format: " + path);
+
+  // DDS stores the mip chain contiguously after the headers
+  uint32_t levelCount = std::max(1u, header[6]);
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    uint32_t width = std::max(1u, result.width >> i);
+    uint32_t height = std::max(1u, result.height >> i);
+    VkDeviceSize size = levelSize(result.format, width, height);
+    result.levels.push_back({dataOffset, size, width, height});
+    dataOffset += size;
+  }
+  return result;
+}
+
+TextureFile TextureFile::open(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open texture: " + path);
+
+  uint8_t identifier[12];
+  readBytes(file, identifier, 4, path);
+
+  TextureFile result;
+  uint32_t magic;
+  std::memcpy(&magic, identifier, sizeof(magic));
+  if (magic == DDS_MAGIC)
+    result = parseDds(file, path);
+  else
+  {
+    readBytes(file, identifier + 4, sizeof(identifier) - 4, path);
+    if (std::memcmp(identifier, KTX2_IDENTIFIER, sizeof(identifier)) != 0)
+      throw std::runtime_error("Unknown texture container: " + path);
+    result = parseKtx2(file, path);
+  }
+
+  if (formatBlockBytes(result.format) == 0)
+    throw std::runtime_error("Unsupported texture format in " + path);
+
+  for (const auto& level : result.levels)
+    if (level.size < levelSize(result.format, level.width, level.height))
+      throw std::runtime_error("Truncated mip level in " + path);
+
+  return result;
+}
+
+std::vector<char> TextureFile::readLevels(uint32_t firstLevel, uint32_t count, std::vector<VkDeviceSize>& offsets) const
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open texture: " + path);
+
+  // 16 covers both the texel block size and the 4 byte alignment of vkCmdCopyBufferToImage
+  VkDeviceSize total = 0;
+  offsets.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    offsets[i] = total;
+    total += (levels[firstLevel + i].size + 15) & ~VkDeviceSize(15);
+  }
+
+  std::vector<char> data(total);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const TextureLevel& level = levels[firstLevel + i];
+    file.seekg(level.offset);
+    readBytes(file, data.data() + offsets[i], level.size, path);
+  }
+  return data;
+}
+
+static void layoutAccess(VkImageLayout layout, VkAccessFlags& access, VkPipelineStageFlags& stage)
+{
+  switch (layout)
+  {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      access = 0;
+      stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      access = VK_ACCESS_TRANSFER_WRITE_BIT;
+      stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      access = VK_ACCESS_TRANSFER_READ_BIT;
+      stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      access = VK_ACCESS_SHADER_READ_BIT;
+      stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+      break;
+    default:
+      throw std::runtime_error("Unsupported layout transition!");
+  }
+}
+
+void transitionImageLayout(
+  VkCommandBuffer commandBuffer, VkImage image,
+  VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount
+) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = baseMipLevel;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  VkPipelineStageFlags srcStage, dstStage;
+  layoutAccess(oldLayout, barrier.srcAccessMask, srcStage);
+  layoutAccess(newLayout, barrier.dstAccessMask, dstStage);
+
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+SamplerCache::SamplerCache(VkPhysicalDevice physicalDevice, VkDevice dev, bool anisotropyEnabled)
+  : device(dev), maxAnisotropy(1.0f)
+{
+  if (anisotropyEnabled)
+  {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+  }
+}
+
+SamplerCache::~SamplerCache()
+{
+  for (auto& [key, sampler] : samplers)
+    vkDestroySampler(device, sampler, nullptr);
+}
+
+VkSampler SamplerCache::get(const SamplerKey& key)
+{
+  auto it = samplers.find(key);
+  if (it != samplers.end())
+    return it->second;
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = key.filter;
+  samplerInfo.minFilter = key.filter;
+  samplerInfo.mipmapMode = key.mipmapMode;
+  samplerInfo.addressModeU = key.addressMode;
+  samplerInfo.addressModeV = key.addressMode;
+  samplerInfo.addressModeW = key.addressMode;
+  samplerInfo.anisotropyEnable = (key.anisotropy && maxAnisotropy > 1.0f) ? VK_TRUE : VK_FALSE;
+  samplerInfo.maxAnisotropy = samplerInfo.anisotropyEnable ? maxAnisotropy : 1.0f;
+  samplerInfo.borderColor = key.borderColor;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = key.compare ? VK_TRUE : VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  samplerInfo.minLod = static_cast<float>(key.minLod);
+  // No upper clamp, so one sampler serves textures with any number of mips
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  VkSampler sampler;
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create texture sampler!");
+
+  samplers.emplace(key, sampler);
+  return sampler;
+}
+
+Texture::Texture(
+  VkPhysicalDevice physicalDevice, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue,
+  SamplerCache& samplers, const std::string& path, const SamplerKey& samplerKey
+) : device(dev), image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE),
+    sampler(samplers.get(samplerKey)), format(VK_FORMAT_UNDEFINED), extent{0, 0}, mipLevels(1), sizeInBytes(0)
+{
+  std::string extension = path.substr(path.find_last_of('.') + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+  if (extension == "png")
+    loadPng(physicalDevice, commandPool, queue, path);
+  else
+    loadCompressed(physicalDevice, commandPool, queue, TextureFile::open(path));
+
+  createImageView();
+
+  VkDeviceSize rgbaSize = 0;
+  for (uint32_t i = 0; i < mipLevels; i++)
+    rgbaSize += levelSize(VK_FORMAT_R8G8B8A8_UNORM, std::max(1u, extent.width >> i), std::max(1u, extent.height >> i));
+
+  std::cout << "Loaded texture: " << path << " (" << extent.width << "x" << extent.height << ", "
+            << mipLevels << " mips, " << sizeInBytes / 1024 << " KB, RGBA8 would be "
+            << rgbaSize / 1024 << " KB)" << std::endl;
+}
+
+Texture::Texture(
+  VkPhysicalDevice physicalDevice, VkDevice dev, VkCommandPool commandPool, QueueTimeline& queue,
+  SamplerCache& samplers, uint32_t color
+) : device(dev), image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE),
+    sampler(samplers.get({})), format(VK_FORMAT_UNDEFINED), extent{0, 0}, mipLevels(1), sizeInBytes(0)
+{
+  unsigned char pixel[4] =
+  {
+    static_cast<unsigned char>(color >> 24), static_cast<unsigned char>(color >> 16),
+    static_cast<unsigned char>(color >> 8), static_cast<unsigned char>(color)
+  };
+  loadRgba(physicalDevice, commandPool, queue, pixel, 1, 1);
+  createImageView();
+}
+
+Texture::~Texture()
+{
+  if (imageView != VK_NULL_HANDLE)
+    vkDestroyImageView(device, imageView, nullptr);
+  if (image != VK_NULL_HANDLE)
+    vkDestroyImage(device, image, nullptr);
+  if (memory != VK_NULL_HANDLE)
+    vkFreeMemory(device, memory, nullptr);
+}
+
+void Texture::allocateImage(VkPhysicalDevice physicalDevice, VkImageUsageFlags usage)
+{
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = extent.width;
+  imageInfo.extent.height = extent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  image = createImage(physicalDevice, device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory);
+}
+
+void Texture::createImageView()
+{
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create texture image view!");
+}
+
+void Texture::loadCompressed(
+  VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue, const TextureFile& file
+) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, file.format, &props);
+  if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    throw std::runtime_error("Texture format is not supported by the GPU: " + file.path);
+
+  format = file.format;
+  extent = {file.width, file.height};
+  mipLevels = static_cast<uint32_t>(file.levels.size());
+  allocateImage(physicalDevice, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+  std::vector<VkDeviceSize> offsets;
+  std::vector<char> data = file.readLevels(0, mipLevels, offsets);
+  sizeInBytes = data.size();
+
+  VkDeviceMemory stagingBufferMemory;
+  VkBuffer stagingBuffer = createBuffer(
+    physicalDevice, device, data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    stagingBufferMemory
+  );
+
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, data.size(), 0, &mapped);
+  memcpy(mapped, data.data(), data.size());
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  // Whole mip chain goes up in a single copy command
+  std::vector<VkBufferImageCopy> regions(mipLevels);
+  for (uint32_t i = 0; i < mipLevels; i++)
+  {
+    regions[i].bufferOffset = offsets[i];
+    regions[i].bufferRowLength = 0;
+    regions[i].bufferImageHeight = 0;
+    regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[i].imageSubresource.mipLevel = i;
+    regions[i].imageSubresource.baseArrayLayer = 0;
+    regions[i].imageSubresource.layerCount = 1;
+    regions[i].imageOffset = {0, 0, 0};
+    regions[i].imageExtent = {file.levels[i].width, file.levels[i].height, 1};
+  }
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+  transitionImageLayout(
+    commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels
+  );
+  vkCmdCopyBufferToImage(
+    commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    static_cast<uint32_t>(regions.size()), regions.data()
+  );
+  transitionImageLayout(
+    commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels
+  );
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void Texture::loadPng(
+  VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue, const std::string& path
+) {
+#ifdef HERTRA_HAS_PNG
+  png_image png{};
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&png, path.c_str()))
+    throw std::runtime_error("Failed to read PNG: " + path);
+
+  png.format = PNG_FORMAT_RGBA;
+  std::vector<unsigned char> pixels(PNG_IMAGE_SIZE(png));
+  if (!png_image_finish_read(&png, nullptr, pixels.data(), 0, nullptr))
+  {
+    png_image_free(&png);
+    throw std::runtime_error("Failed to decode PNG: " + path);
+  }
+
+  loadRgba(physicalDevice, commandPool, queue, pixels.data(), png.width, png.height);
+#else
+  throw std::runtime_error("PNG support is disabled (libpng not found): " + path);
+#endif
+}
+
+void Texture::loadRgba(
+  VkPhysicalDevice physicalDevice, VkCommandPool commandPool, QueueTimeline& queue,
+  const unsigned char* pixels, uint32_t width, uint32_t height
+) {
+  format = VK_FORMAT_R8G8B8A8_SRGB;
+  extent = {width, height};
+
+  // Mips are generated on the GPU by blitting, which needs linear filtering support
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  bool canBlit = (props.optimalTilingFeatures & blitFeatures) == blitFeatures;
+  mipLevels = canBlit ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
+
+  allocateImage(
+    physicalDevice, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+  );
+
+  VkDeviceSize imageSize = levelSize(format, width, height);
+  VkDeviceMemory stagingBufferMemory;
+  VkBuffer stagingBuffer = createBuffer(
+    physicalDevice, device, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    stagingBufferMemory
+  );
+
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &mapped);
+  memcpy(mapped, pixels, imageSize);
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {width, height, 1};
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+  transitionImageLayout(
+    commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels
+  );
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  generateMipmaps(commandBuffer);
+  endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+  sizeInBytes = 0;
+  for (uint32_t i = 0; i < mipLevels; i++)
+    sizeInBytes += levelSize(format, std::max(1u, width >> i), std::max(1u, height >> i));
+}
+
+void Texture::generateMipmaps(VkCommandBuffer commandBuffer)
+{
+  int32_t mipWidth = static_cast<int32_t>(extent.width);
+  int32_t mipHeight = static_cast<int32_t>(extent.height);
+
+  for (uint32_t i = 1; i < mipLevels; i++)
+  {
+    transitionImageLayout(
+      commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1
+    );
+
+    VkImageBlit blit{};
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = i - 1;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = i;
+    blit.dstSubresource.baseArrayLayer = 0;
+    blit.dstSubresource.layerCount = 1;
+
+    vkCmdBlitImage(
+      commandBuffer,
+      image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1, &blit, VK_FILTER_LINEAR
+    );
+
+    transitionImageLayout(
+      commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, i - 1, 1
+    );
+
+    if (mipWidth > 1)
+      mipWidth /= 2;
+    if (mipHeight > 1)
+      mipHeight /= 2;
+  }
+
+  transitionImageLayout(
+    commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    mipLevels - 1, 1
+  );
+}
+
+VkDescriptorImageInfo Texture::getDescriptorInfo() const
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = imageView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  return imageInfo;
+}
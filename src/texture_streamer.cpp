@@ -0,0 +1,406 @@
+#include "texture_streamer.hpp"
+#include "vulkan_memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+TextureStreamer::TextureStreamer(
+  VkPhysicalDevice physDev, VkDevice dev, uint32_t queueFamily, QueueTimeline& transferQueue,
+  SamplerCache& samplerCache, VkDeviceSize memoryBudget
+) : physicalDevice(physDev), device(dev), queue(transferQueue), commandPool(VK_NULL_HANDLE),
+    commandBuffer(VK_NULL_HANDLE), uploadValue(0), samplers(samplerCache), budget(memoryBudget),
+    residentBytes(0), frameIndex(0), recording(false), stopping(false)
+{
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create streaming command pool!");
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate streaming command buffer!");
+
+  ioThread = std::thread(&TextureStreamer::ioLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  if (ioThread.joinable())
+    ioThread.join();
+
+  queue.wait(uploadValue);
+
+  for (auto& [buffer, memory] : stagingBuffers)
+  {
+    vkDestroyBuffer(device, buffer, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+  }
+
+  for (auto& texture : textures)
+  {
+    vkDestroyImageView(device, texture.imageView, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    vkFreeMemory(device, texture.memory, nullptr);
+  }
+
+  vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+void TextureStreamer::ioLoop()
+{
+  while (true)
+  {
+    LoadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this] { return stopping || !requests.empty(); });
+      if (stopping)
+        return;
+
+      request = std::move(requests.front());
+      requests.pop_front();
+    }
+
+    LoadResult result{request.texture, request.level, {}};
+    try
+    {
+      std::vector<VkDeviceSize> offsets;
+      result.data = request.file.readLevels(request.level, 1, offsets);
+    } catch (const std::exception& e)
+    {
+      std::cerr << "Texture streaming read failed: " << e.what() << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    results.push_back(std::move(result));
+  }
+}
+
+VkDeviceSize TextureStreamer::residentSize(const StreamedTexture& texture, uint32_t mip) const
+{
+  VkDeviceSize size = 0;
+  for (uint32_t i = mip; i < texture.file.levels.size(); i++)
+    size += texture.file.levels[i].size;
+  return size;
+}
+
+void TextureStreamer::allocate(StreamedTexture& texture)
+{
+  uint32_t mipLevels = static_cast<uint32_t>(texture.file.levels.size());
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = texture.file.width;
+  imageInfo.extent.height = texture.file.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = texture.file.format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  texture.image = createImage(physicalDevice, device, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.memory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = texture.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = texture.file.format;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &texture.imageView) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create streamed texture view!");
+}
+
+uint32_t TextureStreamer::add(const std::string& path, uint32_t initialSize)
+{
+  StreamedTexture texture;
+  texture.file = TextureFile::open(path);
+
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, texture.file.format, &props);
+  if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    throw std::runtime_error("Texture format is not supported by the GPU: " + path);
+
+  // Start with the coarsest levels that fit initialSize, finer ones arrive on demand
+  uint32_t levelCount = static_cast<uint32_t>(texture.file.levels.size());
+  texture.residentMip = levelCount - 1;
+  for (uint32_t i = 0; i < levelCount; i++)
+    if (std::max(texture.file.levels[i].width, texture.file.levels[i].height) <= initialSize)
+    {
+      texture.residentMip = i;
+      break;
+    }
+  texture.desiredMip = texture.residentMip;
+  texture.lastUsedFrame = frameIndex;
+
+  allocate(texture);
+  // One clamp sampler per level, the descriptor picks the one matching the residency
+  for (uint32_t i = static_cast<uint32_t>(clampSamplers.size()); i < levelCount; i++)
+  {
+    SamplerKey key;
+    key.minLod = i;
+    clampSamplers.push_back(samplers.get(key));
+  }
+
+  std::vector<VkDeviceSize> offsets;
+  uint32_t residentLevels = levelCount - texture.residentMip;
+  std::vector<char> data = texture.file.readLevels(texture.residentMip, residentLevels, offsets);
+
+  VkDeviceMemory stagingBufferMemory;
+  VkBuffer stagingBuffer = createBuffer(
+    physicalDevice, device, data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    stagingBufferMemory
+  );
+
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, data.size(), 0, &mapped);
+  memcpy(mapped, data.data(), data.size());
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  std::vector<VkBufferImageCopy> regions(residentLevels);
+  for (uint32_t i = 0; i < residentLevels; i++)
+  {
+    const TextureLevel& level = texture.file.levels[texture.residentMip + i];
+    regions[i] = {};
+    regions[i].bufferOffset = offsets[i];
+    regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[i].imageSubresource.mipLevel = texture.residentMip + i;
+    regions[i].imageSubresource.baseArrayLayer = 0;
+    regions[i].imageSubresource.layerCount = 1;
+    regions[i].imageExtent = {level.width, level.height, 1};
+  }
+
+  // Levels not loaded yet are never sampled, but every level is kept in the sampled layout
+  VkCommandBuffer uploadCommands = beginSingleTimeCommands(device, commandPool);
+  if (texture.residentMip > 0)
+    transitionImageLayout(
+      uploadCommands, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      0, texture.residentMip
+    );
+  transitionImageLayout(
+    uploadCommands, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    texture.residentMip, residentLevels
+  );
+  vkCmdCopyBufferToImage(
+    uploadCommands, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    static_cast<uint32_t>(regions.size()), regions.data()
+  );
+  transitionImageLayout(
+    uploadCommands, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    texture.residentMip, residentLevels
+  );
+  endSingleTimeCommands(device, commandPool, queue, uploadCommands);
+
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+  residentBytes += residentSize(texture, texture.residentMip);
+  std::cout << "Streaming texture: " << path << " (resident from mip " << texture.residentMip
+            << " of " << levelCount << ", " << residentSize(texture, texture.residentMip) / 1024 << " KB)" << std::endl;
+
+  textures.push_back(std::move(texture));
+  return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void TextureStreamer::reportSampledLevel(uint32_t id, uint32_t level)
+{
+  // Not drawn: the old demand stands and the texture ages towards eviction
+  if (level == UINT32_MAX)
+    return;
+
+  StreamedTexture& texture = textures[id];
+  uint32_t lastLevel = static_cast<uint32_t>(texture.file.levels.size()) - 1;
+  texture.desiredMip = std::min(level, lastLevel);
+  texture.lastUsedFrame = frameIndex;
+}
+
+VkCommandBuffer TextureStreamer::beginBatch()
+{
+  if (!recording)
+  {
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+      throw std::runtime_error("Failed to begin streaming command buffer!");
+    recording = true;
+  }
+  return commandBuffer;
+}
+
+void TextureStreamer::upload(StreamedTexture& texture, uint32_t level, const std::vector<char>& levelData)
+{
+  VkDeviceMemory stagingBufferMemory;
+  VkBuffer stagingBuffer = createBuffer(
+    physicalDevice, device, levelData.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    stagingBufferMemory
+  );
+  stagingBuffers.push_back({stagingBuffer, stagingBufferMemory});
+
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, levelData.size(), 0, &mapped);
+  memcpy(mapped, levelData.data(), levelData.size());
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = level;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {texture.file.levels[level].width, texture.file.levels[level].height, 1};
+
+  // Frames submitted before an eviction may still sample the level, the barrier waits for their fragment shaders
+  VkCommandBuffer cmd = beginBatch();
+  transitionImageLayout(
+    cmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, level, 1
+  );
+  vkCmdCopyBufferToImage(cmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  transitionImageLayout(
+    cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level, 1
+  );
+
+  residentBytes += texture.file.levels[level].size;
+  texture.residentMip = level;
+}
+
+void TextureStreamer::evictOverBudget()
+{
+  while (residentBytes > budget)
+  {
+    // Prefer textures holding finer mips than the screen asks for, then the least recently used
+    StreamedTexture* victim = nullptr;
+    for (auto& texture : textures)
+    {
+      if (texture.residentMip + 1 >= texture.file.levels.size())
+        continue;
+      if (!victim)
+      {
+        victim = &texture;
+        continue;
+      }
+
+      bool excess = texture.residentMip < texture.desiredMip;
+      bool victimExcess = victim->residentMip < victim->desiredMip;
+      if (excess != victimExcess)
+      {
+        if (excess)
+          victim = &texture;
+      }
+      else if (texture.lastUsedFrame < victim->lastUsedFrame)
+        victim = &texture;
+    }
+
+    if (!victim)
+      break;
+
+    // Only the clamp moves, the level stays allocated until a later load overwrites it
+    residentBytes -= victim->file.levels[victim->residentMip].size;
+    victim->residentMip++;
+  }
+}
+
+void TextureStreamer::update()
+{
+  frameIndex++;
+
+  // The previous batch still owns its staging buffers
+  if (!queue.isComplete(uploadValue))
+    return;
+
+  for (auto& [buffer, memory] : stagingBuffers)
+  {
+    vkDestroyBuffer(device, buffer, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+  }
+  stagingBuffers.clear();
+
+  std::vector<LoadResult> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    completed.swap(results);
+  }
+
+  for (auto& result : completed)
+  {
+    StreamedTexture& texture = textures[result.texture];
+    texture.loadPending = false;
+
+    if (result.data.empty())
+    {
+      // Read failed: stop asking for finer levels of this texture
+      texture.desiredMip = texture.residentMip;
+      continue;
+    }
+
+    // A level is only useful if it extends the resident chain and is still wanted
+    if (result.level + 1 == texture.residentMip && texture.desiredMip <= result.level &&
+        residentBytes + texture.file.levels[result.level].size <= budget)
+      upload(texture, result.level, result.data);
+  }
+
+  evictOverBudget();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+      StreamedTexture& texture = textures[i];
+      if (texture.loadPending || texture.desiredMip >= texture.residentMip)
+        continue;
+
+      uint32_t level = texture.residentMip - 1;
+      if (residentBytes + texture.file.levels[level].size > budget)
+        continue;
+
+      texture.loadPending = true;
+      requests.push_back({i, level, texture.file});
+    }
+  }
+  condition.notify_one();
+
+  if (!recording)
+    return;
+
+  vkEndCommandBuffer(commandBuffer);
+  recording = false;
+
+  // Ahead of the frame that first samples the new levels, on the same queue
+  uploadValue = queue.submit({&commandBuffer, 1});
+}
+
+VkDescriptorImageInfo TextureStreamer::getDescriptorInfo(uint32_t id) const
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = clampSamplers[textures[id].residentMip];
+  imageInfo.imageView = textures[id].imageView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  return imageInfo;
+}
@@ -1,20 +1,23 @@
 #include "vulkan_device.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 
 VulkanDevice::VulkanDevice()
-  :physicalDevice(VK_NULL_HANDLE), device(VK_NULL_HANDLE) {}
+  :physicalDevice(VK_NULL_HANDLE), device(VK_NULL_HANDLE), computeQueue(VK_NULL_HANDLE), enabledFeatures{},
+   framebufferSampleCounts(VK_SAMPLE_COUNT_1_BIT), cmdBeginRendering(nullptr), cmdEndRendering(nullptr),
+   waitSemaphores(nullptr), getSemaphoreCounterValue(nullptr), waitForPresentKHR(nullptr) {}
 
 VulkanDevice::~VulkanDevice()
 {
   cleanup();
 }
 
-void VulkanDevice::init(VkInstance instance, VkSurfaceKHR surface)
+void VulkanDevice::init(VkInstance instance, VkSurfaceKHR surface, uint32_t instanceVersion, bool asyncCompute)
 {
   pickPhysicalDevice(instance, surface);
-  createLogicalDevice(instance, surface);
+  createLogicalDevice(instance, surface, instanceVersion, asyncCompute);
 }
 
 void VulkanDevice::cleanup()
@@ -50,11 +53,31 @@ void VulkanDevice::pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface)
   VkPhysicalDeviceProperties deviceProperties;
   vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
   std::cout << "Using GPU: " << deviceProperties.deviceName << std::endl;
+
+  framebufferSampleCounts =
+    deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts;
+}
+
+VkSampleCountFlagBits VulkanDevice::clampSampleCount(uint32_t requested) const
+{
+  for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1)
+    if (count <= requested && (framebufferSampleCounts & count))
+      return static_cast<VkSampleCountFlagBits>(count);
+
+  return VK_SAMPLE_COUNT_1_BIT;
 }
 
 bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device, VkInstance instance, VkSurfaceKHR surface)
 {
   QueueFamilyIndices indices = findQueueFamilies(device, instance, surface);
+  // The scene's fragment shaders write the mip feedback
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(device, &features);
+  if (!features.fragmentStoresAndAtomics)
+    return false;
+  // Offscreen rendering needs no swapchain
+  if (surface == VK_NULL_HANDLE)
+    return indices.isComplete();
   bool extensionsSupported = checkDeviceExtensionSupport(device);
   bool swapChainAdequate = false;
   if (extensionsSupported)
@@ -65,6 +88,20 @@ bool VulkanDevice::isDeviceSuitable(VkPhysicalDevice device, VkInstance instance
   return indices.isComplete() && extensionsSupported && swapChainAdequate;
 }
 
+bool VulkanDevice::hasDeviceExtension(VkPhysicalDevice device, const char* name)
+{
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions)
+    if (std::string(extension.extensionName) == name)
+      return true;
+  return false;
+}
+
 bool VulkanDevice::checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
   uint32_t extensionCount;
@@ -124,8 +161,10 @@ QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device, VkIn
     if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
       indices.graphicsFamily = i;
 
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    // Without a surface nothing is presented, the graphics family stands in
+    VkBool32 presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+    if (surface != VK_NULL_HANDLE)
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
     if (presentSupport)
       indices.presentFamily = i;
 
@@ -133,12 +172,36 @@ QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device, VkIn
         break;
     i++;
   }
+
+  // A compute-only family usually maps to separate hardware queues, it runs alongside rasterization best
+  for (uint32_t family = 0; family < queueFamilyCount; family++)
+  {
+    const VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+    {
+      indices.computeFamily = family;
+      break;
+    }
+  }
+  if (
+    indices.computeFamily == UINT32_MAX && indices.graphicsFamily != UINT32_MAX &&
+    queueFamilies[indices.graphicsFamily].queueCount > 1
+  ) {
+    indices.computeFamily = indices.graphicsFamily;
+    indices.computeQueueIndex = 1;
+  }
   return indices;
 }
 
-void VulkanDevice::createLogicalDevice(VkInstance instance, VkSurfaceKHR surface)
-{
+void VulkanDevice::createLogicalDevice(
+  VkInstance instance, VkSurfaceKHR surface, uint32_t instanceVersion, bool asyncCompute
+) {
   queueFamilies = findQueueFamilies(physicalDevice, instance, surface);
+  if (!asyncCompute)
+  {
+    queueFamilies.computeFamily = UINT32_MAX;
+    queueFamilies.computeQueueIndex = 0;
+  }
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies =
@@ -146,36 +209,212 @@ void VulkanDevice::createLogicalDevice(VkInstance instance, VkSurfaceKHR surface
     queueFamilies.graphicsFamily,
     queueFamilies.presentFamily
   };
+  if (queueFamilies.computeFamily != UINT32_MAX)
+    uniqueQueueFamilies.insert(queueFamilies.computeFamily);
 
-  float queuePriority = 1.0f;
+  const float queuePriorities[] = {1.0f, 1.0f};
   for (uint32_t queueFamily : uniqueQueueFamilies)
   {
     VkDeviceQueueCreateInfo queueCreateInfo{};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queueCreateInfo.queueFamilyIndex = queueFamily;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    // The compute queue may be the second one of the graphics family
+    queueCreateInfo.queueCount = queueFamily == queueFamilies.computeFamily ? queueFamilies.computeQueueIndex + 1 : 1;
+    queueCreateInfo.pQueuePriorities = queuePriorities;
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
-  std::vector<const char*> deviceExtensions =
+  std::vector<const char*> deviceExtensions;
+  if (surface != VK_NULL_HANDLE)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  // Optional features: enabled only when the GPU reports them
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  enabledFeatures = {};
+  enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  enabledFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+  enabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  // Required, isDeviceSuitable checked it
+  enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+
+  // Dynamic rendering: core in 1.3, an extension on 1.1 and 1.2 devices.
+  // Both need vkGetPhysicalDeviceFeatures2, so a 1.0 instance keeps the render passes
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+  const uint32_t apiVersion = std::min(instanceVersion, deviceProperties.apiVersion);
+  const bool coreDynamicRendering = apiVersion >= VK_API_VERSION_1_3;
+  const bool extensionDynamicRendering = !coreDynamicRendering && apiVersion >= VK_API_VERSION_1_1 &&
+    hasDeviceExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+  // Timeline semaphores: core in 1.2, an extension on 1.1
+  const bool coreTimeline = apiVersion >= VK_API_VERSION_1_2;
+  const bool extensionTimeline = !coreTimeline && apiVersion >= VK_API_VERSION_1_1 &&
+    hasDeviceExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+  // Present wait: extensions only, and VK_KHR_present_wait needs VK_KHR_present_id
+  const bool extensionPresentWait = surface != VK_NULL_HANDLE && apiVersion >= VK_API_VERSION_1_1 &&
+    hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+    hasDeviceExtension(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+  // Only structures of the available versions and extensions may be chained, when querying and when enabling
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+  void* queriedFeatures = nullptr;
+  if (coreDynamicRendering || extensionDynamicRendering)
   {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
-  };
+    dynamicRenderingFeatures.pNext = queriedFeatures;
+    queriedFeatures = &dynamicRenderingFeatures;
+  }
+  if (coreTimeline || extensionTimeline)
+  {
+    timelineFeatures.pNext = queriedFeatures;
+    queriedFeatures = &timelineFeatures;
+  }
+  if (extensionPresentWait)
+  {
+    presentIdFeatures.pNext = queriedFeatures;
+    presentWaitFeatures.pNext = &presentIdFeatures;
+    queriedFeatures = &presentWaitFeatures;
+  }
+  if (queriedFeatures)
+  {
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = queriedFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+  }
+
+  const bool dynamicRendering = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+  const bool timeline = timelineFeatures.timelineSemaphore == VK_TRUE;
+  const bool presentWait = presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+  void* enabledChain = nullptr;
+  if (dynamicRendering)
+  {
+    dynamicRenderingFeatures.pNext = enabledChain;
+    enabledChain = &dynamicRenderingFeatures;
+  }
+  if (timeline)
+  {
+    timelineFeatures.pNext = enabledChain;
+    enabledChain = &timelineFeatures;
+    if (extensionTimeline)
+      deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  }
+  if (presentWait)
+  {
+    presentIdFeatures.pNext = enabledChain;
+    presentWaitFeatures.pNext = &presentIdFeatures;
+    enabledChain = &presentWaitFeatures;
+    deviceExtensions.insert(
+      deviceExtensions.end(), {VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME}
+    );
+  }
+
+  if (dynamicRendering && extensionDynamicRendering)
+  {
+    // Its dependencies are core in 1.2
+    deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    if (apiVersion < VK_API_VERSION_1_2)
+      deviceExtensions.insert(
+        deviceExtensions.end(),
+        {VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME}
+      );
+  }
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
+  createInfo.pEnabledFeatures = &enabledFeatures;
   createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.pNext = enabledChain;
 
   if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
     throw std::runtime_error("Failed to create logical device!");
 
   vkGetDeviceQueue(device, queueFamilies.graphicsFamily, 0, &graphicsQueue);
   vkGetDeviceQueue(device, queueFamilies.presentFamily, 0, &presentQueue);
+  if (queueFamilies.computeFamily != UINT32_MAX)
+    vkGetDeviceQueue(device, queueFamilies.computeFamily, queueFamilies.computeQueueIndex, &computeQueue);
+
+  if (dynamicRendering)
+  {
+    const char* suffix = coreDynamicRendering ? "" : "KHR";
+    cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+      vkGetDeviceProcAddr(device, (std::string("vkCmdBeginRendering") + suffix).c_str())
+    );
+    cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+      vkGetDeviceProcAddr(device, (std::string("vkCmdEndRendering") + suffix).c_str())
+    );
+    if (!cmdBeginRendering || !cmdEndRendering)
+      cmdBeginRendering = cmdEndRendering = nullptr;
+  }
+  std::cout << "Dynamic rendering: " << (supportsDynamicRendering() ? "supported" : "not supported") << std::endl;
+
+  if (timeline)
+  {
+    const char* suffix = coreTimeline ? "" : "KHR";
+    waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+      vkGetDeviceProcAddr(device, (std::string("vkWaitSemaphores") + suffix).c_str())
+    );
+    getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+      vkGetDeviceProcAddr(device, (std::string("vkGetSemaphoreCounterValue") + suffix).c_str())
+    );
+    if (!waitSemaphores || !getSemaphoreCounterValue)
+    {
+      waitSemaphores = nullptr;
+      getSemaphoreCounterValue = nullptr;
+    }
+  }
+  std::cout << "Timeline semaphores: " << (supportsTimelineSemaphores() ? "supported" : "not supported") << std::endl;
+
+  if (presentWait)
+    waitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+      vkGetDeviceProcAddr(device, "vkWaitForPresentKHR")
+    );
+  std::cout << "Present wait: " << (supportsPresentWait() ? "supported" : "not supported") << std::endl;
 
   createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 }
+
+void VulkanDevice::beginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo) const
+{
+  cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void VulkanDevice::endRendering(VkCommandBuffer commandBuffer) const
+{
+  cmdEndRendering(commandBuffer);
+}
+
+VkResult VulkanDevice::waitSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout) const
+{
+  VkSemaphoreWaitInfoKHR waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+  return waitSemaphores(device, &waitInfo, timeout);
+}
+
+uint64_t VulkanDevice::getSemaphoreValue(VkSemaphore semaphore) const
+{
+  uint64_t value = 0;
+  getSemaphoreCounterValue(device, semaphore, &value);
+  return value;
+}
+
+VkResult VulkanDevice::waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout) const
+{
+  return waitForPresentKHR(device, swapChain, presentId, timeout);
+}
@@ -0,0 +1,102 @@
+#include "vulkan_memory.hpp"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+      return i;
+
+  throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+VkBuffer createBuffer(
+  VkPhysicalDevice physicalDevice, VkDevice device,
+  VkDeviceSize size, VkBufferUsageFlags usage,
+  VkMemoryPropertyFlags properties, VkDeviceMemory& bufferMemory,
+  std::span<const uint32_t> sharedFamilies
+) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (sharedFamilies.size() > 1)
+  {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+    bufferInfo.pQueueFamilyIndices = sharedFamilies.data();
+  }
+
+  VkBuffer buffer;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create buffer!");
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate buffer memory!");
+
+  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+  return buffer;
+}
+
+VkImage createImage(
+  VkPhysicalDevice physicalDevice, VkDevice device,
+  const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkDeviceMemory& imageMemory
+) {
+  VkImage image;
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    throw std::runtime_error("Failed to create image!");
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate image memory!");
+
+  vkBindImageMemory(device, image, imageMemory, 0);
+  return image;
+}
+
+VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool)
+{
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("Failed to allocate command buffer!");
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  return commandBuffer;
+}
+
+void endSingleTimeCommands(
+  VkDevice device, VkCommandPool commandPool, QueueTimeline& queue, VkCommandBuffer commandBuffer
+) {
+  vkEndCommandBuffer(commandBuffer);
+  queue.wait(queue.submit({&commandBuffer, 1}));
+
+  vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}